@@ -0,0 +1,590 @@
+#include "async_log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace async_log
+{
+	namespace
+	{
+		//A power of two, so positions wrap with a mask.
+		constexpr size_t buffer_capacity = 64 * 1024;
+		constexpr auto drain_interval = std::chrono::milliseconds{ 20 };
+
+		using argument = std::variant<int64_t, uint64_t, double, std::wstring>;
+
+		struct decoded_record
+		{
+			uint64_t timestamp{};
+			uint32_t site_id{};
+			uint32_t suppressed{};
+			std::vector<argument> arguments;
+		};
+
+		std::atomic<uint64_t> s_written{};
+		std::atomic<uint64_t> s_suppressed{};
+		std::atomic<uint64_t> s_dropped{};
+
+		//Single producer, single consumer ring of whole records.
+		//Positions only ever increase, the producer owns the head and the logging thread owns the tail.
+		class thread_buffer
+		{
+		public:
+			thread_buffer() : m_data{ std::make_unique<uint8_t[]>(buffer_capacity) }
+			{
+			}
+
+			enum class write_result
+			{
+				written,
+				//Written, and the buffer just went past half full.
+				written_half_full,
+				full
+			};
+
+			write_result try_write(const uint8_t *record, size_t size)
+			{
+				auto head = m_head.load(std::memory_order_relaxed);
+				auto tail = m_tail.load(std::memory_order_acquire);
+				auto used = head - tail;
+				if (buffer_capacity - used < size)
+				{
+					return write_result::full;
+				}
+
+				copy_in(head, record, size);
+				//Sequentially consistent, so either the logging thread sees this record
+				//when it goes idle or the writer sees that it is idle.
+				m_head.store(head + size);
+				return used < buffer_capacity / 2 && used + size >= buffer_capacity / 2 ? write_result::written_half_full : write_result::written;
+			}
+
+			template <typename F>
+			void read_all(std::vector<uint8_t> &scratch, F &&f)
+			{
+				auto tail = m_tail.load(std::memory_order_relaxed);
+				auto head = m_head.load(std::memory_order_acquire);
+				while (tail != head)
+				{
+					uint32_t size = 0;
+					copy_out(tail, reinterpret_cast<uint8_t *>(&size), 4);
+					scratch.resize(size);
+					copy_out(tail, scratch.data(), size);
+					f(scratch.data(), scratch.size());
+					tail += size;
+				}
+				m_tail.store(tail, std::memory_order_release);
+			}
+
+			bool is_empty() const
+			{
+				return m_head.load() == m_tail.load(std::memory_order_relaxed);
+			}
+
+			//The owning thread has exited, once the buffer is empty it can go.
+			void abandon()
+			{
+				m_abandoned.store(true, std::memory_order_release);
+			}
+
+			bool is_finished() const
+			{
+				return m_abandoned.load(std::memory_order_acquire) && m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+			}
+
+		private:
+			void copy_in(uint64_t position, const uint8_t *data, size_t size)
+			{
+				auto offset = static_cast<size_t>(position & (buffer_capacity - 1));
+				auto first = std::min(size, buffer_capacity - offset);
+				std::memcpy(m_data.get() + offset, data, first);
+				std::memcpy(m_data.get(), data + first, size - first);
+			}
+
+			void copy_out(uint64_t position, uint8_t *data, size_t size) const
+			{
+				auto offset = static_cast<size_t>(position & (buffer_capacity - 1));
+				auto first = std::min(size, buffer_capacity - offset);
+				std::memcpy(data, m_data.get() + offset, first);
+				std::memcpy(data + first, m_data.get(), size - first);
+			}
+
+			std::unique_ptr<uint8_t[]> m_data;
+			//Kept apart so the two threads don't share a cache line.
+			alignas(64) std::atomic<uint64_t> m_head{};
+			alignas(64) std::atomic<uint64_t> m_tail{};
+			std::atomic<bool> m_abandoned{};
+		};
+
+		struct thread_state
+		{
+			~thread_state()
+			{
+				if (buffer)
+				{
+					buffer->abandon();
+				}
+			}
+
+			std::shared_ptr<thread_buffer> buffer;
+			std::vector<uint8_t> scratch;
+		};
+
+		thread_local thread_state s_thread_state;
+
+		decoded_record decode(const uint8_t *data, size_t)
+		{
+			auto get = [&data](void *value, size_t size)
+				{
+					std::memcpy(value, data, size);
+					data += size;
+				};
+
+			decoded_record record{};
+			uint32_t size = 0;
+			uint8_t argument_count = 0;
+			get(&size, 4);
+			get(&record.site_id, 4);
+			get(&record.suppressed, 4);
+			get(&record.timestamp, 8);
+			get(&argument_count, 1);
+
+			record.arguments.reserve(argument_count);
+			for (uint8_t i = 0; i < argument_count; ++i)
+			{
+				detail::argument_type type{};
+				get(&type, 1);
+				switch (type)
+				{
+				case detail::argument_type::signed_integer:
+				{
+					int64_t value = 0;
+					get(&value, 8);
+					record.arguments.emplace_back(value);
+					break;
+				}
+				case detail::argument_type::unsigned_integer:
+				{
+					uint64_t value = 0;
+					get(&value, 8);
+					record.arguments.emplace_back(value);
+					break;
+				}
+				case detail::argument_type::floating_point:
+				{
+					double value = 0.;
+					get(&value, 8);
+					record.arguments.emplace_back(value);
+					break;
+				}
+				case detail::argument_type::string:
+				{
+					uint32_t length = 0;
+					get(&length, 4);
+					std::wstring value(length, L'\0');
+					get(value.data(), length * sizeof(wchar_t));
+					record.arguments.emplace_back(std::move(value));
+					break;
+				}
+				}
+			}
+
+			return record;
+		}
+
+		//Each replacement field is formatted on its own, so the argument types only
+		//have to be known when the record is decoded.
+		std::wstring format_message(std::wstring_view format, const std::vector<argument> &arguments)
+		{
+			std::wstring text;
+			size_t next_argument = 0;
+
+			for (size_t i = 0; i < format.size(); ++i)
+			{
+				auto c = format[i];
+				if ((c == L'{' || c == L'}') && i + 1 < format.size() && format[i + 1] == c)
+				{
+					text += c;
+					++i;
+					continue;
+				}
+
+				auto close = c == L'{' ? format.find(L'}', i) : std::wstring_view::npos;
+				if (close == std::wstring_view::npos || next_argument >= arguments.size())
+				{
+					text += c;
+					continue;
+				}
+
+				auto field = format.substr(i, close - i + 1);
+				try
+				{
+					text += std::visit([field](const auto &value)
+						{
+							return std::vformat(field, std::make_wformat_args(value));
+						}, arguments[next_argument]);
+				}
+				catch (const std::format_error &)
+				{
+					text += field;
+				}
+				++next_argument;
+				i = close;
+			}
+
+			return text;
+		}
+
+		const wchar_t *severity_name(severity level)
+		{
+			switch (level)
+			{
+			case severity::warning:
+				return L"warning";
+			case severity::error:
+				return L"error";
+			default:
+				return L"info";
+			}
+		}
+
+		class logger
+		{
+		public:
+			logger() : m_start{ detail::now() }
+			{
+				m_thread = std::thread{ [this] { worker(); } };
+			}
+
+			~logger()
+			{
+				{
+					std::lock_guard lock(m_lock);
+					m_stopping = true;
+				}
+				m_wake.notify_one();
+
+				m_thread.join();
+			}
+
+			uint32_t register_site(call_site *site)
+			{
+				std::lock_guard lock(m_lock);
+				m_sites.push_back(site);
+				return static_cast<uint32_t>(m_sites.size() - 1);
+			}
+
+			std::shared_ptr<thread_buffer> register_thread()
+			{
+				auto buffer = std::make_shared<thread_buffer>();
+
+				std::lock_guard lock(m_lock);
+				m_buffers.push_back(buffer);
+				return buffer;
+			}
+
+			void add_sink(std::unique_ptr<log_sink> &&sink)
+			{
+				std::lock_guard lock(m_sink_lock);
+				m_sinks.push_back(std::move(sink));
+			}
+
+			void flush()
+			{
+				std::unique_lock lock(m_lock);
+				auto target = ++m_flush_requested;
+				m_wake.notify_one();
+				m_flushed.wait(lock, [this, target] { return m_flush_completed >= target; });
+			}
+
+			//Drains early, rather than waiting for the interval, so a burst doesn't fill a buffer.
+			void request_drain()
+			{
+				{
+					std::lock_guard lock(m_lock);
+					m_drain_requested = true;
+				}
+				m_wake.notify_one();
+			}
+
+			//Called after every write, this only takes the lock for the first record
+			//written while the logging thread is waiting with nothing buffered.
+			void notify_written()
+			{
+				if (!m_idle.load())
+				{
+					return;
+				}
+
+				{
+					std::lock_guard lock(m_lock);
+					m_idle.store(false);
+					m_records_pending = true;
+				}
+				m_wake.notify_one();
+			}
+
+		private:
+			logger(const logger &) = delete;
+			logger(logger &&) = delete;
+			logger &operator=(const logger &) = delete;
+			logger &operator=(logger &&) = delete;
+
+			void worker()
+			{
+				std::vector<decoded_record> records;
+				std::vector<uint8_t> scratch;
+
+				std::unique_lock lock(m_lock);
+				for (;;)
+				{
+					//With nothing buffered there is nothing to drain until a thread writes,
+					//so the interval only starts once there is something waiting.
+					if (!has_buffered_records())
+					{
+						m_wake.wait(lock, [this] { return m_stopping || m_drain_requested || m_records_pending || m_flush_requested != m_flush_completed; });
+						m_idle.store(false);
+					}
+					m_records_pending = false;
+					m_wake.wait_for(lock, drain_interval, [this] { return m_stopping || m_drain_requested || m_flush_requested != m_flush_completed; });
+
+					auto flush_target = m_flush_requested;
+					bool stopping = m_stopping;
+					m_drain_requested = false;
+					auto buffers = m_buffers;
+					auto sites = m_sites;
+					lock.unlock();
+
+					records.clear();
+					for (auto &buffer : buffers)
+					{
+						buffer->read_all(scratch, [&records](const uint8_t *data, size_t size)
+							{
+								records.push_back(decode(data, size));
+							});
+					}
+					//Each buffer is already in order, sorting merges the threads.
+					std::stable_sort(records.begin(), records.end(), [](const decoded_record &a, const decoded_record &b)
+						{
+							return a.timestamp < b.timestamp;
+						});
+					write_records(records, sites, flush_target != m_flush_completed || stopping);
+
+					lock.lock();
+					std::erase_if(m_buffers, [](const std::shared_ptr<thread_buffer> &buffer)
+						{
+							return buffer->is_finished();
+						});
+					m_flush_completed = flush_target;
+					m_flushed.notify_all();
+
+					if (stopping)
+					{
+						return;
+					}
+				}
+			}
+
+			//Marks the thread idle before looking, so a record written after a buffer
+			//has been checked sees the flag and wakes the thread.
+			bool has_buffered_records()
+			{
+				m_idle.store(true);
+				for (auto &buffer : m_buffers)
+				{
+					if (!buffer->is_empty())
+					{
+						m_idle.store(false);
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			void write_records(const std::vector<decoded_record> &records, const std::vector<call_site *> &sites, bool flush_sinks)
+			{
+				std::lock_guard lock(m_sink_lock);
+
+				auto dropped = s_dropped.load(std::memory_order_relaxed);
+				if (dropped != m_dropped_reported)
+				{
+					auto line = std::format(L"{} log records were dropped because a thread's buffer was full.", dropped - m_dropped_reported);
+					for (auto &sink : m_sinks)
+					{
+						sink->write(severity::warning, line);
+					}
+					m_dropped_reported = dropped;
+				}
+
+				for (auto &record : records)
+				{
+					auto site = sites[record.site_id];
+					auto seconds = static_cast<double>(record.timestamp - m_start) / 1e9;
+
+					auto line = std::format(L"[{:.6f}] {}: ", seconds, severity_name(site->get_severity()));
+					line += format_message(site->get_format(), record.arguments);
+					if (record.suppressed != 0)
+					{
+						line += std::format(L" ({} similar records suppressed.)", record.suppressed);
+					}
+
+					for (auto &sink : m_sinks)
+					{
+						sink->write(site->get_severity(), line);
+					}
+				}
+
+				if (flush_sinks)
+				{
+					for (auto &sink : m_sinks)
+					{
+						sink->flush();
+					}
+				}
+			}
+
+			std::mutex m_lock;
+			std::condition_variable m_wake;
+			std::condition_variable m_flushed;
+			std::vector<std::shared_ptr<thread_buffer>> m_buffers;
+			std::vector<call_site *> m_sites;
+			uint64_t m_flush_requested = 0;
+			uint64_t m_flush_completed = 0;
+			bool m_drain_requested = false;
+			bool m_records_pending = false;
+			bool m_stopping = false;
+			//Set while waiting with nothing buffered.
+			std::atomic<bool> m_idle{};
+
+			std::mutex m_sink_lock;
+			std::vector<std::unique_ptr<log_sink>> m_sinks;
+			uint64_t m_dropped_reported = 0;
+
+			uint64_t m_start;
+			std::thread m_thread;
+		};
+
+		logger &get_logger()
+		{
+			static logger instance;
+			return instance;
+		}
+	}
+
+	call_site::call_site(severity level, const wchar_t *format, uint32_t rate_limit) : m_format{ format }, m_severity{ level }, m_rate_limit{ rate_limit }, m_id{ get_logger().register_site(this) }
+	{
+	}
+
+	bool call_site::admit(uint64_t now)
+	{
+		//The window and count are updated separately, so the limit is only approximate
+		//when several threads share a call site at the turn of a second.
+		auto window = now / 1'000'000'000;
+		auto current = m_window.load(std::memory_order_relaxed);
+		if (current != window && m_window.compare_exchange_strong(current, window, std::memory_order_relaxed))
+		{
+			m_window_count.store(0, std::memory_order_relaxed);
+		}
+
+		if (m_window_count.fetch_add(1, std::memory_order_relaxed) < m_rate_limit)
+		{
+			return true;
+		}
+
+		m_suppressed.fetch_add(1, std::memory_order_relaxed);
+		s_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint32_t call_site::take_suppressed()
+	{
+		return m_suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	void call_site::restore_suppressed(uint32_t count)
+	{
+		m_suppressed.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	uint32_t call_site::get_id() const
+	{
+		return m_id;
+	}
+
+	severity call_site::get_severity() const
+	{
+		return m_severity;
+	}
+
+	const wchar_t *call_site::get_format() const
+	{
+		return m_format;
+	}
+
+	void add_sink(std::unique_ptr<log_sink> &&sink)
+	{
+		get_logger().add_sink(std::move(sink));
+	}
+
+	void flush()
+	{
+		get_logger().flush();
+	}
+
+	log_stats get_stats()
+	{
+		return { s_written.load(std::memory_order_relaxed), s_suppressed.load(std::memory_order_relaxed), s_dropped.load(std::memory_order_relaxed) };
+	}
+
+	namespace detail
+	{
+		uint64_t now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		uint8_t *begin_record(size_t size)
+		{
+			auto &state = s_thread_state;
+			if (state.scratch.size() < size)
+			{
+				state.scratch.resize(size);
+			}
+			return state.scratch.data();
+		}
+
+		bool commit_record(size_t size)
+		{
+			auto &state = s_thread_state;
+			if (!state.buffer)
+			{
+				state.buffer = get_logger().register_thread();
+			}
+
+			auto result = state.buffer->try_write(state.scratch.data(), size);
+			if (result == thread_buffer::write_result::full)
+			{
+				s_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			s_written.fetch_add(1, std::memory_order_relaxed);
+			if (result == thread_buffer::write_result::written_half_full)
+			{
+				get_logger().request_drain();
+			}
+			else
+			{
+				get_logger().notify_written();
+			}
+
+			return true;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+
+//Structured logging that keeps formatting and output off the calling thread.
+//A call writes a compact binary record into a buffer owned by its thread, and a
+//background thread decodes, formats and hands the records to the sinks.
+//The core doesn't depend on Windows, debugger_sink.h provides the debugger output.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace async_log
+{
+	enum class severity : uint8_t
+	{
+		info,
+		warning,
+		error
+	};
+
+	//One per call site, declared by the ASYNC_LOG macros.
+	//Past the rate limit, calls in the same second are counted rather than written,
+	//and the count is reported with the next record that gets through.
+	//The logging thread keeps a pointer to every call site until it stops, which can be
+	//after static destruction has passed them, so they need static storage.
+	class call_site
+	{
+	public:
+		constexpr static uint32_t default_rate_limit = 100;
+
+		call_site(severity, const wchar_t *, uint32_t = default_rate_limit);
+
+		bool admit(uint64_t);
+		uint32_t take_suppressed();
+		//Puts back a count taken for a record that was then dropped.
+		void restore_suppressed(uint32_t);
+
+		uint32_t get_id() const;
+		severity get_severity() const;
+		const wchar_t *get_format() const;
+
+	private:
+		call_site(const call_site &) = delete;
+		call_site(call_site &&) = delete;
+		call_site &operator=(const call_site &) = delete;
+		call_site &operator=(call_site &&) = delete;
+
+		const wchar_t *m_format;
+		severity m_severity;
+		uint32_t m_rate_limit;
+		uint32_t m_id;
+		std::atomic<uint64_t> m_window{ UINT64_MAX };
+		std::atomic<uint32_t> m_window_count{};
+		std::atomic<uint32_t> m_suppressed{};
+	};
+
+	//With a trivial destructor a static call site stays usable until the process ends,
+	//whatever order the statics are destroyed in.
+	static_assert(std::is_trivially_destructible_v<call_site>);
+
+	//Sinks are called from the logging thread only, one line at a time.
+	class log_sink
+	{
+	public:
+		virtual ~log_sink() = default;
+
+		virtual void write(severity, std::wstring_view) = 0;
+		virtual void flush() {}
+	};
+
+	struct log_stats
+	{
+		uint64_t written{};
+		//Calls past their call site's rate limit.
+		uint64_t suppressed{};
+		//Records that didn't fit in their thread's buffer.
+		uint64_t dropped{};
+	};
+
+	void add_sink(std::unique_ptr<log_sink> &&);
+	//Blocks until everything logged before the call has been written to the sinks.
+	void flush();
+	log_stats get_stats();
+
+	namespace detail
+	{
+		enum class argument_type : uint8_t
+		{
+			signed_integer,
+			unsigned_integer,
+			floating_point,
+			string
+		};
+
+		//Longer strings are cut short, so one call can't fill a buffer.
+		constexpr size_t max_string_length = 2048;
+		constexpr size_t max_arguments = 8;
+
+		//size, call site id, suppressed count, timestamp, argument count.
+		constexpr size_t record_header_size = 4 + 4 + 4 + 8 + 1;
+
+		uint64_t now();
+
+		//Returns the thread's scratch space, large enough for the record.
+		uint8_t *begin_record(size_t);
+		//Returns false if the record was dropped because the thread's buffer was full.
+		bool commit_record(size_t);
+
+		template <typename T>
+		constexpr bool is_string_v = std::is_convertible_v<const T &, std::wstring_view>;
+
+		template <typename T>
+		size_t argument_size(const T &value)
+		{
+			if constexpr (is_string_v<T>)
+			{
+				return 1 + 4 + std::min(std::wstring_view{ value }.size(), max_string_length) * sizeof(wchar_t);
+			}
+			else
+			{
+				static_assert(std::is_arithmetic_v<T>, "Log arguments have to be numbers or wide strings.");
+				return 1 + 8;
+			}
+		}
+
+		inline uint8_t *put_bytes(uint8_t *out, const void *data, size_t size)
+		{
+			std::memcpy(out, data, size);
+			return out + size;
+		}
+
+		template <typename T>
+		uint8_t *put_argument(uint8_t *out, const T &value)
+		{
+			if constexpr (is_string_v<T>)
+			{
+				std::wstring_view text{ value };
+				auto length = static_cast<uint32_t>(std::min(text.size(), max_string_length));
+				auto type = argument_type::string;
+				out = put_bytes(out, &type, 1);
+				out = put_bytes(out, &length, 4);
+				return put_bytes(out, text.data(), length * sizeof(wchar_t));
+			}
+			else if constexpr (std::is_floating_point_v<T>)
+			{
+				auto type = argument_type::floating_point;
+				double converted = static_cast<double>(value);
+				out = put_bytes(out, &type, 1);
+				return put_bytes(out, &converted, 8);
+			}
+			else if constexpr (std::is_signed_v<T>)
+			{
+				auto type = argument_type::signed_integer;
+				int64_t converted = static_cast<int64_t>(value);
+				out = put_bytes(out, &type, 1);
+				return put_bytes(out, &converted, 8);
+			}
+			else
+			{
+				auto type = argument_type::unsigned_integer;
+				uint64_t converted = static_cast<uint64_t>(value);
+				out = put_bytes(out, &type, 1);
+				return put_bytes(out, &converted, 8);
+			}
+		}
+	}
+
+	//Never blocks and never formats. If the thread's buffer is full the record is dropped.
+	template <typename... Args>
+	void write(call_site &site, const Args &...args)
+	{
+		static_assert(sizeof...(Args) <= detail::max_arguments, "Too many log arguments.");
+
+		auto timestamp = detail::now();
+		if (!site.admit(timestamp))
+		{
+			return;
+		}
+
+		auto size = static_cast<uint32_t>(detail::record_header_size + (size_t{ 0 } + ... + detail::argument_size(args)));
+		auto id = site.get_id();
+		auto suppressed = site.take_suppressed();
+		auto argument_count = static_cast<uint8_t>(sizeof...(Args));
+
+		auto out = detail::begin_record(size);
+		out = detail::put_bytes(out, &size, 4);
+		out = detail::put_bytes(out, &id, 4);
+		out = detail::put_bytes(out, &suppressed, 4);
+		out = detail::put_bytes(out, &timestamp, 8);
+		out = detail::put_bytes(out, &argument_count, 1);
+		((out = detail::put_argument(out, args)), ...);
+
+		if (!detail::commit_record(size))
+		{
+			site.restore_suppressed(suppressed);
+		}
+	}
+}
+
+//The format string uses std::format syntax, with automatic argument numbering.
+#define ASYNC_LOG_LIMIT(level, rate_limit, format, ...) \
+	do \
+	{ \
+		static ::async_log::call_site async_log_site{ ::async_log::severity::level, format, rate_limit }; \
+		::async_log::write(async_log_site, ##__VA_ARGS__); \
+	} while (false)
+
+#define ASYNC_LOG(level, format, ...) ASYNC_LOG_LIMIT(level, ::async_log::call_site::default_rate_limit, format, ##__VA_ARGS__)
\ No newline at end of file
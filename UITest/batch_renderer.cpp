@@ -0,0 +1,305 @@
+#include "batch_renderer.h"
+
+#include "color_convert.h"
+#include "frame_scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace batch_renderer
+{
+	namespace
+	{
+		struct batch_state
+		{
+			std::atomic<uint64_t> next_frame{};
+			std::atomic<bool> failed{};
+			std::mutex error_lock;
+			std::exception_ptr error;
+		};
+
+		//Everything a thread needs to draw a frame into memory.
+		//Glyphs are rasterised on first use rather than going through the glyph
+		//cache, the cache isn't synchronised and a frame only uses a handful of them.
+		class frame_renderer
+		{
+		public:
+			frame_renderer(IDWriteFactory7 *, const frame_scene::text_font &, const batch_options &);
+
+			void render(uint64_t);
+			void write_png(IWICImagingFactory *, const std::filesystem::path &);
+
+		private:
+			frame_renderer(const frame_renderer &) = delete;
+			frame_renderer(frame_renderer &&) = delete;
+			frame_renderer &operator=(const frame_renderer &) = delete;
+			frame_renderer &operator=(frame_renderer &&) = delete;
+
+			void init_d3d11();
+			void init_d2d1();
+			std::pair<glyph_cache::glyph_metrics, winrt::com_ptr<ID2D1Bitmap1>> get_glyph(uint16_t);
+
+			IDWriteFactory7 *m_dwrite_factory;
+			const frame_scene::text_font &m_text_font;
+			D2D1_SIZE_U m_size;
+			surface_config::surface_config m_surface_config;
+			float m_white_point;
+			//Linear frames are converted to 8 bit here before encoding.
+			std::vector<uint8_t> m_converted;
+
+			winrt::com_ptr<ID3D11Device> m_d3d11_device;
+			winrt::com_ptr<ID2D1Factory1> m_d2d1_factory;
+			winrt::com_ptr<ID2D1DeviceContext> m_d2d1_devicecontext;
+			winrt::com_ptr<ID2D1SolidColorBrush> m_d2d1_text_brush;
+			winrt::com_ptr<ID2D1Bitmap1> m_d2d1_target;
+			//The target can't be mapped, so each frame is copied here to be read back.
+			winrt::com_ptr<ID2D1Bitmap1> m_d2d1_readback;
+
+			std::unordered_map<uint16_t, std::pair<glyph_cache::glyph_metrics, winrt::com_ptr<ID2D1Bitmap1>>> m_glyphs;
+		};
+
+		frame_renderer::frame_renderer(IDWriteFactory7 *dwrite_factory, const frame_scene::text_font &text_font, const batch_options &options) : m_dwrite_factory{ dwrite_factory }, m_text_font{ text_font }, m_size{ options.size }, m_surface_config{ options.surface }, m_white_point{ options.white_point }
+		{
+			init_d3d11();
+			init_d2d1();
+		}
+
+		void frame_renderer::init_d3d11()
+		{
+			using namespace winrt;
+
+			UINT d3d_flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT | D3D11_CREATE_DEVICE_SINGLETHREADED;
+#ifdef _DEBUG
+			d3d_flags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+			D3D_FEATURE_LEVEL feature_levels[]{
+				D3D_FEATURE_LEVEL_12_1,
+				D3D_FEATURE_LEVEL_12_0,
+				D3D_FEATURE_LEVEL_11_1,
+				D3D_FEATURE_LEVEL_11_0
+			};
+
+			com_ptr<ID3D11Device> d3d_device;
+
+			//Batches also run on build machines without a GPU.
+			auto hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, d3d_flags, feature_levels, ARRAYSIZE(feature_levels), D3D11_SDK_VERSION, d3d_device.put(), nullptr, nullptr);
+			if (hr == DXGI_ERROR_UNSUPPORTED)
+			{
+				hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, d3d_flags, feature_levels, ARRAYSIZE(feature_levels), D3D11_SDK_VERSION, d3d_device.put(), nullptr, nullptr);
+			}
+			check_hresult(hr);
+
+			m_d3d11_device = d3d_device;
+		}
+
+		void frame_renderer::init_d2d1()
+		{
+			using namespace winrt;
+
+			com_ptr<ID2D1Factory1> d2d_factory;
+			com_ptr<ID2D1Device> d2d_device;
+			com_ptr<ID2D1DeviceContext> d2d_devicectx;
+			com_ptr<ID2D1SolidColorBrush> d2d_text_brush;
+			com_ptr<ID2D1Bitmap1> target;
+			com_ptr<ID2D1Bitmap1> readback;
+
+			D2D1_FACTORY_OPTIONS opts{};
+#ifdef _DEBUG
+			opts.debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
+#endif
+			//The factory belongs to this thread only.
+			check_hresult(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, opts, d2d_factory.put()));
+			check_hresult(d2d_factory->CreateDevice(m_d3d11_device.as<IDXGIDevice>().get(), d2d_device.put()));
+			check_hresult(d2d_device->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, d2d_devicectx.put()));
+
+			check_hresult(d2d_devicectx->CreateSolidColorBrush(m_surface_config.colour(D2D1::ColorF(D2D1::ColorF::Black)), d2d_text_brush.put()));
+
+			auto pixel_format = D2D1::PixelFormat(m_surface_config.get_dxgi_format(), D2D1_ALPHA_MODE_PREMULTIPLIED);
+			check_hresult(d2d_devicectx->CreateBitmap(m_size, nullptr, 0, D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_TARGET, pixel_format), target.put()));
+			check_hresult(d2d_devicectx->CreateBitmap(m_size, nullptr, 0, D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_CPU_READ | D2D1_BITMAP_OPTIONS_CANNOT_DRAW, pixel_format), readback.put()));
+
+			m_d2d1_factory = d2d_factory;
+			m_d2d1_devicecontext = d2d_devicectx;
+			m_d2d1_text_brush = d2d_text_brush;
+			m_d2d1_target = target;
+			m_d2d1_readback = readback;
+		}
+
+		void frame_renderer::render(uint64_t value)
+		{
+			using namespace winrt;
+
+			auto run = frame_scene::layout_text(m_text_font, frame_scene::format_text(value), [this](uint16_t glyph_index)
+				{
+					return get_glyph(glyph_index);
+				});
+
+			m_d2d1_devicecontext->SetTarget(m_d2d1_target.get());
+			m_d2d1_devicecontext->BeginDraw();
+			frame_scene::draw_background(m_d2d1_devicecontext.get(), m_surface_config);
+			frame_scene::draw_text(m_d2d1_devicecontext.get(), m_d2d1_text_brush.get(), run.glyphs);
+			check_hresult(m_d2d1_devicecontext->EndDraw());
+
+			check_hresult(m_d2d1_readback->CopyFromBitmap(nullptr, m_d2d1_target.get(), nullptr));
+		}
+
+		void frame_renderer::write_png(IWICImagingFactory *factory, const std::filesystem::path &path)
+		{
+			using namespace winrt;
+
+			D2D1_MAPPED_RECT mapped{};
+			check_hresult(m_d2d1_readback->Map(D2D1_MAP_OPTIONS_READ, &mapped));
+			auto unmap = wil::scope_exit([this]()
+				{
+					m_d2d1_readback->Unmap();
+				});
+
+			com_ptr<IWICStream> stream;
+			com_ptr<IWICBitmapEncoder> encoder;
+			com_ptr<IWICBitmapFrameEncode> frame;
+			check_hresult(factory->CreateStream(stream.put()));
+			check_hresult(stream->InitializeFromFilename(path.c_str(), GENERIC_WRITE));
+			check_hresult(factory->CreateEncoder(GUID_ContainerFormatPng, nullptr, encoder.put()));
+			check_hresult(encoder->Initialize(stream.get(), WICBitmapEncoderNoCache));
+			check_hresult(encoder->CreateNewFrame(frame.put(), nullptr));
+			check_hresult(frame->Initialize(nullptr));
+			check_hresult(frame->SetSize(m_size.width, m_size.height));
+
+			//The background is opaque, so the premultiplied pixels can be written as straight alpha.
+			WICPixelFormatGUID pixel_format = GUID_WICPixelFormat32bppBGRA;
+			check_hresult(frame->SetPixelFormat(&pixel_format));
+			if (pixel_format != GUID_WICPixelFormat32bppBGRA)
+			{
+				throw_hresult(WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT);
+			}
+
+			BYTE *pixels = mapped.bits;
+			UINT pitch = mapped.pitch;
+			if (m_surface_config.is_linear())
+			{
+				auto &kernels = color_convert::get_kernels();
+				pitch = m_size.width * 4;
+				m_converted.resize(static_cast<size_t>(pitch) * m_size.height);
+				for (UINT row = 0; row < m_size.height; ++row)
+				{
+					kernels.rgba16f_to_bgra8(reinterpret_cast<const uint16_t *>(mapped.bits + static_cast<size_t>(row) * mapped.pitch), m_converted.data() + static_cast<size_t>(row) * pitch, m_size.width, m_white_point);
+				}
+				pixels = m_converted.data();
+			}
+
+			check_hresult(frame->WritePixels(m_size.height, pitch, pitch * m_size.height, pixels));
+			check_hresult(frame->Commit());
+			check_hresult(encoder->Commit());
+		}
+
+		std::pair<glyph_cache::glyph_metrics, winrt::com_ptr<ID2D1Bitmap1>> frame_renderer::get_glyph(uint16_t glyph_index)
+		{
+			auto it = m_glyphs.find(glyph_index);
+			if (it != m_glyphs.end())
+			{
+				return it->second;
+			}
+
+			auto [metrics, coverage] = glyph_cache::rasterize_glyph(m_dwrite_factory, m_text_font.font_face.get(), frame_scene::text_em_size, glyph_index);
+			auto bitmap = frame_scene::make_glyph_bitmap(m_d2d1_devicecontext.get(), metrics, coverage.data());
+
+			return m_glyphs.emplace(glyph_index, std::make_pair(metrics, bitmap)).first->second;
+		}
+
+		void worker(const batch_options &options, IDWriteFactory7 *dwrite_factory, const frame_scene::text_font &text_font, batch_state &state)
+		{
+			using namespace winrt;
+
+			//WIC needs COM on every thread that encodes.
+			bool com_initialised = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+			auto com_cleanup = wil::scope_exit([com_initialised]()
+				{
+					if (com_initialised)
+					{
+						CoUninitialize();
+					}
+				});
+
+			try
+			{
+				com_ptr<IWICImagingFactory> wic_factory;
+				check_hresult(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(wic_factory.put())));
+
+				frame_renderer renderer{ dwrite_factory, text_font, options };
+				for (auto frame = state.next_frame++; frame < options.frame_count && !state.failed; frame = state.next_frame++)
+				{
+					auto value = options.first_value + frame;
+					renderer.render(value);
+					renderer.write_png(wic_factory.get(), options.output_directory / std::format(L"frame_{:06}.png", value));
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard lock(state.error_lock);
+				if (!state.error)
+				{
+					state.error = std::current_exception();
+				}
+				state.failed = true;
+			}
+		}
+	}
+
+	batch_stats render_batch(const batch_options &options)
+	{
+		using namespace winrt;
+
+		std::filesystem::create_directories(options.output_directory);
+
+		//The shared factory and the font face can be used from any thread.
+		com_ptr<IUnknown> dwrite_fact;
+		check_hresult(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), dwrite_fact.put()));
+		auto dwrite_factory = dwrite_fact.as<IDWriteFactory7>();
+		auto text_font = frame_scene::load_text_font(dwrite_factory.get());
+
+		unsigned thread_count = options.thread_count != 0 ? options.thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+		thread_count = static_cast<unsigned>(std::min<uint64_t>(thread_count, std::max<uint64_t>(options.frame_count, 1)));
+
+		batch_state state;
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		threads.reserve(thread_count);
+		for (unsigned i = 0; i < thread_count; ++i)
+		{
+			threads.emplace_back([&options, &dwrite_factory, &text_font, &state]()
+				{
+					worker(options, dwrite_factory.get(), text_font, state);
+				});
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+
+		if (state.error)
+		{
+			std::rethrow_exception(state.error);
+		}
+
+		batch_stats stats{};
+		stats.frame_count = options.frame_count;
+		stats.thread_count = thread_count;
+		stats.total_time = std::chrono::steady_clock::now() - start;
+		stats.frames_per_second = stats.total_time.count() > 0. ? static_cast<double>(stats.frame_count) / stats.total_time.count() : 0.;
+
+		return stats;
+	}
+
+	std::wstring format_stats(const batch_stats &stats)
+	{
+		return std::format(L"Rendered {} frames on {} threads in {:.3f}s, {:.1f} frames per second.",
+			stats.frame_count, stats.thread_count, stats.total_time.count(), stats.frames_per_second);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "framework.h"
+#include "surface_config.h"
+
+#include <chrono>
+#include <filesystem>
+
+namespace batch_renderer
+{
+	struct batch_options
+	{
+		std::filesystem::path output_directory;
+		//One frame is rendered for each counter value from here on.
+		uint64_t first_value{};
+		uint64_t frame_count = 600;
+		D2D1_SIZE_U size{ 1280, 720 };
+		surface_config::surface_config surface;
+		//Frames drawn on a linear surface are tone mapped to 8 bit sRGB for the PNGs.
+		//A white point of one just clips.
+		float white_point = 1.f;
+		//Zero uses one thread per core.
+		unsigned thread_count{};
+	};
+
+	struct batch_stats
+	{
+		uint64_t frame_count{};
+		unsigned thread_count{};
+		//This includes creating the devices on each thread.
+		std::chrono::duration<double> total_time{};
+		double frames_per_second{};
+	};
+
+	//Draws the same frames as the window, without a window, and writes them out as
+	//a numbered PNG sequence in the output directory.
+	//Each thread has its own device and takes the next frame when it finishes one,
+	//so rendering, readback and encoding all run in parallel.
+	//The first failure stops every thread and is rethrown.
+	batch_stats render_batch(const batch_options &);
+	std::wstring format_stats(const batch_stats &);
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "canvas_scene.h"
+
+#include <algorithm>
+#include <random>
+
+namespace canvas_scene
+{
+	namespace
+	{
+		constexpr uint32_t scene_seed = 0x5ce7e;
+		constexpr float min_element_size = 12.f;
+		constexpr float max_element_size = 160.f;
+		constexpr int32_t layer_count = 4;
+		constexpr float highlight_width = 3.f;
+	}
+
+	canvas_scene::canvas_scene(const D2D1_SIZE_F &canvas_size, size_t element_count)
+	{
+		std::mt19937 generator{ scene_seed };
+		std::uniform_real_distribution<float> size_distribution{ min_element_size, max_element_size };
+		std::uniform_real_distribution<float> x_distribution{ 0.f, canvas_size.width - max_element_size };
+		std::uniform_real_distribution<float> y_distribution{ 0.f, canvas_size.height - max_element_size };
+		std::uniform_real_distribution<float> colour_distribution{ 0.2f, 0.95f };
+		std::uniform_int_distribution<int32_t> layer_distribution{ 0, layer_count - 1 };
+		std::bernoulli_distribution shape_distribution{ 0.5 };
+
+		m_elements.reserve(element_count);
+		std::vector<spatial_index::entry> entries;
+		entries.reserve(element_count);
+
+		for (size_t i = 0; i < element_count; ++i)
+		{
+			float left = x_distribution(generator);
+			float top = y_distribution(generator);
+			spatial_index::bounds box{ left, top, left + size_distribution(generator), top + size_distribution(generator) };
+			auto colour = D2D1::ColorF(colour_distribution(generator), colour_distribution(generator), colour_distribution(generator));
+			auto kind = shape_distribution(generator) ? shape::ellipse : shape::rectangle;
+			auto z = layer_distribution(generator);
+
+			m_elements.push_back({ box, colour, kind, z });
+			entries.push_back({ box, static_cast<spatial_index::element_id>(i), z });
+		}
+
+		m_index.bulk_load(std::move(entries));
+	}
+
+	void canvas_scene::init_device_dependent_resources(ID2D1DeviceContext *device_context, const surface_config::surface_config &surface)
+	{
+		using namespace winrt;
+
+		com_ptr<ID2D1SolidColorBrush> highlight_brush;
+		check_hresult(device_context->CreateSolidColorBrush(surface.colour(D2D1::ColorF(D2D1::ColorF::Yellow)), highlight_brush.put()));
+
+		std::vector<D2D1_COLOR_F> surface_colours;
+		surface_colours.reserve(m_elements.size());
+		for (auto &e : m_elements)
+		{
+			surface_colours.push_back(surface.colour(e.colour));
+		}
+
+		m_highlight_brush = highlight_brush;
+		m_surface_colours = std::move(surface_colours);
+	}
+
+	void canvas_scene::cleanup_device_dependent_resources()
+	{
+		m_surface_colours.clear();
+		m_highlight_brush = nullptr;
+	}
+
+	void canvas_scene::draw(ID2D1DeviceContext *device_context, ID2D1SolidColorBrush *brush, const D2D1_RECT_F &rect) const
+	{
+		m_query_results.clear();
+		m_index.query_rect({ rect.left, rect.top, rect.right, rect.bottom }, m_query_results);
+
+		//Drawn bottom to top, in the same order hit testing uses.
+		std::sort(m_query_results.begin(), m_query_results.end(), [](const spatial_index::entry &a, const spatial_index::entry &b)
+			{
+				return a.z != b.z ? a.z < b.z : a.id < b.id;
+			});
+
+		for (auto &result : m_query_results)
+		{
+			auto &e = m_elements[result.id];
+			auto box = D2D1::RectF(e.box.left, e.box.top, e.box.right, e.box.bottom);
+
+			brush->SetColor(m_surface_colours[result.id]);
+			if (e.kind == shape::ellipse)
+			{
+				device_context->FillEllipse(D2D1::Ellipse(D2D1::Point2F((box.left + box.right) / 2.f, (box.top + box.bottom) / 2.f), (box.right - box.left) / 2.f, (box.bottom - box.top) / 2.f), brush);
+			}
+			else
+			{
+				device_context->FillRectangle(box, brush);
+			}
+		}
+	}
+
+	std::optional<spatial_index::element_id> canvas_scene::hit_test(const D2D1_POINT_2F &point) const
+	{
+		auto result = m_index.hit_test(point.x, point.y, [this, &point](const spatial_index::entry &candidate)
+			{
+				auto &e = m_elements[candidate.id];
+				if (e.kind != shape::ellipse)
+				{
+					return true;
+				}
+
+				float radius_x = (e.box.right - e.box.left) / 2.f;
+				float radius_y = (e.box.bottom - e.box.top) / 2.f;
+				float dx = (point.x - e.box.left - radius_x) / radius_x;
+				float dy = (point.y - e.box.top - radius_y) / radius_y;
+				return dx * dx + dy * dy <= 1.f;
+			});
+		if (!result)
+		{
+			return std::nullopt;
+		}
+
+		return result->id;
+	}
+
+	void canvas_scene::draw_highlight(ID2D1DeviceContext *device_context, spatial_index::element_id id, const D2D1_MATRIX_3X2_F &transform) const
+	{
+		_ASSERTE(id < m_elements.size());
+		if (id >= m_elements.size())
+		{
+			__fastfail(FAST_FAIL_INVALID_ARG);
+		}
+
+		//The outline is drawn in target space so its width doesn't change with the zoom.
+		auto &e = m_elements[id];
+		auto matrix = D2D1::Matrix3x2F::ReinterpretBaseType(&transform);
+		auto top_left = matrix->TransformPoint(D2D1::Point2F(e.box.left, e.box.top));
+		auto bottom_right = matrix->TransformPoint(D2D1::Point2F(e.box.right, e.box.bottom));
+		auto box = D2D1::RectF(top_left.x, top_left.y, bottom_right.x, bottom_right.y);
+
+		if (e.kind == shape::ellipse)
+		{
+			device_context->DrawEllipse(D2D1::Ellipse(D2D1::Point2F((box.left + box.right) / 2.f, (box.top + box.bottom) / 2.f), (box.right - box.left) / 2.f, (box.bottom - box.top) / 2.f), m_highlight_brush.get(), highlight_width);
+		}
+		else
+		{
+			device_context->DrawRectangle(box, m_highlight_brush.get(), highlight_width);
+		}
+	}
+
+	size_t canvas_scene::size() const
+	{
+		return m_elements.size();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "framework.h"
+#include "spatial_index.h"
+#include "surface_config.h"
+
+#include <optional>
+#include <vector>
+
+namespace canvas_scene
+{
+	enum class shape : uint8_t
+	{
+		rectangle,
+		ellipse
+	};
+
+	struct element
+	{
+		spatial_index::bounds box;
+		D2D1_COLOR_F colour;
+		shape kind;
+		int32_t z;
+	};
+
+	//The content of the tiled canvas, a large number of overlapping shapes.
+	//The elements are generated from a fixed seed, so the scene is the same on every run.
+	//Both drawing a tile and hit testing go through the spatial index rather than
+	//looking at every element.
+	class canvas_scene
+	{
+	public:
+		constexpr static size_t default_element_count = 150000;
+
+		explicit canvas_scene(const D2D1_SIZE_F &, size_t = default_element_count);
+
+		void init_device_dependent_resources(ID2D1DeviceContext *, const surface_config::surface_config &);
+		void cleanup_device_dependent_resources();
+
+		//Used as the tiled canvas content function.
+		void draw(ID2D1DeviceContext *, ID2D1SolidColorBrush *, const D2D1_RECT_F &) const;
+
+		std::optional<spatial_index::element_id> hit_test(const D2D1_POINT_2F &) const;
+		//Outlines an element, the transform maps canvas coordinates to the target.
+		void draw_highlight(ID2D1DeviceContext *, spatial_index::element_id, const D2D1_MATRIX_3X2_F &) const;
+
+		size_t size() const;
+
+	private:
+		canvas_scene(const canvas_scene &) = delete;
+		canvas_scene(canvas_scene &&) = delete;
+		canvas_scene &operator=(const canvas_scene &) = delete;
+		canvas_scene &operator=(canvas_scene &&) = delete;
+
+		std::vector<element> m_elements;
+		//The element colours converted for the surface.
+		std::vector<D2D1_COLOR_F> m_surface_colours;
+		spatial_index::rtree m_index;
+		//Reused between tiles to avoid allocating for every query.
+		mutable std::vector<spatial_index::entry> m_query_results;
+
+		winrt::com_ptr<ID2D1SolidColorBrush> m_highlight_brush;
+	};
+}
\ No newline at end of file
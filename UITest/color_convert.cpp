@@ -0,0 +1,301 @@
+#include "color_convert.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLOR_CONVERT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//MSVC allows intrinsics for any instruction set, GCC and Clang need the function to opt in.
+#if defined(COLOR_CONVERT_X86) && !defined(_MSC_VER)
+#define COLOR_CONVERT_TARGET(features) __attribute__((target(features)))
+#else
+#define COLOR_CONVERT_TARGET(features)
+#endif
+
+namespace color_convert
+{
+	namespace
+	{
+		//Large enough that quantising the linear value costs well under a step of the 8 bit output.
+		constexpr size_t srgb_table_size = 1 << 14;
+		constexpr float srgb_table_max = static_cast<float>(srgb_table_size - 1);
+
+		struct conversion_tables
+		{
+			//Indexed by alpha * 256 + colour, both premultiplied 8 bit values.
+			std::array<uint16_t, 256 * 256> premultiplied_linear_half;
+			std::array<uint16_t, 256> alpha_half;
+			//The sRGB value scaled to 0-255 but not rounded, so it can be premultiplied first.
+			std::array<float, srgb_table_size> srgb;
+		};
+
+		std::unique_ptr<conversion_tables> build_tables()
+		{
+			auto tables = std::make_unique<conversion_tables>();
+			for (size_t alpha = 0; alpha < 256; ++alpha)
+			{
+				float alpha_value = static_cast<float>(alpha) / 255.f;
+				tables->alpha_half[alpha] = float_to_half(alpha_value);
+				for (size_t colour = 0; colour < 256; ++colour)
+				{
+					//A colour above its alpha isn't valid premultiplied data, it is clamped to white.
+					//Fully transparent pixels have no colour.
+					float straight = alpha > 0 ? std::min(static_cast<float>(colour) / static_cast<float>(alpha), 1.f) : 0.f;
+					tables->premultiplied_linear_half[alpha * 256 + colour] = float_to_half(srgb_to_linear(straight) * alpha_value);
+				}
+			}
+			for (size_t i = 0; i < srgb_table_size; ++i)
+			{
+				tables->srgb[i] = linear_to_srgb(static_cast<float>(i) / srgb_table_max) * 255.f;
+			}
+
+			return tables;
+		}
+
+		const conversion_tables &get_tables()
+		{
+			static const auto tables = build_tables();
+			return *tables;
+		}
+
+		//Both readback kernels finish each channel here, so they round the same way.
+		//The value is never negative, so adding a half rounds it without a call into the C library.
+		uint8_t premultiply_srgb(const conversion_tables &tables, int32_t linear_index, float alpha_scale)
+		{
+			return static_cast<uint8_t>(tables.srgb[linear_index] * alpha_scale + 0.5f);
+		}
+
+		//The comparisons are written so that NaN goes to zero and then stays there,
+		//which matches what maxps and minps do in the F16C kernel.
+		void rgba16f_to_bgra8_scalar(const uint16_t *source, uint8_t *destination, size_t pixel_count, float white_point)
+		{
+			auto &tables = get_tables();
+			bool tone_map = white_point > 1.f;
+			float white_scale = tone_map ? 1.f / (white_point * white_point) : 0.f;
+
+			for (size_t i = 0; i < pixel_count; ++i, source += 4, destination += 4)
+			{
+				float alpha = half_to_float(source[3]);
+				alpha = alpha > 0.f ? alpha : 0.f;
+				alpha = alpha < 1.f ? alpha : 1.f;
+
+				int32_t indices[3];
+				for (size_t channel = 0; channel < 3; ++channel)
+				{
+					float value = half_to_float(source[channel]);
+					value = value > 0.f ? value : 0.f;
+					value = alpha > 0.f ? value / alpha : 0.f;
+					if (tone_map)
+					{
+						value = value * (1.f + value * white_scale) / (1.f + value);
+					}
+					value = value < 1.f ? value : 1.f;
+					indices[channel] = static_cast<int32_t>(std::nearbyint(value * srgb_table_max));
+				}
+
+				auto alpha_byte = static_cast<int32_t>(std::nearbyint(alpha * 255.f));
+				float alpha_scale = static_cast<float>(alpha_byte) / 255.f;
+				destination[0] = premultiply_srgb(tables, indices[2], alpha_scale);
+				destination[1] = premultiply_srgb(tables, indices[1], alpha_scale);
+				destination[2] = premultiply_srgb(tables, indices[0], alpha_scale);
+				destination[3] = static_cast<uint8_t>(alpha_byte);
+			}
+		}
+
+#ifdef COLOR_CONVERT_X86
+		COLOR_CONVERT_TARGET("avx,f16c")
+		void rgba16f_to_bgra8_f16c(const uint16_t *source, uint8_t *destination, size_t pixel_count, float white_point)
+		{
+			//Two pixels at a time, the sRGB encode is still a table lookup per channel.
+			//The division and tone mapping are the same operations in the same order as the
+			//scalar kernel, so the results match exactly.
+			auto &tables = get_tables();
+			bool tone_map = white_point > 1.f;
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps(1.f);
+			const __m256 white_scale = _mm256_set1_ps(tone_map ? 1.f / (white_point * white_point) : 0.f);
+			const __m256 alpha_lanes = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+			const __m256 output_scale = _mm256_setr_ps(srgb_table_max, srgb_table_max, srgb_table_max, 255.f, srgb_table_max, srgb_table_max, srgb_table_max, 255.f);
+
+			size_t i = 0;
+			for (; i + 2 <= pixel_count; i += 2, source += 8, destination += 8)
+			{
+				__m256 values = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source)));
+				values = _mm256_max_ps(values, zero);
+				//Each pixel's alpha in all four of its lanes.
+				__m256 alpha = _mm256_min_ps(_mm256_permute_ps(values, _MM_SHUFFLE(3, 3, 3, 3)), one);
+				__m256 straight = _mm256_and_ps(_mm256_div_ps(values, alpha), _mm256_cmp_ps(alpha, zero, _CMP_GT_OQ));
+				if (tone_map)
+				{
+					straight = _mm256_div_ps(_mm256_mul_ps(straight, _mm256_add_ps(one, _mm256_mul_ps(straight, white_scale))), _mm256_add_ps(one, straight));
+				}
+				values = _mm256_blendv_ps(_mm256_min_ps(straight, one), alpha, alpha_lanes);
+
+				alignas(32) int32_t lanes[8];
+				_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_cvtps_epi32(_mm256_mul_ps(values, output_scale)));
+
+				float alpha_scale = static_cast<float>(lanes[3]) / 255.f;
+				destination[0] = premultiply_srgb(tables, lanes[2], alpha_scale);
+				destination[1] = premultiply_srgb(tables, lanes[1], alpha_scale);
+				destination[2] = premultiply_srgb(tables, lanes[0], alpha_scale);
+				destination[3] = static_cast<uint8_t>(lanes[3]);
+				alpha_scale = static_cast<float>(lanes[7]) / 255.f;
+				destination[4] = premultiply_srgb(tables, lanes[6], alpha_scale);
+				destination[5] = premultiply_srgb(tables, lanes[5], alpha_scale);
+				destination[6] = premultiply_srgb(tables, lanes[4], alpha_scale);
+				destination[7] = static_cast<uint8_t>(lanes[7]);
+			}
+
+			if (i < pixel_count)
+			{
+				rgba16f_to_bgra8_scalar(source, destination, pixel_count - i, white_point);
+			}
+		}
+
+		COLOR_CONVERT_TARGET("xsave")
+		bool os_saves_avx_state()
+		{
+			return (_xgetbv(0) & 0x6) == 0x6;
+		}
+#endif
+
+		constexpr kernels scalar_kernels{ rgba16f_to_bgra8_scalar };
+#ifdef COLOR_CONVERT_X86
+		constexpr kernels f16c_kernels{ rgba16f_to_bgra8_f16c };
+#endif
+	}
+
+	float srgb_to_linear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linear_to_srgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+	}
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits = std::bit_cast<uint32_t>(value);
+		uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		uint32_t magnitude = bits & 0x7fffffff;
+
+		//Infinity and NaN, NaN always comes out quiet.
+		if (magnitude >= 0x7f800000)
+		{
+			return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+		}
+		//Too large even after rounding.
+		if (magnitude >= 0x47800000)
+		{
+			return sign | 0x7c00;
+		}
+		//Below the smallest normal half, adding 0.5 lines the half subnormal step up with
+		//the float mantissa, so the addition does the rounding.
+		if (magnitude < 0x38800000)
+		{
+			float shifted = std::bit_cast<float>(magnitude) + 0.5f;
+			return sign | static_cast<uint16_t>(std::bit_cast<uint32_t>(shifted) - 0x3f000000);
+		}
+
+		//Rebias the exponent and round to nearest even, a carry into the exponent is correct.
+		uint32_t odd = (magnitude >> 13) & 1;
+		magnitude += 0xc8000fff + odd;
+		return sign | static_cast<uint16_t>(magnitude >> 13);
+	}
+
+	float half_to_float(uint16_t value)
+	{
+		uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		uint32_t exponent = (value >> 10) & 0x1f;
+		uint32_t mantissa = value & 0x3ff;
+
+		if (exponent == 0)
+		{
+			//Zero and subnormals, which are exact as a float.
+			float magnitude = static_cast<float>(mantissa) * 0x1p-24f;
+			return sign != 0 ? -magnitude : magnitude;
+		}
+		if (exponent == 0x1f)
+		{
+			return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+		}
+
+		return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	void bgra8_to_rgba16f(const uint8_t *source, uint16_t *destination, size_t pixel_count)
+	{
+		auto &tables = get_tables();
+		for (size_t i = 0; i < pixel_count; ++i, source += 4, destination += 4)
+		{
+			auto row = tables.premultiplied_linear_half.data() + source[3] * 256;
+			destination[0] = row[source[2]];
+			destination[1] = row[source[1]];
+			destination[2] = row[source[0]];
+			destination[3] = tables.alpha_half[source[3]];
+		}
+	}
+
+	instruction_set detect_instruction_set()
+	{
+#ifdef COLOR_CONVERT_X86
+		constexpr uint32_t osxsave_bit = 1u << 27;
+		constexpr uint32_t avx_bit = 1u << 28;
+		constexpr uint32_t f16c_bit = 1u << 29;
+		constexpr uint32_t required = osxsave_bit | avx_bit | f16c_bit;
+
+		uint32_t ecx = 0;
+#if defined(_MSC_VER)
+		int registers[4]{};
+		__cpuid(registers, 1);
+		ecx = static_cast<uint32_t>(registers[2]);
+#else
+		unsigned int eax = 0, ebx = 0, ecx_value = 0, edx = 0;
+		if (__get_cpuid(1, &eax, &ebx, &ecx_value, &edx))
+		{
+			ecx = ecx_value;
+		}
+#endif
+
+		if ((ecx & required) == required && os_saves_avx_state())
+		{
+			return instruction_set::f16c;
+		}
+#endif
+		return instruction_set::scalar;
+	}
+
+	const kernels &get_kernels(instruction_set set)
+	{
+#ifdef COLOR_CONVERT_X86
+		if (set == instruction_set::f16c)
+		{
+			assert(detect_instruction_set() == instruction_set::f16c);
+			return f16c_kernels;
+		}
+#else
+		assert(set == instruction_set::scalar);
+#endif
+		return scalar_kernels;
+	}
+
+	const kernels &get_kernels()
+	{
+		static const kernels &best = get_kernels(detect_instruction_set());
+		return best;
+	}
+}
\ No newline at end of file
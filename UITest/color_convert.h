@@ -0,0 +1,52 @@
+#pragma once
+
+//Colour conversion between 8 bit sRGB and half float linear scRGB.
+//This doesn't depend on Windows. Reading back half floats uses F16C on
+//processors that have it, everything else, including ARM64, uses the scalar
+//kernel, which gives the same results.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace color_convert
+{
+	float srgb_to_linear(float);
+	float linear_to_srgb(float);
+
+	//Rounds to nearest even, the same as F16C.
+	uint16_t float_to_half(float);
+	float half_to_float(uint16_t);
+
+	enum class instruction_set
+	{
+		scalar,
+		f16c
+	};
+
+	instruction_set detect_instruction_set();
+
+	//Premultiplied sRGB BGRA, 8 bits per channel, to premultiplied linear RGBA
+	//half floats, which is the scRGB swap chain layout.
+	//The sRGB transfer only applies to straight colour, so each pixel is unpremultiplied,
+	//converted and premultiplied again. That is one lookup per channel in a table for each
+	//alpha value, so there is no vector kernel and this is the same on every processor.
+	void bgra8_to_rgba16f(const uint8_t *, uint16_t *, size_t);
+
+	//The reverse, used to read back linear surfaces. Again the colour is unpremultiplied
+	//before it is encoded, then premultiplied by the 8 bit alpha.
+	//With a white point above one, the straight colour goes through extended
+	//Reinhard tone mapping, x * (1 + x / w^2) / (1 + x), which compresses the
+	//whole range so that the white point maps to one, and anything brighter is
+	//clipped. A white point of one or less just clips at one.
+	using rgba16f_to_bgra8_function = void (*)(const uint16_t *, uint8_t *, size_t, float);
+
+	struct kernels
+	{
+		rgba16f_to_bgra8_function rgba16f_to_bgra8;
+	};
+
+	//The instruction set has to be one that detect_instruction_set allows.
+	const kernels &get_kernels(instruction_set);
+	//The fastest kernels for this processor, chosen on first use.
+	const kernels &get_kernels();
+}
\ No newline at end of file
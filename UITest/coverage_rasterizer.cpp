@@ -0,0 +1,265 @@
+#include "coverage_rasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COVERAGE_RASTERIZER_X86
+#include <emmintrin.h>
+#endif
+
+//MSVC allows intrinsics for any instruction set, GCC and Clang need the function to opt in.
+#if defined(COVERAGE_RASTERIZER_X86) && !defined(_MSC_VER)
+#define COVERAGE_RASTERIZER_TARGET(features) __attribute__((target(features)))
+#else
+#define COVERAGE_RASTERIZER_TARGET(features)
+#endif
+
+namespace coverage_rasterizer
+{
+	namespace
+	{
+		uint8_t to_coverage(float sum)
+		{
+			return static_cast<uint8_t>(std::min(std::fabs(sum), 1.f) * 255.f + 0.5f);
+		}
+
+		void accumulate_range(float *cells, uint8_t *out, size_t first, size_t last, float sum)
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				sum += cells[i];
+				out[i] = to_coverage(sum);
+				cells[i] = 0.f;
+			}
+		}
+
+#if defined(COVERAGE_RASTERIZER_X86)
+		COVERAGE_RASTERIZER_TARGET("sse2")
+		void accumulate_sse2(float *cells, uint8_t *out, size_t width)
+		{
+			const __m128 sign = _mm_set1_ps(-0.f);
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 scale = _mm_set1_ps(255.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			__m128 offset = _mm_setzero_ps();
+
+			size_t i = 0;
+			for (; i + 4 <= width; i += 4)
+			{
+				//A prefix sum across the four lanes in two shifted adds, then the total so far.
+				__m128 x = _mm_loadu_ps(cells + i);
+				x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+				x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+				x = _mm_add_ps(x, offset);
+				offset = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+
+				__m128 coverage = _mm_min_ps(_mm_andnot_ps(sign, x), one);
+				__m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(coverage, scale), half));
+				values = _mm_packs_epi32(values, values);
+				values = _mm_packus_epi16(values, values);
+
+				auto packed = _mm_cvtsi128_si32(values);
+				std::memcpy(out + i, &packed, sizeof(packed));
+				_mm_storeu_ps(cells + i, _mm_setzero_ps());
+			}
+
+			accumulate_range(cells, out, i, width, _mm_cvtss_f32(offset));
+		}
+#endif
+	}
+
+	void accumulate_scalar(float *cells, uint8_t *out, size_t width)
+	{
+		accumulate_range(cells, out, 0, width, 0.f);
+	}
+
+	accumulate_function get_accumulate_sse2()
+	{
+		//SSE2 is part of x64, and Windows hasn't run on x86 processors without it for a long time.
+#if defined(COVERAGE_RASTERIZER_X86)
+		return accumulate_sse2;
+#else
+		return nullptr;
+#endif
+	}
+
+	accumulate_function get_accumulate()
+	{
+		auto sse2 = get_accumulate_sse2();
+		return sse2 ? sse2 : accumulate_scalar;
+	}
+
+	rasterizer::rasterizer(accumulate_function accumulate) : m_accumulate{ accumulate }
+	{
+		assert(accumulate);
+	}
+
+	void rasterizer::reset(uint32_t width, uint32_t height)
+	{
+		//Edges on the right border write up to two cells past the last pixel.
+		m_stride = (static_cast<size_t>(width) + 2 + 3) & ~size_t{ 3 };
+		m_width = width;
+		m_height = height;
+		m_cells.assign(m_stride * height, 0.f);
+	}
+
+	void rasterizer::add_line(const path_geometry::point &p0, const path_geometry::point &p1)
+	{
+		if (p0.y == p1.y)
+		{
+			return;
+		}
+
+		//The line is split where it crosses the left and right borders, and the parts outside
+		//are moved onto the border. Everything to the right still sees their winding, and
+		//nothing else changes.
+		float right = static_cast<float>(m_width);
+		std::array<float, 4> splits{ 0.f };
+		size_t split_count = 1;
+		for (float edge : { 0.f, right })
+		{
+			if ((p0.x < edge) != (p1.x < edge))
+			{
+				splits[split_count++] = (edge - p0.x) / (p1.x - p0.x);
+			}
+		}
+		if (split_count == 3 && splits[1] > splits[2])
+		{
+			std::swap(splits[1], splits[2]);
+		}
+		splits[split_count++] = 1.f;
+
+		auto at = [&p0, &p1, right](float t)
+			{
+				path_geometry::point p{ p0.x + (p1.x - p0.x) * t, p0.y + (p1.y - p0.y) * t };
+				p.x = std::clamp(p.x, 0.f, right);
+				return p;
+			};
+
+		for (size_t i = 0; i + 1 < split_count; ++i)
+		{
+			add_edge(at(splits[i]), at(splits[i + 1]));
+		}
+	}
+
+	void rasterizer::add_polygons(const path_geometry::polygon_set &polygons, const path_geometry::transform &transform)
+	{
+		for (auto &contour : polygons.contours)
+		{
+			if (contour.size() < 2)
+			{
+				continue;
+			}
+
+			auto previous = transform.apply(contour.back());
+			for (auto &p : contour)
+			{
+				auto current = transform.apply(p);
+				add_line(previous, current);
+				previous = current;
+			}
+		}
+	}
+
+	void rasterizer::resolve(uint8_t *out, size_t out_stride)
+	{
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			auto row = m_cells.data() + y * m_stride;
+			m_accumulate(row, out + y * out_stride, m_width);
+			std::fill(row + m_width, row + m_stride, 0.f);
+		}
+	}
+
+	uint32_t rasterizer::width() const
+	{
+		return m_width;
+	}
+
+	uint32_t rasterizer::height() const
+	{
+		return m_height;
+	}
+
+	void rasterizer::add_edge(path_geometry::point p0, path_geometry::point p1)
+	{
+		float direction = 1.f;
+		if (p0.y > p1.y)
+		{
+			std::swap(p0, p1);
+			direction = -1.f;
+		}
+
+		float top = std::max(p0.y, 0.f);
+		float bottom = std::min(p1.y, static_cast<float>(m_height));
+		if (top >= bottom)
+		{
+			return;
+		}
+
+		float right = static_cast<float>(m_width);
+		float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+		float x = p0.x + (top - p0.y) * dxdy;
+		auto first_row = static_cast<uint32_t>(top);
+		auto last_row = std::min(static_cast<uint32_t>(std::ceil(bottom)), m_height);
+
+		for (auto y = first_row; y < last_row; ++y)
+		{
+			auto row = m_cells.data() + y * m_stride;
+			float dy = std::min(static_cast<float>(y + 1), bottom) - std::max(static_cast<float>(y), top);
+			float x_next = x + dxdy * dy;
+			float d = dy * direction;
+
+			//Rounding can leave x a hair outside the borders.
+			float xa = std::clamp(x, 0.f, right);
+			float xb = std::clamp(x_next, 0.f, right);
+			float x0 = std::min(xa, xb);
+			float x1 = std::max(xa, xb);
+			float x0_floor = std::floor(x0);
+			float x1_ceil = std::ceil(x1);
+			auto x0i = static_cast<int32_t>(x0_floor);
+			auto x1i = static_cast<int32_t>(x1_ceil);
+
+			if (x1i <= x0i + 1)
+			{
+				//The edge stays within one pixel on this row.
+				float x_mid = 0.5f * (xa + xb) - x0_floor;
+				row[x0i] += d - d * x_mid;
+				row[x0i + 1] += d * x_mid;
+			}
+			else
+			{
+				float s = 1.f / (x1 - x0);
+				float x0f = x0 - x0_floor;
+				float a0 = 0.5f * s * (1.f - x0f) * (1.f - x0f);
+				float x1f = x1 - x1_ceil + 1.f;
+				float am = 0.5f * s * x1f * x1f;
+
+				row[x0i] += d * a0;
+				if (x1i == x0i + 2)
+				{
+					row[x0i + 1] += d * (1.f - a0 - am);
+				}
+				else
+				{
+					float a1 = s * (1.5f - x0f);
+					row[x0i + 1] += d * (a1 - a0);
+					for (auto xi = x0i + 2; xi < x1i - 1; ++xi)
+					{
+						row[xi] += d * s;
+					}
+					float a2 = a1 + static_cast<float>(x1i - x0i - 3) * s;
+					row[x1i - 1] += d * (1.f - a2 - am);
+				}
+				row[x1i] += d * am;
+			}
+
+			x = x_next;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+//Antialiased polygon coverage computed in software, one 8 bit value per pixel.
+//This doesn't depend on Windows, so it can be benchmarked anywhere.
+
+#include "path_geometry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coverage_rasterizer
+{
+	//Turns one row of signed area deltas into coverage and clears the row.
+	//Coverage is the running sum, made positive and clamped to one, so overlapping
+	//polygons with the same winding merge and opposite windings cut holes.
+	using accumulate_function = void (*)(float *, uint8_t *, size_t);
+
+	void accumulate_scalar(float *, uint8_t *, size_t);
+	//Null when the processor doesn't support it.
+	accumulate_function get_accumulate_sse2();
+	//The fastest function for this processor.
+	accumulate_function get_accumulate();
+
+	//Each edge adds the exact area it covers in every pixel of each row it crosses
+	//to the cell it starts in, and the rest to the next cell, so that a prefix sum
+	//along the row gives the coverage. This is the same approach as font-rs.
+	class rasterizer
+	{
+	public:
+		rasterizer() = default;
+		explicit rasterizer(accumulate_function);
+
+		//Clears the accumulation and sets the size of the output.
+		void reset(uint32_t, uint32_t);
+		//Points are in pixels, with the origin at the top left of the output.
+		//Anything outside the output is clipped.
+		void add_line(const path_geometry::point &, const path_geometry::point &);
+		void add_polygons(const path_geometry::polygon_set &, const path_geometry::transform &);
+		//Writes the coverage and leaves the accumulation cleared for the next shape.
+		void resolve(uint8_t *, size_t);
+
+		uint32_t width() const;
+		uint32_t height() const;
+
+	private:
+		void add_edge(path_geometry::point, path_geometry::point);
+
+		accumulate_function m_accumulate = get_accumulate();
+		std::vector<float> m_cells;
+		size_t m_stride{};
+		uint32_t m_width{};
+		uint32_t m_height{};
+	};
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "debugger_sink.h"
+
+namespace async_log
+{
+	void debugger_sink::write(severity, std::wstring_view line)
+	{
+		m_line.assign(line);
+		m_line += L'\n';
+		OutputDebugStringW(m_line.c_str());
+	}
+}
\ No newline at end of file
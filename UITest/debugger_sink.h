@@ -0,0 +1,27 @@
+#pragma once
+
+#include "framework.h"
+#include "async_log.h"
+
+#include <string>
+
+namespace async_log
+{
+	//Writes each line to the debugger with OutputDebugStringW.
+	class debugger_sink : public log_sink
+	{
+	public:
+		debugger_sink() = default;
+
+		void write(severity, std::wstring_view) override;
+
+	private:
+		debugger_sink(const debugger_sink &) = delete;
+		debugger_sink(debugger_sink &&) = delete;
+		debugger_sink &operator=(const debugger_sink &) = delete;
+		debugger_sink &operator=(debugger_sink &&) = delete;
+
+		//Reused between lines, OutputDebugStringW needs a terminated string.
+		std::wstring m_line;
+	};
+}
\ No newline at end of file
@@ -1,11 +1,30 @@
 #include "draw_interface.h"
 
-#include <application_helper.hpp>
+#include "async_log.h"
+#include "color_convert.h"
+#include "task_executor.h"
+#include "wic_image_decoder.h"
 
 #include <windows.ui.composition.interop.h>
 
+#include <chrono>
+#include <cmath>
+
 namespace draw_interface
 {
+	namespace
+	{
+		constexpr float hud_margin = 8.f;
+		constexpr D2D1_SIZE_F canvas_size{ 16384.f, 16384.f };
+		//Layers are sized in steps so small changes in content size don't resize them.
+		constexpr LONG layer_size_step = 64;
+
+		LONG round_up_layer_size(LONG size)
+		{
+			return (size + layer_size_step - 1) / layer_size_step * layer_size_step;
+		}
+	}
+
 	draw_interface::draw_interface(HWND target_window) noexcept : m_target_window{ target_window }, m_compositor{}
 	{}
 
@@ -35,6 +54,17 @@ namespace draw_interface
 		m_compositor = compositor;
 	}
 
+	void draw_interface::set_surface_config(const surface_config::surface_config &config)
+	{
+		_ASSERTE(m_init_state == init_state::uninit);
+		if (m_init_state != init_state::uninit)
+		{
+			__fastfail(FAST_FAIL_UNEXPECTED_CALL);
+		}
+
+		m_surface_config = config;
+	}
+
 	void draw_interface::init_device_independent_resources()
 	{
 		try
@@ -42,6 +72,9 @@ namespace draw_interface
 			_ASSERTE(m_init_state == init_state::uninit);
 
 			init_factories();
+			init_glyph_cache();
+			init_image_pipeline();
+			m_perf_hud.init_device_independent_resources(m_dwrite_factory.get());
 			init_composition_target();
 
 			m_init_state = init_state::device_independent;
@@ -59,6 +92,8 @@ namespace draw_interface
 		{
 			_ASSERTE(m_init_state == init_state::device_independent);
 			m_init_state = init_state::uninit;
+			m_perf_hud.cleanup_device_independent_resources();
+			cleanup_glyph_cache();
 			cleanup_factories();
 			cleanup_composition_target();
 		}
@@ -164,6 +199,10 @@ namespace draw_interface
 			{
 				m_visible = true;
 			}
+			m_dimentions = dimentions_cache;
+			++m_resize_count;
+			m_static_dirty = true;
+			m_text_dirty = true;
 
 			if (m_init_state == init_state::device_dependent)
 			{
@@ -177,6 +216,7 @@ namespace draw_interface
 				resize_composition_objects(dimentions_cache);
 			}
 			set_render_targets();
+			request_image();
 		}
 		catch (...)
 		{
@@ -189,6 +229,7 @@ namespace draw_interface
 	void draw_interface::resize_hide()
 	{
 		m_visible = false;
+		++m_minimise_count;
 	}
 
 	void draw_interface::handle_device_lost()
@@ -200,16 +241,31 @@ namespace draw_interface
 	{
 		if (m_init_state != init_state::fail)
 		{
-			application::helper::writeln_debugger(L"Reset should only be called when there was a failure.");
+			ASYNC_LOG(warning, L"Reset should only be called when there was a failure.");
 		}
 
+		m_text_layer = {};
+		m_hud_layer = {};
 		m_sc_visual = nullptr;
 		m_root_visual = nullptr;
-		m_dwrite_textlayout = nullptr;
-		m_dwrite_textformat = nullptr;
+		m_text_glyphs.clear();
+		m_glyph_bitmaps.clear();
 		m_d2d1_render_target = nullptr;
 		m_d3d11_render_target = nullptr;
 		m_dxgi_swapchain = nullptr;
+		m_d2d1_image = nullptr;
+		m_image_request = {};
+		if (m_canvas)
+		{
+			m_canvas->cleanup_device_dependent_resources();
+			m_canvas_scene->cleanup_device_dependent_resources();
+		}
+		if (m_vector_shapes)
+		{
+			m_vector_shapes->cleanup_device_dependent_resources();
+		}
+		m_perf_hud.cleanup_device_dependent_resources();
+		m_perf_hud.cleanup_device_independent_resources();
 		m_d2d1_text_brush = nullptr;
 		m_d2d1_decivecontext = nullptr;
 		m_d2d1_device = nullptr;
@@ -217,53 +273,477 @@ namespace draw_interface
 		m_d3d11_device = nullptr;
 		m_d3d_feature_level = {};
 		m_dxgi_adapter = nullptr;
+		m_text_font = {};
 		m_dwrite_factory = nullptr;
 		m_d2d1_factory = nullptr;
 		m_composition_target = nullptr;
 		m_dxgi_factory = nullptr;
 		m_visible = false;
 
-		application::helper::writeln_debugger(L"Drawing interface reset.");
+		ASYNC_LOG(info, L"Drawing interface reset.");
 		m_init_state = init_state::uninit;
 	}
 
-	void draw_interface::update_frame()
+	bool draw_interface::update_frame()
 	{
-		if (m_visible && !m_sizing)
+		if (!m_visible || m_sizing)
+		{
+			return false;
+		}
+
+		auto frame_start = perf_hud::clock::now();
+		m_frame_hud_time = {};
+		m_frame_present_time = {};
+
+		++m_frame_count;
+		update_text();
+		update_image();
+		update_canvas();
+
+		if (m_layered)
 		{
-			++m_frame_count;
-			update_text();
+			draw_layered_frame();
+		}
+		else
+		{
+			draw_full_frame();
+		}
 
+		if (m_perf_hud.is_enabled())
+		{
+			m_perf_hud.add_frame({ frame_start, perf_hud::clock::now(), m_frame_hud_time, m_frame_present_time });
+		}
+
+		return true;
+	}
+
+	void draw_interface::draw_full_frame()
+	{
+		m_d2d1_decivecontext->BeginDraw();
+
+		draw_background();
+		draw_text_glyphs();
+		m_d2d1_decivecontext->EndDraw();
+
+		//Direct2D only records commands until EndDraw, so the overlay gets a
+		//BeginDraw and EndDraw of its own for the time to include rendering it.
+		if (m_perf_hud.is_enabled())
+		{
+			auto hud_start = perf_hud::clock::now();
 			m_d2d1_decivecontext->BeginDraw();
+			auto target_size = m_d2d1_decivecontext->GetSize();
+			auto panel_size = perf_hud::perf_hud::get_panel_size();
+			draw_hud(D2D1::Point2F(std::max(target_size.width - panel_size.width - hud_margin, 0.f), hud_margin));
+			m_d2d1_decivecontext->EndDraw();
+			m_frame_hud_time += perf_hud::clock::now() - hud_start;
+		}
 
-			m_d2d1_decivecontext->Clear(D2D1::ColorF(D2D1::ColorF::HotPink));
-			m_d2d1_decivecontext->DrawTextLayout(D2D1::Point2F(50.f, 50.f), m_dwrite_textlayout.get(), m_d2d1_text_brush.get());
+		present(m_dxgi_swapchain.get());
+	}
 
+	void draw_interface::draw_layered_frame()
+	{
+		//Static content lives in the window sized swap chain and is only
+		//presented again after a resize or when the image arrives.
+		if (m_static_dirty)
+		{
+			m_d2d1_decivecontext->SetTarget(m_d2d1_render_target.get());
+			m_d2d1_decivecontext->BeginDraw();
+			draw_background();
 			m_d2d1_decivecontext->EndDraw();
-			m_dxgi_swapchain->Present(1, 0);
+			present(m_dxgi_swapchain.get());
+			m_static_dirty = false;
+		}
+
+		//The text layer is only large enough for the text, and only changes with the counter.
+		if (m_text_dirty && !m_text_glyphs.empty())
+		{
+			fit_text_layer();
+			begin_layer_draw(m_text_layer);
+			m_d2d1_decivecontext->SetTransform(D2D1::Matrix3x2F::Translation(-m_text_bounds.left, -m_text_bounds.top));
+			draw_text_glyphs();
+			m_d2d1_decivecontext->SetTransform(D2D1::Matrix3x2F::Identity());
+			end_layer_draw(m_text_layer);
+			m_text_dirty = false;
+		}
+
+		//The overlay changes every frame, its present is counted as part of its own cost.
+		if (m_perf_hud.is_enabled())
+		{
+			auto hud_start = perf_hud::clock::now();
+			auto present_time = m_frame_present_time;
+
+			begin_layer_draw(m_hud_layer);
+			draw_hud(D2D1::Point2F(0.f, 0.f));
+			end_layer_draw(m_hud_layer);
+
+			m_frame_present_time = present_time;
+			m_frame_hud_time += perf_hud::clock::now() - hud_start;
+		}
+	}
+
+	void draw_interface::draw_background()
+	{
+		frame_scene::draw_background(m_d2d1_decivecontext.get(), m_surface_config);
+		if (m_canvas)
+		{
+			m_canvas->draw(m_d2d1_decivecontext.get());
+			if (m_highlight)
+			{
+				m_canvas_scene->draw_highlight(m_d2d1_decivecontext.get(), *m_highlight, m_canvas->get_transform());
+			}
+		}
+		if (m_d2d1_image)
+		{
+			auto image_size = m_d2d1_image->GetSize();
+			m_d2d1_decivecontext->DrawBitmap(m_d2d1_image.get(), D2D1::RectF(0.f, 0.f, image_size.width, image_size.height));
+		}
+		if (m_vector_shapes)
+		{
+			m_vector_shapes->draw(m_d2d1_decivecontext.get());
+		}
+	}
+
+	void draw_interface::present(IDXGISwapChain4 *swapchain)
+	{
+		auto present_start = perf_hud::clock::now();
+		swapchain->Present(m_present_interval, 0);
+		m_frame_present_time += perf_hud::clock::now() - present_start;
+	}
+
+	void draw_interface::draw_hud(const D2D1_POINT_2F &origin)
+	{
+		auto now = perf_hud::clock::now();
+		if (m_perf_hud.is_refresh_due(now))
+		{
+			perf_hud::hud_counters counters{};
+			counters.resizes = m_resize_count;
+			counters.minimises = m_minimise_count;
+			counters.glyph_hits = m_glyph_cache.hit_count();
+			counters.glyph_misses = m_glyph_cache.miss_count();
+			if (m_image_pipeline)
+			{
+				auto image_stats = m_image_pipeline->get_cache_stats();
+				counters.image_hits = image_stats.hits + image_stats.deduplicated;
+				counters.image_misses = image_stats.misses;
+			}
+			if (m_canvas)
+			{
+				auto canvas_stats = m_canvas->get_stats();
+				counters.tile_hits = canvas_stats.hits;
+				counters.tile_misses = canvas_stats.misses;
+				counters.tiles_resident = canvas_stats.tiles_resident;
+			}
+			auto task_stats = task_executor::task_executor::get_shared().get_stats();
+			for (auto queued : task_stats.queued)
+			{
+				counters.tasks_queued += queued;
+			}
+			counters.tasks_stolen = task_stats.stolen;
+
+			m_perf_hud.refresh(counters, now);
 		}
+
+		m_perf_hud.draw(m_d2d1_decivecontext.get(), origin);
 	}
 
 	void draw_interface::update_text()
 	{
-		using namespace winrt;
 		if ((m_frame_count % 60) == 0)
 		{
 			++m_text_value;
 
-			auto fmt_string = std::format(L"Text value: {}.", m_text_value);
+			build_text_glyphs();
+		}
+	}
+
+	void draw_interface::build_text_glyphs()
+	{
+		bool cache_updated = false;
+		auto run = frame_scene::layout_text(m_text_font, frame_scene::format_text(m_text_value), [this, &cache_updated](uint16_t glyph_index)
+			{
+				glyph_cache::glyph_key key{ m_text_font.font_id, frame_scene::text_em_size, glyph_index };
+				glyph_cache::glyph_view view{};
+				if (!m_glyph_cache.find(key, view))
+				{
+					auto [metrics, bitmap] = glyph_cache::rasterize_glyph(m_dwrite_factory.get(), m_text_font.font_face.get(), frame_scene::text_em_size, glyph_index);
+					view = m_glyph_cache.insert(key, metrics, std::move(bitmap));
+					cache_updated = true;
+				}
+
+				return std::make_pair(view.metrics, get_glyph_bitmap(key, view));
+			});
+
+		m_text_glyphs = std::move(run.glyphs);
+		m_text_bounds = run.bounds;
+		m_text_dirty = true;
+
+		if (cache_updated)
+		{
+			m_glyph_cache.flush_async();
+		}
+	}
+
+	winrt::com_ptr<ID2D1Bitmap1> draw_interface::get_glyph_bitmap(const glyph_cache::glyph_key &key, const glyph_cache::glyph_view &view)
+	{
+		auto it = m_glyph_bitmaps.find(key);
+		if (it != m_glyph_bitmaps.end())
+		{
+			return it->second;
+		}
+
+		auto bitmap = frame_scene::make_glyph_bitmap(m_d2d1_decivecontext.get(), view.metrics, view.bitmap);
+
+		m_glyph_bitmaps.emplace(key, bitmap);
+		return bitmap;
+	}
+
+	void draw_interface::draw_text_glyphs()
+	{
+		frame_scene::draw_text(m_d2d1_decivecontext.get(), m_d2d1_text_brush.get(), m_text_glyphs);
+	}
+
+	void draw_interface::set_image(const std::filesystem::path &path)
+	{
+		m_image_path = path;
+		m_d2d1_image = nullptr;
+		m_image_request = {};
+
+		if (m_init_state == init_state::sized)
+		{
+			request_image();
+		}
+	}
+
+	void draw_interface::toggle_hud()
+	{
+		m_perf_hud.toggle();
+
+		if (m_hud_layer.visual)
+		{
+			m_hud_layer.visual.IsVisible(m_perf_hud.is_enabled());
+		}
+	}
+
+	void draw_interface::set_layered(bool layered)
+	{
+		if (m_layered == layered)
+		{
+			return;
+		}
+
+		m_layered = layered;
+
+		//The window has normally been sized by the time this is called,
+		//so the visual tree is rebuilt for the new mode.
+		if (m_init_state == init_state::sized)
+		{
+			try
+			{
+				cleanup_composition_objects();
+				create_composition_objects(m_dimentions);
+				set_render_targets();
+				m_static_dirty = true;
+				m_text_dirty = true;
+			}
+			catch (...)
+			{
+				m_init_state = init_state::fail;
+				throw;
+			}
+		}
+	}
+
+	void draw_interface::set_canvas(bool enabled)
+	{
+		if (enabled == (m_canvas != nullptr))
+		{
+			return;
+		}
+
+		if (enabled)
+		{
+			auto scene = std::make_unique<canvas_scene::canvas_scene>(canvas_size);
+			auto canvas = std::make_unique<tiled_canvas::tiled_canvas>(canvas_size, [scene = scene.get()](ID2D1DeviceContext *device_context, ID2D1SolidColorBrush *brush, const D2D1_RECT_F &rect)
+				{
+					scene->draw(device_context, brush, rect);
+				});
+			if (m_d2d1_decivecontext)
+			{
+				scene->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+				canvas->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+			}
+			m_canvas_scene = std::move(scene);
+			m_canvas = std::move(canvas);
+		}
+		else
+		{
+			m_canvas.reset();
+			m_canvas_scene.reset();
+			m_highlight.reset();
+		}
+
+		m_static_dirty = true;
+	}
+
+	void draw_interface::scroll_canvas(float x, float y)
+	{
+		if (m_canvas)
+		{
+			m_canvas->scroll(x, y);
+		}
+	}
+
+	void draw_interface::zoom_canvas(int32_t steps, const D2D1_POINT_2F &anchor)
+	{
+		if (m_canvas)
+		{
+			m_canvas->zoom(steps, anchor);
+		}
+	}
+
+	void draw_interface::set_pointer(const D2D1_POINT_2F &point)
+	{
+		m_pointer = point;
+	}
+
+	void draw_interface::clear_pointer()
+	{
+		m_pointer.reset();
+	}
+
+	void draw_interface::set_shapes(bool enabled)
+	{
+		if (enabled == (m_vector_shapes != nullptr))
+		{
+			return;
+		}
+
+		if (enabled)
+		{
+			auto shapes = std::make_unique<vector_shapes::vector_shapes>();
+			if (m_d2d1_decivecontext)
+			{
+				shapes->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+			}
+			m_vector_shapes = std::move(shapes);
+		}
+		else
+		{
+			m_vector_shapes.reset();
+		}
+
+		m_static_dirty = true;
+	}
+
+	void draw_interface::set_present_interval(UINT interval)
+	{
+		m_present_interval = interval;
+	}
+
+	void draw_interface::request_image()
+	{
+		//Resizing asks for a version of the image that fits the new size,
+		//the current bitmap stays on screen until that is ready.
+		//Only one request is outstanding at a time, update_image asks again
+		//if the window size changed while it was being decoded.
+		if (m_image_path.empty() || !m_image_pipeline || m_image_request.valid())
+		{
+			return;
+		}
+
+		image_pipeline::image_size target{ static_cast<uint32_t>(m_dimentions.cx), static_cast<uint32_t>(m_dimentions.cy) };
+		m_image_request = m_image_pipeline->request(m_image_path, target);
+		m_image_target = m_dimentions;
+	}
+
+	void draw_interface::update_image()
+	{
+		using namespace winrt;
+		using namespace std::chrono_literals;
+
+		if (!m_image_request.valid() || m_image_request.wait_for(0s) != std::future_status::ready)
+		{
+			return;
+		}
+
+		auto request = std::move(m_image_request);
+		m_image_request = {};
+
+		image_pipeline::image_ptr image;
+		try
+		{
+			image = request.get();
+		}
+		catch (...)
+		{
+			ASYNC_LOG(error, L"Failed to decode image {}.", m_image_path.native());
+			m_image_path.clear();
+			return;
+		}
+
+		m_d2d1_image = make_image_bitmap(*image);
+		m_static_dirty = true;
+
+		if (m_image_target.cx != m_dimentions.cx || m_image_target.cy != m_dimentions.cy)
+		{
+			request_image();
+		}
+	}
+
+	void draw_interface::update_canvas()
+	{
+		//Tiles are rasterised before the frame is drawn, since that needs the device context.
+		if (!m_canvas)
+		{
+			return;
+		}
+
+		m_canvas->set_viewport_size(D2D1::SizeF(static_cast<float>(m_dimentions.cx), static_cast<float>(m_dimentions.cy)));
+		m_canvas->update();
 
-			m_dwrite_textlayout = nullptr;
-			m_dwrite_textformat = nullptr;
+		if (m_canvas->take_changed())
+		{
+			m_static_dirty = true;
+		}
+
+		//Hit testing runs every frame rather than on mouse move, since scrolling
+		//and zooming also change what is under the pointer.
+		std::optional<spatial_index::element_id> highlight;
+		if (m_pointer)
+		{
+			highlight = m_canvas_scene->hit_test(m_canvas->window_to_canvas(*m_pointer));
+		}
+		if (highlight != m_highlight)
+		{
+			m_highlight = highlight;
+			m_static_dirty = true;
+		}
+	}
+
+	winrt::com_ptr<ID2D1Bitmap1> draw_interface::make_image_bitmap(const image_pipeline::decoded_image &image)
+	{
+		using namespace winrt;
 
-			com_ptr<IDWriteTextFormat> text_format;
-			com_ptr<IDWriteTextLayout> text_layout;
-			check_hresult(m_dwrite_factory->CreateTextFormat(L"Arial", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 36.f, L"en-gb", text_format.put()));
-			check_hresult(m_dwrite_factory->CreateTextLayout(fmt_string.data(), static_cast<UINT32>(fmt_string.size()), text_format.get(), 500.f, 500.f, text_layout.put()));
+		com_ptr<ID2D1Bitmap1> bitmap;
+		if (!m_surface_config.is_linear())
+		{
+			auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+			check_hresult(m_d2d1_decivecontext->CreateBitmap(D2D1::SizeU(image.size.width, image.size.height), image.pixels.data(), image.stride, bps, bitmap.put()));
+			return bitmap;
+		}
 
-			m_dwrite_textformat = text_format.as<IDWriteTextFormat3>();
-			m_dwrite_textlayout = text_layout.as<IDWriteTextLayout4>();
+		//Decoded images are sRGB, a linear surface gets them converted once here
+		//rather than Direct2D treating the sRGB values as linear.
+		std::vector<uint16_t> linear_pixels(static_cast<size_t>(image.size.width) * image.size.height * 4);
+		for (uint32_t row = 0; row < image.size.height; ++row)
+		{
+			color_convert::bgra8_to_rgba16f(image.pixels.data() + static_cast<size_t>(row) * image.stride, linear_pixels.data() + static_cast<size_t>(row) * image.size.width * 4, image.size.width);
 		}
+
+		auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_R16G16B16A16_FLOAT, D2D1_ALPHA_MODE_PREMULTIPLIED));
+		check_hresult(m_d2d1_decivecontext->CreateBitmap(D2D1::SizeU(image.size.width, image.size.height), linear_pixels.data(), image.size.width * 8, bps, bitmap.put()));
+		return bitmap;
 	}
 
 	bool draw_interface::is_failed() const
@@ -313,6 +793,37 @@ namespace draw_interface
 		m_dxgi_factory = nullptr;
 	}
 
+	void draw_interface::init_glyph_cache()
+	{
+		//The font face is needed to identify the font even when every glyph
+		//is already in the cache, but creating it doesn't rasterise anything.
+		m_text_font = frame_scene::load_text_font(m_dwrite_factory.get());
+
+		m_glyph_cache.open(glyph_cache::glyph_cache::default_path());
+	}
+
+	void draw_interface::init_image_pipeline()
+	{
+		//The pipeline has no device dependency, so it survives a reset.
+		if (m_image_pipeline)
+		{
+			return;
+		}
+
+		std::vector<std::unique_ptr<image_pipeline::image_decoder>> decoders;
+		decoders.push_back(std::make_unique<image_pipeline::qoi_decoder>());
+		decoders.push_back(std::make_unique<image_pipeline::ppm_decoder>());
+		decoders.push_back(std::make_unique<image_pipeline::wic_image_decoder>());
+
+		m_image_pipeline = std::make_unique<image_pipeline::image_pipeline>(std::move(decoders));
+	}
+
+	void draw_interface::cleanup_glyph_cache()
+	{
+		m_glyph_cache.close();
+		m_text_font = {};
+	}
+
 	void draw_interface::init_composition_target()
 	{
 		using namespace winrt;
@@ -385,16 +896,31 @@ namespace draw_interface
 		check_hresult(m_d2d1_factory->CreateDevice(dxgi_device.get(), d2d_device.put()));
 		check_hresult(d2d_device->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, d2d_devicectx.put()));
 
-		check_hresult(d2d_devicectx->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), d2d_text_brush.put()));
+		check_hresult(d2d_devicectx->CreateSolidColorBrush(m_surface_config.colour(D2D1::ColorF(D2D1::ColorF::Black)), d2d_text_brush.put()));
 
 		m_d2d1_device = d2d_device.as<ID2D1Device7>();
 		m_d2d1_decivecontext = d2d_devicectx.as<ID2D1DeviceContext7>();
 		m_d2d1_text_brush = d2d_text_brush;
+
+		m_perf_hud.init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+		if (m_canvas)
+		{
+			m_canvas_scene->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+			m_canvas->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+		}
+		if (m_vector_shapes)
+		{
+			m_vector_shapes->init_device_dependent_resources(m_d2d1_decivecontext.get(), m_surface_config);
+		}
 	}
 
 	void draw_interface::init_dwrite()
 	{
 		update_text();
+		if (m_text_glyphs.empty())
+		{
+			build_text_glyphs();
+		}
 	}
 
 	void draw_interface::cleanup_dxgi()
@@ -411,6 +937,20 @@ namespace draw_interface
 
 	void draw_interface::cleanup_d2d1()
 	{
+		if (m_vector_shapes)
+		{
+			m_vector_shapes->cleanup_device_dependent_resources();
+		}
+		if (m_canvas)
+		{
+			m_canvas->cleanup_device_dependent_resources();
+			m_canvas_scene->cleanup_device_dependent_resources();
+		}
+		m_perf_hud.cleanup_device_dependent_resources();
+		m_d2d1_image = nullptr;
+		m_image_request = {};
+		m_text_glyphs.clear();
+		m_glyph_bitmaps.clear();
 		m_d2d1_text_brush = nullptr;
 		m_d2d1_decivecontext = nullptr;
 		m_d2d1_device = nullptr;
@@ -418,8 +958,7 @@ namespace draw_interface
 
 	void draw_interface::cleanup_dwrite()
 	{
-		m_dwrite_textlayout = nullptr;
-		m_dwrite_textformat = nullptr;
+		m_text_glyphs.clear();
 	}
 
 	void draw_interface::create_render_targets()
@@ -435,7 +974,7 @@ namespace draw_interface
 
 		D2D1_BITMAP_PROPERTIES1 bps{};
 		com_ptr<ID2D1Bitmap1> back_buffer_bitmap;
-		bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_CANNOT_DRAW | D2D1_BITMAP_OPTIONS_TARGET, D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+		bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_CANNOT_DRAW | D2D1_BITMAP_OPTIONS_TARGET, D2D1::PixelFormat(m_surface_config.get_dxgi_format(), D2D1_ALPHA_MODE_PREMULTIPLIED));
 		m_d2d1_decivecontext->CreateBitmapFromDxgiSurface(back_buffer_surface.get(), bps, back_buffer_bitmap.put());
 
 		m_d3d11_render_target = back_buffer.as<ID3D11Texture2D1>();
@@ -444,12 +983,18 @@ namespace draw_interface
 
 	void draw_interface::create_swapchain(const SIZEL &dimentions)
 	{
-		using namespace winrt;
 		//This creates the IDXGISwapChain.
+		m_dxgi_swapchain = make_swapchain(dimentions);
+	}
+
+	winrt::com_ptr<IDXGISwapChain4> draw_interface::make_swapchain(const SIZEL &dimentions)
+	{
+		using namespace winrt;
+
 		DXGI_SWAP_CHAIN_DESC1 scd{};
 		scd.Width = dimentions.cx;
 		scd.Height = dimentions.cy;
-		scd.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		scd.Format = m_surface_config.get_dxgi_format();
 		scd.SampleDesc = { 1,0 };
 		scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 		scd.BufferCount = 2;
@@ -459,20 +1004,43 @@ namespace draw_interface
 		com_ptr<IDXGISwapChain1> dxgi_sc;
 		check_hresult(m_dxgi_factory->CreateSwapChainForComposition(m_d3d11_device.get(), &scd, nullptr, dxgi_sc.put()));
 
-		m_dxgi_swapchain = dxgi_sc.as<IDXGISwapChain4>();
+		auto swapchain = dxgi_sc.as<IDXGISwapChain4>();
+		if (m_surface_config.is_linear())
+		{
+			//Half float buffers are only read as scRGB once the colour space is set.
+			UINT colour_space_support = 0;
+			check_hresult(swapchain->CheckColorSpaceSupport(m_surface_config.get_colour_space(), &colour_space_support));
+			if ((colour_space_support & DXGI_SWAP_CHAIN_COLOR_SPACE_SUPPORT_FLAG_PRESENT) == 0)
+			{
+				throw_hresult(DXGI_ERROR_UNSUPPORTED);
+			}
+			check_hresult(swapchain->SetColorSpace1(m_surface_config.get_colour_space()));
+		}
+
+		return swapchain;
 	}
 
-	void draw_interface::create_composition_objects(const SIZEL &dimentions)
+	winrt::com_ptr<ID2D1Bitmap1> draw_interface::make_swapchain_target(IDXGISwapChain4 *swapchain)
 	{
-		//This creates the WUC.ContainerVisual
-		//and the WUC.SpriteVisual for the swap chain.
 		using namespace winrt;
 
-		auto container = m_compositor.CreateContainerVisual();
+		com_ptr<IDXGISurface> back_buffer_surface;
+		check_hresult(swapchain->GetBuffer(0, IID_PPV_ARGS(back_buffer_surface.put())));
+
+		com_ptr<ID2D1Bitmap1> back_buffer_bitmap;
+		auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_CANNOT_DRAW | D2D1_BITMAP_OPTIONS_TARGET, D2D1::PixelFormat(m_surface_config.get_dxgi_format(), D2D1_ALPHA_MODE_PREMULTIPLIED));
+		check_hresult(m_d2d1_decivecontext->CreateBitmapFromDxgiSurface(back_buffer_surface.get(), bps, back_buffer_bitmap.put()));
+
+		return back_buffer_bitmap;
+	}
+
+	winrt::Windows::UI::Composition::SpriteVisual draw_interface::make_swapchain_visual(IDXGISwapChain4 *swapchain)
+	{
+		using namespace winrt;
 
 		winrt::Windows::UI::Composition::ICompositionSurface swap_chain_surface{ nullptr };
 		auto compositor_interop = m_compositor.as<ABI::Windows::UI::Composition::ICompositorInterop>();
-		check_hresult(compositor_interop->CreateCompositionSurfaceForSwapChain(m_dxgi_swapchain.get(), reinterpret_cast<ABI::Windows::UI::Composition::ICompositionSurface **>(put_abi(swap_chain_surface))));
+		check_hresult(compositor_interop->CreateCompositionSurfaceForSwapChain(swapchain, reinterpret_cast<ABI::Windows::UI::Composition::ICompositionSurface **>(put_abi(swap_chain_surface))));
 
 		auto swap_chain_brush = m_compositor.CreateSurfaceBrush(swap_chain_surface);
 		swap_chain_brush.Stretch(winrt::Windows::UI::Composition::CompositionStretch::None);
@@ -481,6 +1049,19 @@ namespace draw_interface
 		auto swap_chain_visual = m_compositor.CreateSpriteVisual();
 		swap_chain_visual.Brush(swap_chain_brush);
 
+		return swap_chain_visual;
+	}
+
+	void draw_interface::create_composition_objects(const SIZEL &dimentions)
+	{
+		//This creates the WUC.ContainerVisual
+		//and the WUC.SpriteVisual for the swap chain.
+		//In layered mode it also creates the text and overlay layers above it.
+		using namespace winrt;
+
+		auto container = m_compositor.CreateContainerVisual();
+		auto swap_chain_visual = make_swapchain_visual(m_dxgi_swapchain.get());
+
 		m_root_visual = container;
 		m_sc_visual = swap_chain_visual;
 		container.Children().InsertAtBottom(swap_chain_visual);
@@ -488,6 +1069,84 @@ namespace draw_interface
 
 		auto float_dimentions = winrt::Windows::Foundation::Numerics::float2{ static_cast<float>(dimentions.cx), static_cast<float>(dimentions.cy) };
 		m_sc_visual.Size(float_dimentions);
+
+		if (m_layered)
+		{
+			auto panel_size = perf_hud::perf_hud::get_panel_size();
+
+			create_layer(m_text_layer, { layer_size_step, layer_size_step });
+			create_layer(m_hud_layer, { round_up_layer_size(static_cast<LONG>(std::ceil(panel_size.width))), round_up_layer_size(static_cast<LONG>(std::ceil(panel_size.height))) });
+			m_hud_layer.visual.IsVisible(m_perf_hud.is_enabled());
+			//The overlay layer is anchored to the top right corner of the window.
+			m_hud_layer.visual.AnchorPoint({ 1.f, 0.f });
+			m_hud_layer.visual.RelativeOffsetAdjustment({ 1.f, 0.f, 0.f });
+			m_hud_layer.visual.Offset({ -hud_margin, hud_margin, 0.f });
+
+			m_static_dirty = true;
+			m_text_dirty = true;
+		}
+	}
+
+	void draw_interface::create_layer(composition_layer &layer, const SIZEL &size)
+	{
+		using namespace winrt;
+
+		layer.swapchain = make_swapchain(size);
+		layer.target = make_swapchain_target(layer.swapchain.get());
+		layer.visual = make_swapchain_visual(layer.swapchain.get());
+		layer.size = size;
+		layer.visual.Size({ static_cast<float>(size.cx), static_cast<float>(size.cy) });
+
+		m_root_visual.as<winrt::Windows::UI::Composition::ContainerVisual>().Children().InsertAtTop(layer.visual);
+	}
+
+	void draw_interface::resize_layer(composition_layer &layer, const SIZEL &size)
+	{
+		using namespace winrt;
+
+		//All references to the buffers have to go before they can be resized.
+		m_d2d1_decivecontext->SetTarget(nullptr);
+		layer.target = nullptr;
+
+		check_hresult(layer.swapchain->ResizeBuffers(0, size.cx, size.cy, DXGI_FORMAT_UNKNOWN, 0));
+		layer.target = make_swapchain_target(layer.swapchain.get());
+		layer.size = size;
+		layer.visual.Size({ static_cast<float>(size.cx), static_cast<float>(size.cy) });
+	}
+
+	void draw_interface::cleanup_layer(composition_layer &layer)
+	{
+		if (layer.visual && m_root_visual)
+		{
+			m_root_visual.as<winrt::Windows::UI::Composition::ContainerVisual>().Children().Remove(layer.visual);
+		}
+
+		layer = {};
+	}
+
+	void draw_interface::begin_layer_draw(composition_layer &layer)
+	{
+		m_d2d1_decivecontext->SetTarget(layer.target.get());
+		m_d2d1_decivecontext->BeginDraw();
+		m_d2d1_decivecontext->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+	}
+
+	void draw_interface::end_layer_draw(composition_layer &layer)
+	{
+		m_d2d1_decivecontext->EndDraw();
+		present(layer.swapchain.get());
+	}
+
+	void draw_interface::fit_text_layer()
+	{
+		//The layer follows the text and only ever grows.
+		SIZEL needed{ static_cast<LONG>(std::ceil(m_text_bounds.right - m_text_bounds.left)), static_cast<LONG>(std::ceil(m_text_bounds.bottom - m_text_bounds.top)) };
+		if (needed.cx > m_text_layer.size.cx || needed.cy > m_text_layer.size.cy)
+		{
+			resize_layer(m_text_layer, { round_up_layer_size(std::max(needed.cx, m_text_layer.size.cx)), round_up_layer_size(std::max(needed.cy, m_text_layer.size.cy)) });
+		}
+
+		m_text_layer.visual.Offset({ m_text_bounds.left, m_text_bounds.top, 0.f });
 	}
 
 	void draw_interface::cleanup_render_targets()
@@ -506,6 +1165,8 @@ namespace draw_interface
 
 	void draw_interface::cleanup_composition_objects()
 	{
+		cleanup_layer(m_hud_layer);
+		cleanup_layer(m_text_layer);
 		m_sc_visual = nullptr;
 		m_root_visual = nullptr;
 		m_composition_target.Root(nullptr);
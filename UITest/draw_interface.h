@@ -1,6 +1,21 @@
 #pragma once
 
 #include "framework.h"
+#include "canvas_scene.h"
+#include "frame_scene.h"
+#include "glyph_cache.h"
+#include "image_pipeline.h"
+#include "perf_hud.h"
+#include "surface_config.h"
+#include "tiled_canvas.h"
+#include "vector_shapes.h"
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace draw_interface
 {
@@ -22,6 +37,8 @@ namespace draw_interface
 
 		winrt::Windows::UI::Composition::Compositor get_compositor() const;
 		void change_compositor(const winrt::Windows::UI::Composition::Compositor &);
+		//This has to be set before any resources are initialised.
+		void set_surface_config(const surface_config::surface_config &);
 
 		void init_device_independent_resources();
 		void cleanup_device_independent_resources();
@@ -40,13 +57,44 @@ namespace draw_interface
 		bool is_failed() const;
 		bool is_device_lost() const;
 
-		void update_frame();
+		//The image is decoded in the background, scaled to fit the window,
+		//and drawn behind the text once it is ready.
+		void set_image(const std::filesystem::path &);
+
+		//Zero presents without waiting for vsync, which is used for benchmarking.
+		void set_present_interval(UINT);
+
+		void toggle_hud();
+
+		//In layered mode the background, the text and the overlay each get
+		//their own swap chain and visual, and each one is only redrawn and
+		//presented when its content changes.
+		void set_layered(bool);
+
+		//Replaces the plain background with a large tiled canvas that can be
+		//scrolled and zoomed.
+		void set_canvas(bool);
+		//These do nothing unless the canvas is shown.
+		void scroll_canvas(float, float);
+		void zoom_canvas(int32_t, const D2D1_POINT_2F &);
+		//The canvas element under the pointer is highlighted.
+		void set_pointer(const D2D1_POINT_2F &);
+		void clear_pointer();
+
+		//Draws a few filled and stroked paths with the software rasteriser.
+		void set_shapes(bool);
+
+		//Returns false when nothing was drawn because the window is hidden or being sized.
+		bool update_frame();
 
 	private:
 		draw_interface() = delete;
 
 		void init_factories();
 		void cleanup_factories();
+		void init_glyph_cache();
+		void cleanup_glyph_cache();
+		void init_image_pipeline();
 		//This is only a simple example.
 		//The target that we initialise is only
 		//the lower target.
@@ -65,6 +113,10 @@ namespace draw_interface
 		void create_render_targets();
 		void create_swapchain(const SIZEL &);
 		void create_composition_objects(const SIZEL &);
+		winrt::com_ptr<IDXGISwapChain4> make_swapchain(const SIZEL &);
+		winrt::com_ptr<ID2D1Bitmap1> make_image_bitmap(const image_pipeline::decoded_image &);
+		winrt::com_ptr<ID2D1Bitmap1> make_swapchain_target(IDXGISwapChain4 *);
+		winrt::Windows::UI::Composition::SpriteVisual make_swapchain_visual(IDXGISwapChain4 *);
 
 		void cleanup_render_targets();
 		void cleanup_swap_chain();
@@ -74,6 +126,17 @@ namespace draw_interface
 		void resize_composition_objects(const SIZEL &);
 
 		void update_text();
+		void build_text_glyphs();
+		winrt::com_ptr<ID2D1Bitmap1> get_glyph_bitmap(const glyph_cache::glyph_key &, const glyph_cache::glyph_view &);
+		void draw_text_glyphs();
+		void draw_background();
+		void draw_hud(const D2D1_POINT_2F &);
+		void draw_full_frame();
+		void draw_layered_frame();
+		void present(IDXGISwapChain4 *);
+		void request_image();
+		void update_image();
+		void update_canvas();
 
 		//DXGI interfaces.
 		//We start off with the highest version and then
@@ -95,11 +158,57 @@ namespace draw_interface
 		winrt::com_ptr<ID2D1DeviceContext7> m_d2d1_decivecontext;
 		winrt::com_ptr<ID2D1SolidColorBrush> m_d2d1_text_brush;
 		winrt::com_ptr<ID2D1Bitmap1> m_d2d1_render_target;
+		winrt::com_ptr<ID2D1Bitmap1> m_d2d1_image;
 
 		//DWrite
 		winrt::com_ptr<IDWriteFactory7> m_dwrite_factory;
-		winrt::com_ptr<IDWriteTextLayout4> m_dwrite_textlayout;
-		winrt::com_ptr<IDWriteTextFormat3> m_dwrite_textformat;
+
+		//Text is drawn from cached glyph bitmaps rather than a text layout.
+		//The glyph cache persists between runs, so the first frame doesn't
+		//have to wait for rasterisation.
+		glyph_cache::glyph_cache m_glyph_cache;
+		frame_scene::text_font m_text_font;
+		std::unordered_map<glyph_cache::glyph_key, winrt::com_ptr<ID2D1Bitmap1>, glyph_cache::glyph_key_hash> m_glyph_bitmaps;
+		std::vector<frame_scene::text_glyph> m_text_glyphs;
+
+		//Layers
+		struct composition_layer
+		{
+			winrt::com_ptr<IDXGISwapChain4> swapchain;
+			winrt::com_ptr<ID2D1Bitmap1> target;
+			winrt::Windows::UI::Composition::SpriteVisual visual{ nullptr };
+			SIZEL size{};
+		};
+		void create_layer(composition_layer &, const SIZEL &);
+		void resize_layer(composition_layer &, const SIZEL &);
+		void cleanup_layer(composition_layer &);
+		void begin_layer_draw(composition_layer &);
+		void end_layer_draw(composition_layer &);
+		void fit_text_layer();
+
+		composition_layer m_text_layer;
+		composition_layer m_hud_layer;
+		D2D1_RECT_F m_text_bounds{};
+		bool m_layered = false;
+		bool m_static_dirty = false;
+		bool m_text_dirty = false;
+
+		//Images
+		std::unique_ptr<image_pipeline::image_pipeline> m_image_pipeline;
+		std::filesystem::path m_image_path;
+		std::shared_future<image_pipeline::image_ptr> m_image_request;
+		SIZEL m_image_target{};
+
+		//Canvas
+		//The canvas draws from the scene, so it is declared after it.
+		std::unique_ptr<canvas_scene::canvas_scene> m_canvas_scene;
+		std::unique_ptr<tiled_canvas::tiled_canvas> m_canvas;
+		std::optional<D2D1_POINT_2F> m_pointer;
+		std::optional<spatial_index::element_id> m_highlight;
+
+		std::unique_ptr<vector_shapes::vector_shapes> m_vector_shapes;
+
+		perf_hud::perf_hud m_perf_hud;
 
 		//Composition
 		winrt::Windows::UI::Composition::Compositor m_compositor{ nullptr };
@@ -107,11 +216,18 @@ namespace draw_interface
 		winrt::Windows::UI::Composition::Visual m_root_visual{ nullptr };
 		winrt::Windows::UI::Composition::Visual m_sc_visual{ nullptr };
 
+		surface_config::surface_config m_surface_config;
 		init_state m_init_state = init_state::uninit;
 		HWND m_target_window{};
+		SIZEL m_dimentions{};
 		bool m_visible = false;
 		bool m_sizing = false;
 		uint64_t m_frame_count{};
+		uint64_t m_resize_count{};
+		uint64_t m_minimise_count{};
 		uint64_t m_text_value{ UINT64_MAX };
+		UINT m_present_interval = 1;
+		perf_hud::clock::duration m_frame_hud_time{};
+		perf_hud::clock::duration m_frame_present_time{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "frame_scene.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace frame_scene
+{
+	text_font load_text_font(IDWriteFactory7 *factory)
+	{
+		using namespace winrt;
+
+		com_ptr<IDWriteFontCollection> font_collection;
+		check_hresult(factory->GetSystemFontCollection(font_collection.put(), FALSE));
+
+		UINT32 family_index = 0;
+		BOOL family_exists = FALSE;
+		check_hresult(font_collection->FindFamilyName(text_font_family, &family_index, &family_exists));
+		if (!family_exists)
+		{
+			throw_hresult(DWRITE_E_NOFONT);
+		}
+
+		com_ptr<IDWriteFontFamily> font_family;
+		com_ptr<IDWriteFont> font;
+		com_ptr<IDWriteFontFace> font_face;
+		check_hresult(font_collection->GetFontFamily(family_index, font_family.put()));
+		check_hresult(font_family->GetFirstMatchingFont(DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STRETCH_NORMAL, DWRITE_FONT_STYLE_NORMAL, font.put()));
+		check_hresult(font->CreateFontFace(font_face.put()));
+
+		DWRITE_FONT_METRICS font_metrics{};
+		font_face->GetMetrics(&font_metrics);
+
+		text_font result{};
+		result.font_id = glyph_cache::glyph_cache::font_identity(font_face.get());
+		result.ascent = static_cast<float>(font_metrics.ascent) * text_em_size / static_cast<float>(font_metrics.designUnitsPerEm);
+		result.font_face = font_face;
+
+		return result;
+	}
+
+	std::wstring format_text(uint64_t value)
+	{
+		return std::format(L"Text value: {}.", value);
+	}
+
+	text_run layout_text(const text_font &font, std::wstring_view text, const glyph_lookup &lookup)
+	{
+		using namespace winrt;
+
+		//The text is plain ASCII, so each character maps directly to a code point.
+		std::vector<UINT32> code_points(text.begin(), text.end());
+		std::vector<UINT16> glyph_indices(code_points.size());
+		check_hresult(font.font_face->GetGlyphIndices(code_points.data(), static_cast<UINT32>(code_points.size()), glyph_indices.data()));
+
+		text_run run{ {}, { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX } };
+		run.glyphs.reserve(glyph_indices.size());
+		float pen_x = text_origin.x;
+		float baseline = std::round(text_origin.y + font.ascent);
+
+		for (auto glyph_index : glyph_indices)
+		{
+			auto [metrics, bitmap] = lookup(glyph_index);
+
+			if (bitmap)
+			{
+				//Snapping the pen to whole pixels means the bitmaps are drawn without resampling.
+				float left = std::round(pen_x) + static_cast<float>(metrics.left);
+				float top = baseline + static_cast<float>(metrics.top);
+				auto destination = D2D1::RectF(left, top, left + static_cast<float>(metrics.width), top + static_cast<float>(metrics.height));
+				run.glyphs.push_back({ std::move(bitmap), destination });
+
+				run.bounds.left = std::min(run.bounds.left, destination.left);
+				run.bounds.top = std::min(run.bounds.top, destination.top);
+				run.bounds.right = std::max(run.bounds.right, destination.right);
+				run.bounds.bottom = std::max(run.bounds.bottom, destination.bottom);
+			}
+
+			pen_x += metrics.advance;
+		}
+
+		return run;
+	}
+
+	winrt::com_ptr<ID2D1Bitmap1> make_glyph_bitmap(ID2D1DeviceContext *device_context, const glyph_cache::glyph_metrics &metrics, const uint8_t *coverage)
+	{
+		using namespace winrt;
+
+		if (metrics.width == 0 || metrics.height == 0)
+		{
+			return nullptr;
+		}
+
+		com_ptr<ID2D1Bitmap1> bitmap;
+		auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+		check_hresult(device_context->CreateBitmap(D2D1::SizeU(metrics.width, metrics.height), coverage, metrics.width, bps, bitmap.put()));
+
+		return bitmap;
+	}
+
+	void draw_background(ID2D1DeviceContext *device_context, const surface_config::surface_config &surface)
+	{
+		device_context->Clear(surface.colour(D2D1::ColorF(D2D1::ColorF::HotPink)));
+	}
+
+	void draw_text(ID2D1DeviceContext *device_context, ID2D1Brush *brush, const std::vector<text_glyph> &glyphs)
+	{
+		//FillOpacityMask requires aliased rendering.
+		device_context->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+		for (auto &glyph : glyphs)
+		{
+			device_context->FillOpacityMask(glyph.bitmap.get(), brush, &glyph.destination);
+		}
+		device_context->SetAntialiasMode(D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "framework.h"
+#include "glyph_cache.h"
+#include "surface_config.h"
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+//The drawing that makes up a frame, shared by the window and the batch renderer.
+//Nothing here holds state, the caller owns the device context and the glyph bitmaps.
+namespace frame_scene
+{
+	constexpr wchar_t text_font_family[] = L"Arial";
+	constexpr float text_em_size = 36.f;
+	constexpr D2D1_POINT_2F text_origin{ 50.f, 50.f };
+
+	struct text_font
+	{
+		winrt::com_ptr<IDWriteFontFace> font_face;
+		uint64_t font_id{};
+		float ascent{};
+	};
+
+	struct text_glyph
+	{
+		winrt::com_ptr<ID2D1Bitmap1> bitmap;
+		D2D1_RECT_F destination;
+	};
+
+	struct text_run
+	{
+		std::vector<text_glyph> glyphs;
+		//Empty text leaves this inverted.
+		D2D1_RECT_F bounds;
+	};
+
+	//Returns the metrics and a coverage bitmap for a glyph index,
+	//the bitmap can be null for glyphs with nothing to draw.
+	using glyph_lookup = std::function<std::pair<glyph_cache::glyph_metrics, winrt::com_ptr<ID2D1Bitmap1>>(uint16_t)>;
+
+	text_font load_text_font(IDWriteFactory7 *);
+	std::wstring format_text(uint64_t);
+	//Lays the text out on whole pixels starting at text_origin.
+	text_run layout_text(const text_font &, std::wstring_view, const glyph_lookup &);
+	winrt::com_ptr<ID2D1Bitmap1> make_glyph_bitmap(ID2D1DeviceContext *, const glyph_cache::glyph_metrics &, const uint8_t *);
+
+	void draw_background(ID2D1DeviceContext *, const surface_config::surface_config &);
+	void draw_text(ID2D1DeviceContext *, ID2D1Brush *, const std::vector<text_glyph> &);
+}
\ No newline at end of file
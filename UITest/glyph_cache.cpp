@@ -0,0 +1,835 @@
+#include "glyph_cache.h"
+
+#include "async_log.h"
+#include "task_executor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <span>
+
+namespace glyph_cache
+{
+	namespace
+	{
+		//The file is a header followed by segments, each one a segment header, a table of
+		//entries sorted by key, then the coverage bitmaps the entries point into.
+		//Flushes append a segment and then update the committed size in the header, so a
+		//flush that is cut short leaves bytes past the committed size that are ignored.
+		//Each entry has a checksum of its bitmap, which is checked the first time the glyph
+		//is used, so opening the file only reads the header and the tables.
+		//Bump the version whenever the layout or the rasterisation settings change.
+		constexpr uint32_t file_magic = 0x43474955; //'UIGC'
+		constexpr uint32_t file_version = 3;
+		//The file is compacted when it is closed with this many segments or a corrupt one.
+		constexpr uint32_t max_segment_count = 32;
+		//Past this size, glyphs not used in the session are waste, and once they
+		//make up a quarter of the file it is compacted without them.
+		constexpr uint64_t file_prune_size = 16 * 1024 * 1024;
+		constexpr uint32_t max_glyph_dimention = 1024;
+
+		struct file_header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t segment_count;
+			uint32_t reserved;
+			uint64_t committed_size;
+			//Covers the fields above.
+			uint64_t checksum;
+		};
+		static_assert(sizeof(file_header) == 32);
+
+		struct segment_header
+		{
+			uint32_t entry_count;
+			uint32_t reserved;
+			//Padded so the next segment stays 8 byte aligned.
+			uint64_t data_size;
+			//Covers the fields above and the entry table.
+			uint64_t checksum;
+			uint64_t reserved2;
+		};
+		static_assert(sizeof(segment_header) == 32);
+
+		struct file_entry
+		{
+			uint64_t font_id;
+			float em_size;
+			uint16_t glyph_index;
+			uint16_t reserved;
+			int32_t left;
+			int32_t top;
+			uint32_t width;
+			uint32_t height;
+			float advance;
+			uint32_t data_offset;
+			uint32_t bitmap_checksum;
+		};
+		static_assert(sizeof(file_entry) == 48);
+
+		constexpr uint64_t fnv_offset_basis = 0xcbf29ce484222325ull;
+		constexpr uint64_t fnv_prime = 0x100000001b3ull;
+
+		uint64_t fnv1a(const void *data, size_t size, uint64_t hash = fnv_offset_basis)
+		{
+			auto bytes = static_cast<const uint8_t *>(data);
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= fnv_prime;
+			}
+			return hash;
+		}
+
+		bool key_less(const glyph_key &lhs, const glyph_key &rhs)
+		{
+			if (lhs.font_id != rhs.font_id)
+			{
+				return lhs.font_id < rhs.font_id;
+			}
+			if (lhs.em_size != rhs.em_size)
+			{
+				return lhs.em_size < rhs.em_size;
+			}
+			return lhs.glyph_index < rhs.glyph_index;
+		}
+
+		glyph_key entry_key(const file_entry &entry)
+		{
+			return { entry.font_id, entry.em_size, entry.glyph_index };
+		}
+
+		std::filesystem::path new_file_path(const std::filesystem::path &path)
+		{
+			auto new_path = path;
+			new_path += L".new";
+			return new_path;
+		}
+
+		file_header make_header(uint32_t segment_count, uint64_t committed_size)
+		{
+			file_header header{};
+			header.magic = file_magic;
+			header.version = file_version;
+			header.segment_count = segment_count;
+			header.committed_size = committed_size;
+			header.checksum = fnv1a(&header, offsetof(file_header, checksum));
+			return header;
+		}
+
+		uint64_t segment_checksum(const segment_header &header, const file_entry *entries)
+		{
+			auto hash = fnv1a(&header, offsetof(segment_header, checksum));
+			return fnv1a(entries, static_cast<size_t>(header.entry_count) * sizeof(file_entry), hash);
+		}
+
+		uint32_t bitmap_checksum(const uint8_t *bitmap, uint32_t width, uint32_t height)
+		{
+			auto hash = fnv1a(bitmap, static_cast<size_t>(width) * height);
+			return static_cast<uint32_t>(hash ^ (hash >> 32));
+		}
+
+		bool bitmap_matches(const file_entry &entry, const uint8_t *bitmap)
+		{
+			return bitmap_checksum(bitmap, entry.width, entry.height) == entry.bitmap_checksum;
+		}
+
+		struct source_glyph
+		{
+			glyph_key key;
+			glyph_metrics metrics;
+			const uint8_t *bitmap;
+		};
+
+		//Returns a whole segment, ready to be written.
+		std::vector<uint8_t> build_segment(std::vector<source_glyph> &glyphs)
+		{
+			std::sort(glyphs.begin(), glyphs.end(), [](const source_glyph &lhs, const source_glyph &rhs)
+				{
+					return key_less(lhs.key, rhs.key);
+				});
+
+			std::vector<file_entry> entries;
+			std::vector<uint8_t> data;
+			entries.reserve(glyphs.size());
+			for (auto &glyph : glyphs)
+			{
+				size_t bitmap_size = static_cast<size_t>(glyph.metrics.width) * glyph.metrics.height;
+
+				file_entry entry{};
+				entry.font_id = glyph.key.font_id;
+				entry.em_size = glyph.key.em_size;
+				entry.glyph_index = glyph.key.glyph_index;
+				entry.left = glyph.metrics.left;
+				entry.top = glyph.metrics.top;
+				entry.width = glyph.metrics.width;
+				entry.height = glyph.metrics.height;
+				entry.advance = glyph.metrics.advance;
+				entry.data_offset = static_cast<uint32_t>(data.size());
+				entry.bitmap_checksum = bitmap_checksum(glyph.bitmap, glyph.metrics.width, glyph.metrics.height);
+
+				entries.push_back(entry);
+				data.insert(data.end(), glyph.bitmap, glyph.bitmap + bitmap_size);
+			}
+			data.resize((data.size() + 7) & ~size_t{ 7 });
+
+			segment_header header{};
+			header.entry_count = static_cast<uint32_t>(entries.size());
+			header.data_size = data.size();
+			header.checksum = segment_checksum(header, entries.data());
+
+			std::vector<uint8_t> segment(sizeof(segment_header) + entries.size() * sizeof(file_entry) + data.size());
+			auto out = segment.data();
+			std::memcpy(out, &header, sizeof(header));
+			out += sizeof(header);
+			std::memcpy(out, entries.data(), entries.size() * sizeof(file_entry));
+			out += entries.size() * sizeof(file_entry);
+			std::memcpy(out, data.data(), data.size());
+
+			return segment;
+		}
+	}
+
+	size_t glyph_key_hash::operator()(const glyph_key &key) const noexcept
+	{
+		auto hash = fnv1a(&key.font_id, sizeof(key.font_id));
+		hash = fnv1a(&key.em_size, sizeof(key.em_size), hash);
+		hash = fnv1a(&key.glyph_index, sizeof(key.glyph_index), hash);
+		return static_cast<size_t>(hash);
+	}
+
+	glyph_cache::~glyph_cache()
+	{
+		try
+		{
+			close();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void glyph_cache::open(const std::filesystem::path &path)
+	{
+		close();
+
+		m_path = path;
+
+		std::error_code ec;
+		std::filesystem::create_directories(m_path.parent_path(), ec);
+
+		promote_new_file();
+		map_file();
+	}
+
+	void glyph_cache::close()
+	{
+		//Any flush that is still queued gets to finish, so glyphs from this session aren't lost.
+		{
+			std::unique_lock lock{ m_flush_lock };
+			m_flush_done.wait(lock, [this]()
+				{
+					return !m_flush_running;
+				});
+		}
+
+		//Only now is it known which glyphs this session used.
+		if (m_writable && needs_compaction())
+		{
+			try
+			{
+				compact_file();
+			}
+			catch (...)
+			{
+				ASYNC_LOG(warning, L"Failed to compact the glyph cache file.");
+			}
+		}
+
+		unmap_file();
+		{
+			std::scoped_lock lock{ m_pending_lock };
+			m_pending.clear();
+		}
+
+		if (!m_path.empty())
+		{
+			//Now that nothing is mapped, the file written during this session can replace the old one.
+			promote_new_file();
+		}
+		m_path.clear();
+	}
+
+	bool glyph_cache::find(const glyph_key &key, glyph_view &view)
+	{
+		for (auto &segment : m_segments)
+		{
+			if (segment.corrupt)
+			{
+				continue;
+			}
+
+			std::span<const file_entry> entries{ static_cast<const file_entry *>(segment.entries), segment.entry_count };
+			auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const file_entry &entry, const glyph_key &k)
+				{
+					return key_less(entry_key(entry), k);
+				});
+
+			if (it != entries.end() && entry_key(*it) == key)
+			{
+				//The bitmap is checked the first time it is used. If it is corrupt the rest of the
+				//segment can't be trusted either, and compaction drops it when the cache is closed.
+				auto &used = m_entry_used[segment.first_entry + (it - entries.begin())];
+				if (used.load(std::memory_order_relaxed) == 0)
+				{
+					if (!bitmap_matches(*it, segment.data + it->data_offset))
+					{
+						ASYNC_LOG(warning, L"Glyph cache segment is corrupt, its glyphs will be rasterised again.");
+						segment.corrupt = true;
+						continue;
+					}
+					used.store(1, std::memory_order_relaxed);
+				}
+
+				view.metrics = { it->left, it->top, it->width, it->height, it->advance };
+				view.bitmap = segment.data + it->data_offset;
+				++m_hits;
+				return true;
+			}
+		}
+
+		std::scoped_lock lock{ m_pending_lock };
+		auto it = m_pending.find(key);
+		if (it != m_pending.end())
+		{
+			view.metrics = it->second.metrics;
+			view.bitmap = it->second.bitmap.data();
+			++m_hits;
+			return true;
+		}
+
+		++m_misses;
+		return false;
+	}
+
+	glyph_view glyph_cache::insert(const glyph_key &key, const glyph_metrics &metrics, std::vector<uint8_t> &&bitmap)
+	{
+		_ASSERTE(bitmap.size() == static_cast<size_t>(metrics.width) * metrics.height);
+
+		std::scoped_lock lock{ m_pending_lock };
+		auto [it, inserted] = m_pending.try_emplace(key, pending_glyph{ metrics, std::move(bitmap) });
+
+		return { it->second.metrics, it->second.bitmap.data() };
+	}
+
+	void glyph_cache::flush_async()
+	{
+		if (m_path.empty())
+		{
+			return;
+		}
+
+		std::scoped_lock lock{ m_flush_lock };
+		if (m_flush_running)
+		{
+			m_flush_requested = true;
+			return;
+		}
+
+		//Only marked running once the task is queued, if submit throws close mustn't wait for it.
+		//The task can't clear the flag first, it needs m_flush_lock to do that.
+		task_executor::task_executor::get_shared().submit([this]()
+			{
+				flush_worker();
+			}, task_executor::task_priority::low);
+		m_flush_running = true;
+	}
+
+	uint64_t glyph_cache::hit_count() const
+	{
+		return m_hits;
+	}
+
+	uint64_t glyph_cache::miss_count() const
+	{
+		return m_misses;
+	}
+
+	uint64_t glyph_cache::font_identity(IDWriteFontFace *font_face)
+	{
+		using namespace winrt;
+
+		UINT32 file_count = 0;
+		check_hresult(font_face->GetFiles(&file_count, nullptr));
+
+		std::vector<IDWriteFontFile *> raw_files(file_count);
+		check_hresult(font_face->GetFiles(&file_count, raw_files.data()));
+
+		std::vector<com_ptr<IDWriteFontFile>> files(file_count);
+		for (UINT32 i = 0; i < file_count; ++i)
+		{
+			files[i].attach(raw_files[i]);
+		}
+
+		//For local fonts the reference key contains the last write time as well as the path.
+		uint64_t hash = fnv_offset_basis;
+		for (auto &file : files)
+		{
+			const void *ref_key = nullptr;
+			UINT32 ref_key_size = 0;
+			check_hresult(file->GetReferenceKey(&ref_key, &ref_key_size));
+			hash = fnv1a(ref_key, ref_key_size, hash);
+		}
+
+		UINT32 face_index = font_face->GetIndex();
+		DWRITE_FONT_SIMULATIONS simulations = font_face->GetSimulations();
+		hash = fnv1a(&face_index, sizeof(face_index), hash);
+		hash = fnv1a(&simulations, sizeof(simulations), hash);
+
+		return hash;
+	}
+
+	std::filesystem::path glyph_cache::default_path()
+	{
+		std::filesystem::path base;
+
+		wchar_t buffer[MAX_PATH]{};
+		auto length = GetEnvironmentVariableW(L"LOCALAPPDATA", buffer, MAX_PATH);
+		if (length != 0 && length < MAX_PATH)
+		{
+			base = buffer;
+		}
+		else
+		{
+			base = std::filesystem::temp_directory_path();
+		}
+
+		return base / L"UITest" / L"glyph_cache.bin";
+	}
+
+	void glyph_cache::promote_new_file()
+	{
+		auto new_path = new_file_path(m_path);
+
+		std::error_code ec;
+		if (std::filesystem::exists(new_path, ec))
+		{
+			MoveFileExW(new_path.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING);
+		}
+	}
+
+	void glyph_cache::map_file()
+	{
+		//The same handle is used to append, so opening for writing only fails if another
+		//instance has the file, and then this one just reads it.
+		m_file.reset(CreateFileW(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+		m_writable = static_cast<bool>(m_file);
+		if (!m_file)
+		{
+			m_file.reset(CreateFileW(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+			if (!m_file)
+			{
+				return;
+			}
+		}
+
+		LARGE_INTEGER file_size{};
+		if (!GetFileSizeEx(m_file.get(), &file_size))
+		{
+			unmap_file();
+			return;
+		}
+
+		if (!map_view())
+		{
+			if (file_size.QuadPart != 0)
+			{
+				ASYNC_LOG(warning, L"Glyph cache file is stale or corrupt, starting with an empty cache.");
+			}
+			if (!m_writable)
+			{
+				unmap_file();
+				return;
+			}
+
+			try
+			{
+				reset_file();
+			}
+			catch (...)
+			{
+				unmap_file();
+				return;
+			}
+			if (!map_view())
+			{
+				unmap_file();
+				return;
+			}
+		}
+
+		m_entry_used = std::make_unique<std::atomic<uint8_t>[]>(m_entry_count);
+	}
+
+	bool glyph_cache::map_view()
+	{
+		LARGE_INTEGER file_size{};
+		if (!GetFileSizeEx(m_file.get(), &file_size) || file_size.QuadPart < static_cast<LONGLONG>(sizeof(file_header)))
+		{
+			return false;
+		}
+
+		m_mapping.reset(CreateFileMappingW(m_file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+		if (m_mapping)
+		{
+			m_view.reset(static_cast<uint8_t *>(MapViewOfFile(m_mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+		}
+
+		std::vector<mapped_segment> segments;
+		if (!m_view || !validate_mapping(static_cast<uint64_t>(file_size.QuadPart), segments))
+		{
+			m_view.reset();
+			m_mapping.reset();
+			return false;
+		}
+
+		auto header = reinterpret_cast<const file_header *>(m_view.get());
+		m_committed_size = header->committed_size;
+		m_segment_count = header->segment_count;
+		m_entry_count = segments.empty() ? 0 : segments.back().first_entry + segments.back().entry_count;
+		m_segments = std::move(segments);
+		return true;
+	}
+
+	void glyph_cache::reset_file()
+	{
+		auto header = make_header(0, sizeof(file_header));
+		write_at(0, &header, sizeof(header));
+
+		LARGE_INTEGER end{};
+		end.QuadPart = sizeof(file_header);
+		winrt::check_bool(SetFilePointerEx(m_file.get(), end, nullptr, FILE_BEGIN));
+		winrt::check_bool(SetEndOfFile(m_file.get()));
+	}
+
+	void glyph_cache::unmap_file()
+	{
+		m_entry_used.reset();
+		m_segments.clear();
+		m_entry_count = 0;
+		m_committed_size = 0;
+		m_segment_count = 0;
+		m_writable = false;
+		m_view.reset();
+		m_mapping.reset();
+		m_file.reset();
+	}
+
+	bool glyph_cache::validate_mapping(uint64_t file_size, std::vector<mapped_segment> &segments) const
+	{
+		auto header = reinterpret_cast<const file_header *>(m_view.get());
+		if (header->magic != file_magic || header->version != file_version || header->checksum != fnv1a(header, offsetof(file_header, checksum)))
+		{
+			return false;
+		}
+
+		if (header->committed_size < sizeof(file_header) || header->committed_size > file_size)
+		{
+			return false;
+		}
+
+		uint64_t offset = sizeof(file_header);
+		size_t entry_total = 0;
+		for (uint32_t i = 0; i < header->segment_count; ++i)
+		{
+			if (header->committed_size - offset < sizeof(segment_header))
+			{
+				return false;
+			}
+
+			auto segment = reinterpret_cast<const segment_header *>(m_view.get() + offset);
+			uint64_t remaining = header->committed_size - offset - sizeof(segment_header);
+			uint64_t table_size = static_cast<uint64_t>(segment->entry_count) * sizeof(file_entry);
+			if (table_size > remaining || segment->data_size > remaining - table_size || segment->data_size % 8 != 0)
+			{
+				return false;
+			}
+
+			auto entry_data = reinterpret_cast<const file_entry *>(m_view.get() + offset + sizeof(segment_header));
+			if (segment_checksum(*segment, entry_data) != segment->checksum)
+			{
+				return false;
+			}
+
+			//Only the table is checked here, the bitmaps just have to lie within the segment.
+			std::span<const file_entry> entries{ entry_data, segment->entry_count };
+			for (auto &entry : entries)
+			{
+				if (entry.width > max_glyph_dimention || entry.height > max_glyph_dimention)
+				{
+					return false;
+				}
+				if (static_cast<uint64_t>(entry.data_offset) + static_cast<uint64_t>(entry.width) * entry.height > segment->data_size)
+				{
+					return false;
+				}
+			}
+
+			bool sorted = std::is_sorted(entries.begin(), entries.end(), [](const file_entry &lhs, const file_entry &rhs)
+				{
+					return key_less(entry_key(lhs), entry_key(rhs));
+				});
+			if (!sorted)
+			{
+				return false;
+			}
+
+			segments.push_back({ entry_data, segment->entry_count, m_view.get() + offset + sizeof(segment_header) + table_size, entry_total, false });
+			entry_total += segment->entry_count;
+			offset += sizeof(segment_header) + table_size + segment->data_size;
+		}
+
+		return offset == header->committed_size;
+	}
+
+	void glyph_cache::flush_worker()
+	{
+		for (;;)
+		{
+			try
+			{
+				append_file();
+			}
+			catch (...)
+			{
+				//The cache is only an optimisation, so failing to write it is not fatal.
+				ASYNC_LOG(warning, L"Failed to write the glyph cache file.");
+			}
+
+			std::scoped_lock lock{ m_flush_lock };
+			if (!m_flush_requested)
+			{
+				//close can destroy the cache as soon as the lock is released.
+				m_flush_running = false;
+				m_flush_done.notify_all();
+				return;
+			}
+			m_flush_requested = false;
+		}
+	}
+
+	void glyph_cache::append_file()
+	{
+		//Another instance owns the file, so it is left alone.
+		if (!m_writable)
+		{
+			return;
+		}
+
+		//Pending bitmaps don't move or go away until the cache is closed, and close waits for this.
+		std::vector<source_glyph> glyphs;
+		{
+			std::scoped_lock lock{ m_pending_lock };
+			for (auto &[key, pending] : m_pending)
+			{
+				if (!pending.written)
+				{
+					glyphs.push_back({ key, pending.metrics, pending.bitmap.data() });
+				}
+			}
+		}
+
+		if (glyphs.empty())
+		{
+			return;
+		}
+
+		auto segment = build_segment(glyphs);
+		write_at(m_committed_size, segment.data(), segment.size());
+		winrt::check_bool(FlushFileBuffers(m_file.get()));
+
+		//The segment is only part of the file once the header says so.
+		auto header = make_header(m_segment_count + 1, m_committed_size + segment.size());
+		write_at(0, &header, sizeof(header));
+		winrt::check_bool(FlushFileBuffers(m_file.get()));
+		m_committed_size = header.committed_size;
+		m_segment_count = header.segment_count;
+
+		std::scoped_lock lock{ m_pending_lock };
+		for (auto &glyph : glyphs)
+		{
+			m_pending[glyph.key].written = true;
+		}
+	}
+
+	bool glyph_cache::needs_compaction() const
+	{
+		if (m_segment_count >= max_segment_count)
+		{
+			return true;
+		}
+
+		uint64_t unused_size = 0;
+		for (auto &segment : m_segments)
+		{
+			if (segment.corrupt)
+			{
+				return true;
+			}
+
+			std::span<const file_entry> entries{ static_cast<const file_entry *>(segment.entries), segment.entry_count };
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				if (m_entry_used[segment.first_entry + i].load(std::memory_order_relaxed) == 0)
+				{
+					unused_size += sizeof(file_entry) + static_cast<uint64_t>(entries[i].width) * entries[i].height;
+				}
+			}
+		}
+
+		return m_committed_size > file_prune_size && unused_size >= m_committed_size / 4;
+	}
+
+	void glyph_cache::compact_file()
+	{
+		//Everything inserted this session, including what has already been appended.
+		std::vector<source_glyph> glyphs;
+		{
+			std::scoped_lock lock{ m_pending_lock };
+			for (auto &[key, pending] : m_pending)
+			{
+				glyphs.push_back({ key, pending.metrics, pending.bitmap.data() });
+			}
+		}
+
+		bool prune = m_committed_size > file_prune_size;
+		std::vector<source_glyph> segment_glyphs;
+		for (auto &segment : m_segments)
+		{
+			if (segment.corrupt)
+			{
+				continue;
+			}
+
+			//Bitmaps that weren't used haven't been checked yet, and one bad one drops the segment.
+			segment_glyphs.clear();
+			std::span<const file_entry> entries{ static_cast<const file_entry *>(segment.entries), segment.entry_count };
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				bool used = m_entry_used[segment.first_entry + i].load(std::memory_order_relaxed) != 0;
+				if (prune && !used)
+				{
+					continue;
+				}
+				auto &entry = entries[i];
+				auto bitmap = segment.data + entry.data_offset;
+				if (!used && !bitmap_matches(entry, bitmap))
+				{
+					segment.corrupt = true;
+					break;
+				}
+				segment_glyphs.push_back({ entry_key(entry), { entry.left, entry.top, entry.width, entry.height, entry.advance }, bitmap });
+			}
+
+			if (!segment.corrupt)
+			{
+				glyphs.insert(glyphs.end(), segment_glyphs.begin(), segment_glyphs.end());
+			}
+		}
+
+		//A glyph can be in more than one segment, the sort puts duplicates next to each other.
+		std::sort(glyphs.begin(), glyphs.end(), [](const source_glyph &lhs, const source_glyph &rhs)
+			{
+				return key_less(lhs.key, rhs.key);
+			});
+		glyphs.erase(std::unique(glyphs.begin(), glyphs.end(), [](const source_glyph &lhs, const source_glyph &rhs)
+			{
+				return lhs.key == rhs.key;
+			}), glyphs.end());
+
+		auto segment = build_segment(glyphs);
+		auto header = make_header(1, sizeof(file_header) + segment.size());
+
+		auto temp_path = m_path;
+		temp_path += L".tmp";
+		{
+			std::ofstream out{ temp_path, std::ios::binary | std::ios::trunc };
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char *>(segment.data()), static_cast<std::streamsize>(segment.size()));
+			if (!out)
+			{
+				winrt::throw_hresult(E_FAIL);
+			}
+		}
+
+		//The mapped file can't be replaced while it is mapped, so this goes alongside it.
+		winrt::check_bool(MoveFileExW(temp_path.c_str(), new_file_path(m_path).c_str(), MOVEFILE_REPLACE_EXISTING));
+	}
+
+	void glyph_cache::write_at(uint64_t offset, const void *data, size_t size)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		DWORD written = 0;
+		winrt::check_bool(WriteFile(m_file.get(), data, static_cast<DWORD>(size), &written, &overlapped));
+		if (written != size)
+		{
+			winrt::throw_hresult(E_FAIL);
+		}
+	}
+
+	std::pair<glyph_metrics, std::vector<uint8_t>> rasterize_glyph(IDWriteFactory7 *factory, IDWriteFontFace *font_face, float em_size, uint16_t glyph_index)
+	{
+		using namespace winrt;
+
+		DWRITE_FONT_METRICS font_metrics{};
+		font_face->GetMetrics(&font_metrics);
+		DWRITE_GLYPH_METRICS design_metrics{};
+		check_hresult(font_face->GetDesignGlyphMetrics(&glyph_index, 1, &design_metrics, FALSE));
+
+		glyph_metrics metrics{};
+		metrics.advance = static_cast<float>(design_metrics.advanceWidth) * em_size / static_cast<float>(font_metrics.designUnitsPerEm);
+
+		float glyph_advance = 0.f;
+		DWRITE_GLYPH_OFFSET glyph_offset{};
+		DWRITE_GLYPH_RUN glyph_run{};
+		glyph_run.fontFace = font_face;
+		glyph_run.fontEmSize = em_size;
+		glyph_run.glyphCount = 1;
+		glyph_run.glyphIndices = &glyph_index;
+		glyph_run.glyphAdvances = &glyph_advance;
+		glyph_run.glyphOffsets = &glyph_offset;
+
+		com_ptr<IDWriteGlyphRunAnalysis> analysis;
+		check_hresult(factory->CreateGlyphRunAnalysis(&glyph_run, nullptr, DWRITE_RENDERING_MODE1_NATURAL, DWRITE_MEASURING_MODE_NATURAL, DWRITE_GRID_FIT_MODE_DEFAULT, DWRITE_TEXT_ANTIALIAS_MODE_GRAYSCALE, 0.f, 0.f, analysis.put()));
+
+		//Grayscale antialiasing still hands back a 3x1 texture, with the same value in all three bytes.
+		RECT bounds{};
+		check_hresult(analysis->GetAlphaTextureBounds(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds));
+		if (bounds.right <= bounds.left || bounds.bottom <= bounds.top)
+		{
+			return { metrics, {} };
+		}
+
+		metrics.left = bounds.left;
+		metrics.top = bounds.top;
+		metrics.width = static_cast<uint32_t>(bounds.right - bounds.left);
+		metrics.height = static_cast<uint32_t>(bounds.bottom - bounds.top);
+
+		size_t pixel_count = static_cast<size_t>(metrics.width) * metrics.height;
+		std::vector<uint8_t> texture(pixel_count * 3);
+		check_hresult(analysis->CreateAlphaTexture(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds, texture.data(), static_cast<UINT32>(texture.size())));
+
+		std::vector<uint8_t> coverage(pixel_count);
+		for (size_t i = 0; i < pixel_count; ++i)
+		{
+			coverage[i] = texture[i * 3];
+		}
+
+		return { metrics, std::move(coverage) };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "framework.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace glyph_cache
+{
+	//Identifies a single rasterised glyph.
+	//The font id comes from font_identity, so a font file that
+	//changes on disk gets a new id and the old entries just stop matching.
+	struct glyph_key
+	{
+		uint64_t font_id{};
+		float em_size{};
+		uint16_t glyph_index{};
+
+		bool operator==(const glyph_key &) const = default;
+	};
+
+	struct glyph_key_hash
+	{
+		size_t operator()(const glyph_key &) const noexcept;
+	};
+
+	//Placement of the bitmap relative to the pen position on the baseline.
+	struct glyph_metrics
+	{
+		int32_t left{};
+		int32_t top{};
+		uint32_t width{};
+		uint32_t height{};
+		float advance{};
+	};
+
+	//The bitmap is 8 bit coverage, width * height bytes, tightly packed.
+	//It points either into the mapped file or into the pending set,
+	//and it stays valid until the cache is closed.
+	struct glyph_view
+	{
+		glyph_metrics metrics{};
+		const uint8_t *bitmap{};
+	};
+
+	class glyph_cache
+	{
+	public:
+		glyph_cache() = default;
+		~glyph_cache();
+
+		//Maps the cache file read only, only the header and entry tables are read here.
+		//A missing, stale or corrupt file just results in an empty cache, and a corrupt
+		//bitmap found later just loses the glyphs stored alongside it.
+		void open(const std::filesystem::path &);
+		void close();
+
+		bool find(const glyph_key &, glyph_view &);
+		glyph_view insert(const glyph_key &, const glyph_metrics &, std::vector<uint8_t> &&);
+
+		//Appends the pending glyphs to the file as a low priority task on the shared executor.
+		//The file is only rewritten when it is closed, and then only once it is fragmented,
+		//has a corrupt segment, or is large and mostly glyphs this session didn't use.
+		void flush_async();
+
+		uint64_t hit_count() const;
+		uint64_t miss_count() const;
+
+		static uint64_t font_identity(IDWriteFontFace *);
+		static std::filesystem::path default_path();
+
+	private:
+		glyph_cache(const glyph_cache &) = delete;
+		glyph_cache(glyph_cache &&) = delete;
+		glyph_cache &operator=(const glyph_cache &) = delete;
+		glyph_cache &operator=(glyph_cache &&) = delete;
+
+		struct pending_glyph
+		{
+			glyph_metrics metrics;
+			std::vector<uint8_t> bitmap;
+			//Already appended to the file.
+			bool written = false;
+		};
+
+		//Each append adds a segment with its own sorted entry table.
+		struct mapped_segment
+		{
+			const void *entries{};
+			uint32_t entry_count{};
+			const uint8_t *data{};
+			size_t first_entry{};
+			//Set once a bitmap in the segment fails its checksum.
+			bool corrupt{};
+		};
+
+		void promote_new_file();
+		void map_file();
+		bool map_view();
+		void reset_file();
+		void unmap_file();
+		bool validate_mapping(uint64_t, std::vector<mapped_segment> &) const;
+
+		void flush_worker();
+		void append_file();
+		bool needs_compaction() const;
+		void compact_file();
+		void write_at(uint64_t, const void *, size_t);
+
+		std::filesystem::path m_path;
+
+		wil::unique_hfile m_file;
+		wil::unique_handle m_mapping;
+		wil::unique_mapview_ptr<uint8_t> m_view;
+		std::vector<mapped_segment> m_segments;
+		size_t m_entry_count{};
+		//Tracks which mapped entries were used this session, and so have had their bitmap checked,
+		//this is read when the file is compacted to prune it.
+		std::unique_ptr<std::atomic<uint8_t>[]> m_entry_used;
+		//Only the flush task changes these once the file is mapped.
+		uint64_t m_committed_size{};
+		uint32_t m_segment_count{};
+		//False when another process has the file open for writing.
+		bool m_writable = false;
+
+		std::mutex m_pending_lock;
+		std::unordered_map<glyph_key, pending_glyph, glyph_key_hash> m_pending;
+
+		std::mutex m_flush_lock;
+		std::condition_variable m_flush_done;
+		bool m_flush_running = false;
+		bool m_flush_requested = false;
+
+		uint64_t m_hits{};
+		uint64_t m_misses{};
+	};
+
+	//Rasterises a glyph with grayscale antialiasing at 1 pixel per DIP.
+	std::pair<glyph_metrics, std::vector<uint8_t>> rasterize_glyph(IDWriteFactory7 *, IDWriteFontFace *, float, uint16_t);
+}
\ No newline at end of file
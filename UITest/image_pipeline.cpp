@@ -0,0 +1,517 @@
+#include "image_pipeline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace image_pipeline
+{
+	namespace
+	{
+		//Guards against headers that claim absurd sizes.
+		constexpr uint32_t max_image_dimention = 32768;
+
+		std::wstring make_key(const std::filesystem::path &path, const image_size &size)
+		{
+			return path.wstring() + L"|" + std::to_wstring(size.width) + L"x" + std::to_wstring(size.height);
+		}
+
+		void check_dimentions(uint32_t width, uint32_t height)
+		{
+			if (width == 0 || height == 0 || width > max_image_dimention || height > max_image_dimention)
+			{
+				throw std::runtime_error("Image dimentions out of range.");
+			}
+		}
+
+		uint32_t read_be32(const uint8_t *data)
+		{
+			return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+		}
+
+		//Reads a whitespace separated decimal value from a PPM header, skipping comments.
+		uint32_t read_ppm_value(std::span<const uint8_t> data, size_t &offset)
+		{
+			for (;;)
+			{
+				if (offset >= data.size())
+				{
+					throw std::runtime_error("Truncated PPM header.");
+				}
+				if (data[offset] == '#')
+				{
+					while (offset < data.size() && data[offset] != '\n')
+					{
+						++offset;
+					}
+				}
+				else if (data[offset] == ' ' || data[offset] == '\t' || data[offset] == '\r' || data[offset] == '\n')
+				{
+					++offset;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			uint64_t value = 0;
+			size_t start = offset;
+			while (offset < data.size() && data[offset] >= '0' && data[offset] <= '9')
+			{
+				value = value * 10 + (data[offset] - '0');
+				if (value > UINT32_MAX)
+				{
+					throw std::runtime_error("PPM header value out of range.");
+				}
+				++offset;
+			}
+			if (offset == start)
+			{
+				throw std::runtime_error("Malformed PPM header.");
+			}
+
+			return static_cast<uint32_t>(value);
+		}
+	}
+
+	image_size fit_size(const image_size &source, const image_size &target)
+	{
+		double scale = 1.0;
+		if (target.width != 0)
+		{
+			scale = std::min(scale, static_cast<double>(target.width) / source.width);
+		}
+		if (target.height != 0)
+		{
+			scale = std::min(scale, static_cast<double>(target.height) / source.height);
+		}
+
+		auto width = static_cast<uint32_t>(std::lround(source.width * scale));
+		auto height = static_cast<uint32_t>(std::lround(source.height * scale));
+
+		return { std::clamp(width, 1u, source.width), std::clamp(height, 1u, source.height) };
+	}
+
+	downsampler::downsampler(const image_size &source, const image_size &target) : m_source{ source }
+	{
+		check_dimentions(source.width, source.height);
+
+		m_image.size = fit_size(source, target);
+		m_image.stride = m_image.size.width * 4;
+		m_image.pixels.resize(static_cast<size_t>(m_image.stride) * m_image.size.height);
+
+		m_column_map.resize(source.width);
+		for (uint32_t x = 0; x < source.width; ++x)
+		{
+			m_column_map[x] = static_cast<uint32_t>(static_cast<uint64_t>(x) * m_image.size.width / source.width);
+		}
+
+		m_accumulator.resize(static_cast<size_t>(m_image.size.width) * 4);
+		m_counts.resize(m_image.size.width);
+	}
+
+	void downsampler::push_row(const uint8_t *rgba)
+	{
+		assert(m_source_row < m_source.height);
+
+		auto target_row = static_cast<uint32_t>(static_cast<uint64_t>(m_source_row) * m_image.size.height / m_source.height);
+		if (target_row != m_target_row)
+		{
+			flush_row();
+			m_target_row = target_row;
+		}
+
+		for (uint32_t x = 0; x < m_source.width; ++x)
+		{
+			const uint8_t *pixel = rgba + static_cast<size_t>(x) * 4;
+			uint32_t alpha = pixel[3];
+			uint64_t *sum = m_accumulator.data() + static_cast<size_t>(m_column_map[x]) * 4;
+
+			sum[0] += (pixel[2] * alpha + 127) / 255;
+			sum[1] += (pixel[1] * alpha + 127) / 255;
+			sum[2] += (pixel[0] * alpha + 127) / 255;
+			sum[3] += alpha;
+			++m_counts[m_column_map[x]];
+		}
+
+		m_row_pending = true;
+		++m_source_row;
+	}
+
+	decoded_image downsampler::finish()
+	{
+		if (m_source_row != m_source.height)
+		{
+			throw std::runtime_error("Image data ended early.");
+		}
+
+		flush_row();
+		return std::move(m_image);
+	}
+
+	void downsampler::flush_row()
+	{
+		if (!m_row_pending)
+		{
+			return;
+		}
+
+		uint8_t *out = m_image.pixels.data() + static_cast<size_t>(m_target_row) * m_image.stride;
+		for (uint32_t x = 0; x < m_image.size.width; ++x)
+		{
+			uint64_t count = m_counts[x];
+			uint64_t *sum = m_accumulator.data() + static_cast<size_t>(x) * 4;
+			for (size_t c = 0; c < 4; ++c)
+			{
+				out[x * 4 + c] = count ? static_cast<uint8_t>((sum[c] + count / 2) / count) : 0;
+			}
+		}
+
+		std::fill(m_accumulator.begin(), m_accumulator.end(), 0);
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_row_pending = false;
+	}
+
+	bool ppm_decoder::can_decode(std::span<const uint8_t> data) const
+	{
+		return data.size() >= 2 && data[0] == 'P' && data[1] == '6';
+	}
+
+	decoded_image ppm_decoder::decode(std::span<const uint8_t> data, const image_size &target) const
+	{
+		size_t offset = 2;
+		uint32_t width = read_ppm_value(data, offset);
+		uint32_t height = read_ppm_value(data, offset);
+		uint32_t max_value = read_ppm_value(data, offset);
+		if (max_value == 0 || max_value > 65535)
+		{
+			throw std::runtime_error("PPM maximum value out of range.");
+		}
+		check_dimentions(width, height);
+
+		//Exactly one whitespace character separates the header from the samples.
+		++offset;
+
+		size_t sample_size = max_value < 256 ? 1 : 2;
+		size_t row_size = static_cast<size_t>(width) * 3 * sample_size;
+		if (offset > data.size() || (data.size() - offset) / row_size < height)
+		{
+			throw std::runtime_error("Truncated PPM data.");
+		}
+
+		downsampler sampler{ { width, height }, target };
+		std::vector<uint8_t> row(static_cast<size_t>(width) * 4);
+		const uint8_t *samples = data.data() + offset;
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				for (size_t c = 0; c < 3; ++c)
+				{
+					uint32_t value = sample_size == 1 ? samples[0] : (static_cast<uint32_t>(samples[0]) << 8) | samples[1];
+					row[x * 4 + c] = static_cast<uint8_t>((std::min(value, max_value) * 255 + max_value / 2) / max_value);
+					samples += sample_size;
+				}
+				row[x * 4 + 3] = 255;
+			}
+			sampler.push_row(row.data());
+		}
+
+		return sampler.finish();
+	}
+
+	bool qoi_decoder::can_decode(std::span<const uint8_t> data) const
+	{
+		return data.size() >= 4 && std::memcmp(data.data(), "qoif", 4) == 0;
+	}
+
+	decoded_image qoi_decoder::decode(std::span<const uint8_t> data, const image_size &target) const
+	{
+		constexpr size_t header_size = 14;
+		constexpr size_t padding_size = 8;
+		constexpr uint8_t op_index = 0x00;
+		constexpr uint8_t op_diff = 0x40;
+		constexpr uint8_t op_luma = 0x80;
+		constexpr uint8_t op_rgb = 0xfe;
+		constexpr uint8_t op_rgba = 0xff;
+		constexpr uint8_t op_mask = 0xc0;
+
+		if (data.size() < header_size + padding_size)
+		{
+			throw std::runtime_error("Truncated QOI data.");
+		}
+
+		uint32_t width = read_be32(data.data() + 4);
+		uint32_t height = read_be32(data.data() + 8);
+		check_dimentions(width, height);
+
+		downsampler sampler{ { width, height }, target };
+		std::vector<uint8_t> row(static_cast<size_t>(width) * 4);
+
+		uint8_t index[64][4]{};
+		uint8_t pixel[4]{ 0, 0, 0, 255 };
+		uint32_t run = 0;
+		size_t offset = header_size;
+		size_t chunks_end = data.size() - padding_size;
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				if (run > 0)
+				{
+					--run;
+				}
+				else if (offset < chunks_end)
+				{
+					uint8_t op = data[offset++];
+
+					if (op == op_rgb || op == op_rgba)
+					{
+						size_t count = op == op_rgb ? 3 : 4;
+						if (chunks_end - offset < count)
+						{
+							throw std::runtime_error("Truncated QOI data.");
+						}
+						std::memcpy(pixel, data.data() + offset, count);
+						offset += count;
+					}
+					else if ((op & op_mask) == op_index)
+					{
+						std::memcpy(pixel, index[op], 4);
+					}
+					else if ((op & op_mask) == op_diff)
+					{
+						pixel[0] = static_cast<uint8_t>(pixel[0] + ((op >> 4) & 0x03) - 2);
+						pixel[1] = static_cast<uint8_t>(pixel[1] + ((op >> 2) & 0x03) - 2);
+						pixel[2] = static_cast<uint8_t>(pixel[2] + (op & 0x03) - 2);
+					}
+					else if ((op & op_mask) == op_luma)
+					{
+						if (offset >= chunks_end)
+						{
+							throw std::runtime_error("Truncated QOI data.");
+						}
+						uint8_t next = data[offset++];
+						int green_delta = (op & 0x3f) - 32;
+						pixel[0] = static_cast<uint8_t>(pixel[0] + green_delta - 8 + ((next >> 4) & 0x0f));
+						pixel[1] = static_cast<uint8_t>(pixel[1] + green_delta);
+						pixel[2] = static_cast<uint8_t>(pixel[2] + green_delta - 8 + (next & 0x0f));
+					}
+					else
+					{
+						//The only op left is a run.
+						run = op & 0x3f;
+					}
+
+					auto hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+					std::memcpy(index[hash], pixel, 4);
+				}
+				else
+				{
+					throw std::runtime_error("Truncated QOI data.");
+				}
+
+				std::memcpy(row.data() + static_cast<size_t>(x) * 4, pixel, 4);
+			}
+			sampler.push_row(row.data());
+		}
+
+		return sampler.finish();
+	}
+
+	bitmap_cache::bitmap_cache(size_t capacity_bytes) : m_capacity_bytes{ capacity_bytes }
+	{
+	}
+
+	image_ptr bitmap_cache::find(const std::wstring &key)
+	{
+		auto it = m_index.find(key);
+		if (it == m_index.end())
+		{
+			return nullptr;
+		}
+
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->image;
+	}
+
+	void bitmap_cache::insert(const std::wstring &key, const image_ptr &image)
+	{
+		auto it = m_index.find(key);
+		if (it != m_index.end())
+		{
+			m_size_bytes -= it->second->size_bytes;
+			m_entries.erase(it->second);
+			m_index.erase(it);
+		}
+
+		size_t size_bytes = image->pixels.size();
+		m_entries.push_front({ key, image, size_bytes });
+		m_index.emplace(key, m_entries.begin());
+		m_size_bytes += size_bytes;
+
+		evict();
+	}
+
+	size_t bitmap_cache::size_bytes() const
+	{
+		return m_size_bytes;
+	}
+
+	size_t bitmap_cache::entry_count() const
+	{
+		return m_entries.size();
+	}
+
+	void bitmap_cache::evict()
+	{
+		//The most recent entry is always kept, even if it is larger than the whole cache.
+		while (m_size_bytes > m_capacity_bytes && m_entries.size() > 1)
+		{
+			auto &last = m_entries.back();
+			m_size_bytes -= last.size_bytes;
+			m_index.erase(last.key);
+			m_entries.pop_back();
+		}
+	}
+
+	image_pipeline::image_pipeline(std::vector<std::unique_ptr<image_decoder>> &&decoders, task_executor::task_executor &executor, size_t cache_bytes) : m_decoders{ std::move(decoders) }, m_executor{ executor }, m_cache{ cache_bytes }
+	{
+	}
+
+	image_pipeline::~image_pipeline()
+	{
+		std::unique_lock lock{ m_lock };
+		m_stopping = true;
+		m_idle.wait(lock, [this]()
+			{
+				return m_outstanding == 0;
+			});
+	}
+
+	std::shared_future<image_ptr> image_pipeline::request(const std::filesystem::path &path, const image_size &target)
+	{
+		auto key = make_key(path, target);
+
+		std::unique_lock lock{ m_lock };
+		if (auto image = m_cache.find(key))
+		{
+			++m_hits;
+
+			std::promise<image_ptr> ready;
+			ready.set_value(std::move(image));
+			return ready.get_future().share();
+		}
+
+		if (auto it = m_in_flight.find(key); it != m_in_flight.end())
+		{
+			++m_deduplicated;
+			return it->second;
+		}
+
+		++m_misses;
+
+		auto promise = std::make_shared<std::promise<image_ptr>>();
+		auto future = promise->get_future().share();
+		m_in_flight.emplace(key, future);
+
+		//Counted before the task can run, so it can't finish before it is counted.
+		++m_outstanding;
+		lock.unlock();
+
+		try
+		{
+			m_executor.submit([this, key, path, target, promise]()
+				{
+					run_request(key, path, target, *promise);
+
+					//The pipeline can be destroyed as soon as the lock is released.
+					std::scoped_lock lock{ m_lock };
+					if (--m_outstanding == 0)
+					{
+						m_idle.notify_all();
+					}
+				});
+		}
+		catch (...)
+		{
+			//The task was never queued, so the destructor mustn't wait for it and
+			//later requests mustn't share its future.
+			lock.lock();
+			m_in_flight.erase(key);
+			if (--m_outstanding == 0)
+			{
+				m_idle.notify_all();
+			}
+			throw;
+		}
+
+		return future;
+	}
+
+	cache_stats image_pipeline::get_cache_stats() const
+	{
+		std::scoped_lock lock{ m_lock };
+		return { m_hits, m_misses, m_deduplicated, m_cache.size_bytes(), m_cache.entry_count() };
+	}
+
+	void image_pipeline::run_request(const std::wstring &key, const std::filesystem::path &path, const image_size &target, std::promise<image_ptr> &promise)
+	{
+		{
+			//Dropping the promise reports a broken promise to anyone still waiting.
+			std::scoped_lock lock{ m_lock };
+			if (m_stopping)
+			{
+				m_in_flight.erase(key);
+				return;
+			}
+		}
+
+		try
+		{
+			auto image = decode_file(path, target);
+			{
+				std::scoped_lock lock{ m_lock };
+				m_cache.insert(key, image);
+				m_in_flight.erase(key);
+			}
+			promise.set_value(std::move(image));
+		}
+		catch (...)
+		{
+			{
+				std::scoped_lock lock{ m_lock };
+				m_in_flight.erase(key);
+			}
+			promise.set_exception(std::current_exception());
+		}
+	}
+
+	image_ptr image_pipeline::decode_file(const std::filesystem::path &path, const image_size &target) const
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			throw std::runtime_error("Unable to open image file.");
+		}
+
+		std::vector<uint8_t> data{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+		for (auto &decoder : m_decoders)
+		{
+			if (decoder->can_decode(data))
+			{
+				return std::make_shared<const decoded_image>(decoder->decode(data, target));
+			}
+		}
+
+		throw std::runtime_error("No decoder for image.");
+	}
+}
\ No newline at end of file
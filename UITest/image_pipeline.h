@@ -0,0 +1,175 @@
+#pragma once
+
+//The pipeline itself doesn't depend on any Windows headers.
+//Decoders are plugged in when the pipeline is created, the portable PPM and QOI
+//decoders here work anywhere, and wic_image_decoder.h provides the Windows decoder.
+
+#include "task_executor.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace image_pipeline
+{
+	struct image_size
+	{
+		uint32_t width{};
+		uint32_t height{};
+
+		bool operator==(const image_size &) const = default;
+	};
+
+	//Pixels are always premultiplied BGRA, 8 bits per channel.
+	struct decoded_image
+	{
+		image_size size;
+		uint32_t stride{};
+		std::vector<uint8_t> pixels;
+	};
+
+	using image_ptr = std::shared_ptr<const decoded_image>;
+
+	//Returns the largest size that fits inside the target while keeping the aspect ratio.
+	//Images are only ever scaled down, and a zero target dimention is unconstrained.
+	image_size fit_size(const image_size &, const image_size &);
+
+	//Box filters rows of straight alpha RGBA into a premultiplied BGRA image.
+	//Rows are consumed as they are decoded, so only one row of the output is
+	//being accumulated at any time.
+	class downsampler
+	{
+	public:
+		downsampler(const image_size &, const image_size &);
+
+		void push_row(const uint8_t *);
+		decoded_image finish();
+
+	private:
+		void flush_row();
+
+		image_size m_source;
+		decoded_image m_image;
+		std::vector<uint32_t> m_column_map;
+		std::vector<uint64_t> m_accumulator;
+		std::vector<uint32_t> m_counts;
+		uint32_t m_source_row = 0;
+		uint32_t m_target_row = 0;
+		bool m_row_pending = false;
+	};
+
+	class image_decoder
+	{
+	public:
+		virtual ~image_decoder() = default;
+
+		//Called with the whole encoded file, only the header needs to be checked.
+		virtual bool can_decode(std::span<const uint8_t>) const = 0;
+		//The result must already fit within the target size.
+		//Throws std::runtime_error for malformed data.
+		virtual decoded_image decode(std::span<const uint8_t>, const image_size &) const = 0;
+	};
+
+	//Binary PPM (P6), any maximum value.
+	class ppm_decoder : public image_decoder
+	{
+	public:
+		bool can_decode(std::span<const uint8_t>) const override;
+		decoded_image decode(std::span<const uint8_t>, const image_size &) const override;
+	};
+
+	//The Quite OK Image format.
+	class qoi_decoder : public image_decoder
+	{
+	public:
+		bool can_decode(std::span<const uint8_t>) const override;
+		decoded_image decode(std::span<const uint8_t>, const image_size &) const override;
+	};
+
+	struct cache_stats
+	{
+		uint64_t hits{};
+		uint64_t misses{};
+		uint64_t deduplicated{};
+		size_t size_bytes{};
+		size_t entry_count{};
+	};
+
+	//Least recently used cache bounded by the total size of the pixel data.
+	//It isn't synchronised, the pipeline only touches it with its lock held.
+	class bitmap_cache
+	{
+	public:
+		explicit bitmap_cache(size_t);
+
+		image_ptr find(const std::wstring &);
+		void insert(const std::wstring &, const image_ptr &);
+
+		size_t size_bytes() const;
+		size_t entry_count() const;
+
+	private:
+		struct entry
+		{
+			std::wstring key;
+			image_ptr image;
+			size_t size_bytes;
+		};
+
+		void evict();
+
+		std::list<entry> m_entries;
+		std::unordered_map<std::wstring, std::list<entry>::iterator> m_index;
+		size_t m_capacity_bytes;
+		size_t m_size_bytes = 0;
+	};
+
+	class image_pipeline
+	{
+	public:
+		constexpr static size_t default_cache_bytes = 64 * 1024 * 1024;
+
+		//Decoders are tried in order, so a catch all decoder should go last.
+		//Decoding runs on the executor, the pipeline has no threads of its own.
+		explicit image_pipeline(std::vector<std::unique_ptr<image_decoder>> &&, task_executor::task_executor & = task_executor::task_executor::get_shared(), size_t = default_cache_bytes);
+		//Waits for decodes that have started, any that haven't are abandoned.
+		~image_pipeline();
+
+		//Requests for an image that is already being decoded share the same result.
+		//Decode failures are reported through the future.
+		std::shared_future<image_ptr> request(const std::filesystem::path &, const image_size &);
+
+		cache_stats get_cache_stats() const;
+
+	private:
+		image_pipeline(const image_pipeline &) = delete;
+		image_pipeline(image_pipeline &&) = delete;
+		image_pipeline &operator=(const image_pipeline &) = delete;
+		image_pipeline &operator=(image_pipeline &&) = delete;
+
+		void run_request(const std::wstring &, const std::filesystem::path &, const image_size &, std::promise<image_ptr> &);
+		image_ptr decode_file(const std::filesystem::path &, const image_size &) const;
+
+		std::vector<std::unique_ptr<image_decoder>> m_decoders;
+		task_executor::task_executor &m_executor;
+
+		mutable std::mutex m_lock;
+		//Signalled when the last submitted request finishes.
+		std::condition_variable m_idle;
+		size_t m_outstanding = 0;
+		std::unordered_map<std::wstring, std::shared_future<image_ptr>> m_in_flight;
+		bitmap_cache m_cache;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		uint64_t m_deduplicated = 0;
+		bool m_stopping = false;
+	};
+}
\ No newline at end of file
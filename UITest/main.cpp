@@ -1,20 +1,143 @@
 #include "framework.h"
 #include <application.hpp>
-#include <application_helper.hpp>
 #include <apartment.hpp>
 #include <application_dispatcher_queue.hpp>
 #include "window.h"
+#include "batch_renderer.h"
+#include "async_log.h"
+#include "debugger_sink.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string_view>
 
 static application::apartment s_main_apartment{ application::winrt };
 static application::application_system_dispatcher_queue s_app_dispatcher_queue{};
 
+struct app_options
+{
+	std::filesystem::path image_path;
+	std::filesystem::path record_path;
+	std::filesystem::path replay_path;
+	std::filesystem::path batch_path;
+	uint64_t batch_frames = 600;
+	float white_point = 1.f;
+	session_log::replay_timing replay_timing = session_log::replay_timing::fast;
+	bool show_hud = false;
+	bool layered = false;
+	bool canvas = false;
+	bool shapes = false;
+	surface_config::surface_config surface;
+};
+
+static app_options parse_command_line()
+{
+	app_options options;
+
+	for (int i = 1; i < __argc; ++i)
+	{
+		std::wstring_view arg{ __wargv[i] };
+
+		if (arg == L"/image" && i + 1 < __argc)
+		{
+			options.image_path = __wargv[++i];
+		}
+		else if (arg == L"/record" && i + 1 < __argc)
+		{
+			options.record_path = __wargv[++i];
+		}
+		else if (arg == L"/replay" && i + 1 < __argc)
+		{
+			options.replay_path = __wargv[++i];
+		}
+		else if (arg == L"/batch" && i + 1 < __argc)
+		{
+			options.batch_path = __wargv[++i];
+		}
+		else if (arg == L"/frames" && i + 1 < __argc)
+		{
+			options.batch_frames = std::stoull(__wargv[++i]);
+		}
+		else if (arg == L"/whitepoint" && i + 1 < __argc)
+		{
+			options.white_point = std::stof(__wargv[++i]);
+		}
+		else if (arg == L"/realtime")
+		{
+			options.replay_timing = session_log::replay_timing::original;
+		}
+		else if (arg == L"/hud")
+		{
+			options.show_hud = true;
+		}
+		else if (arg == L"/layered")
+		{
+			options.layered = true;
+		}
+		else if (arg == L"/canvas")
+		{
+			options.canvas = true;
+		}
+		else if (arg == L"/shapes")
+		{
+			options.shapes = true;
+		}
+		else if (arg == L"/hdr")
+		{
+			options.surface.format = surface_config::surface_format::rgba16f_scrgb;
+		}
+	}
+
+	return options;
+}
+
+//This is a GUI process, so it has no console of its own.
+//Output goes to the console of whatever started it, if there is one.
+static void write_to_parent_console(std::wstring_view text)
+{
+	if (!AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		return;
+	}
+
+	wil::unique_hfile console{ CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr) };
+	if (console)
+	{
+		DWORD written = 0;
+		WriteConsoleW(console.get(), text.data(), static_cast<DWORD>(text.size()), &written, nullptr);
+		WriteConsoleW(console.get(), L"\r\n", 2, &written, nullptr);
+	}
+	FreeConsole();
+}
+
 int protected_main(HINSTANCE inst, int cmd_show)
 {
+	auto options = parse_command_line();
+
+	//Batch mode renders straight to files and never creates a window.
+	if (!options.batch_path.empty())
+	{
+		batch_renderer::batch_options batch{};
+		batch.output_directory = options.batch_path;
+		batch.frame_count = options.batch_frames;
+		batch.surface = options.surface;
+		batch.white_point = options.white_point;
+
+		auto stats = batch_renderer::render_batch(batch);
+		auto summary = batch_renderer::format_stats(stats);
+		ASYNC_LOG(info, L"{}", summary);
+
+		//The result is kept with the frames it describes.
+		std::wofstream{ batch.output_directory / L"batch_stats.txt", std::ios::trunc } << summary << L'\n';
+		write_to_parent_console(summary);
+		return 0;
+	}
+
 	int main_result = 0;
 	application::application main_application;
 	auto app_thread = main_application.get_for_thread();
 	s_app_dispatcher_queue.create_dispatcher_queue_on_thread();
-	windowing::main_window *main_window_ptr = windowing::main_window::create(inst);
+	windowing::main_window *main_window_ptr = windowing::main_window::create(inst, options.surface);
 
 	app_thread.add_pump_simple_callback([](const MSG &msg)
 		{
@@ -24,9 +147,30 @@ int protected_main(HINSTANCE inst, int cmd_show)
 
 	if (main_window_ptr)
 	{
+		if (!options.image_path.empty())
+		{
+			main_window_ptr->get_draw_interface()->set_image(options.image_path);
+		}
+		if (options.show_hud)
+		{
+			main_window_ptr->get_draw_interface()->toggle_hud();
+		}
+		main_window_ptr->get_draw_interface()->set_layered(options.layered);
+		main_window_ptr->get_draw_interface()->set_canvas(options.canvas);
+		main_window_ptr->get_draw_interface()->set_shapes(options.shapes);
+
 		main_window_ptr->show_window_cmd(cmd_show);
 		main_window_ptr->update_window();
 
+		if (!options.replay_path.empty())
+		{
+			main_window_ptr->replay(session_log::read_log(options.replay_path), options.replay_timing);
+		}
+		else if (!options.record_path.empty())
+		{
+			main_window_ptr->start_recording(options.record_path);
+		}
+
 		main_result = app_thread.run_message_pump();
 	}
 
@@ -35,15 +179,19 @@ int protected_main(HINSTANCE inst, int cmd_show)
 
 int WINAPI wWinMain(_In_ HINSTANCE inst, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int cmd_show)
 {
-	using namespace application::helper;
+	async_log::add_sink(std::make_unique<async_log::debugger_sink>());
+
+	int result = -1;
 	try
 	{
-		return protected_main(inst, cmd_show);
+		result = protected_main(inst, cmd_show);
 	}
 	catch (...)
 	{
-		writeln_debugger(L"Uncaught exception in wWinMain.");
+		ASYNC_LOG(error, L"Uncaught exception in wWinMain.");
 	}
 
-	return -1;
+	//Nothing logged is lost when the process exits.
+	async_log::flush();
+	return result;
 }
\ No newline at end of file
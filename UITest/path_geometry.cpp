@@ -0,0 +1,406 @@
+#include "path_geometry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+
+namespace path_geometry
+{
+	namespace
+	{
+		//The usual constant for approximating a quarter circle with a cubic.
+		constexpr float circle_kappa = 0.5522847498f;
+		//Stops a huge scale from producing millions of points for one curve.
+		constexpr uint32_t max_curve_segments = 1024;
+
+		point operator+(const point &a, const point &b)
+		{
+			return { a.x + b.x, a.y + b.y };
+		}
+
+		point operator-(const point &a, const point &b)
+		{
+			return { a.x - b.x, a.y - b.y };
+		}
+
+		point operator*(const point &a, float s)
+		{
+			return { a.x * s, a.y * s };
+		}
+
+		float length(const point &a)
+		{
+			return std::sqrt(a.x * a.x + a.y * a.y);
+		}
+
+		//A polyline with n segments is within deviation / n^2 of the curve,
+		//where the deviation comes from the second differences of the control points.
+		uint32_t curve_segments(float deviation, float scale, float tolerance)
+		{
+			auto segments = std::ceil(std::sqrt(deviation * scale / tolerance));
+			return static_cast<uint32_t>(std::clamp(segments, 1.f, static_cast<float>(max_curve_segments)));
+		}
+
+		float signed_area(const contour &points)
+		{
+			float area = 0.f;
+			for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++)
+			{
+				area += points[j].x * points[i].y - points[i].x * points[j].y;
+			}
+			return area * 0.5f;
+		}
+
+		void add_oriented(polygon_set &polygons, contour &&points)
+		{
+			if (signed_area(points) < 0.f)
+			{
+				std::reverse(points.begin(), points.end());
+			}
+			polygons.contours.push_back(std::move(points));
+		}
+
+		void update_bounds(polygon_set &polygons)
+		{
+			bounds box{ FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (auto &points : polygons.contours)
+			{
+				for (auto &p : points)
+				{
+					box.left = std::min(box.left, p.x);
+					box.top = std::min(box.top, p.y);
+					box.right = std::max(box.right, p.x);
+					box.bottom = std::max(box.bottom, p.y);
+				}
+			}
+			polygons.box = polygons.contours.empty() ? bounds{} : box;
+		}
+	}
+
+	point transform::apply(const point &p) const
+	{
+		return { p.x * m11 + p.y * m21 + dx, p.x * m12 + p.y * m22 + dy };
+	}
+
+	float transform::get_scale() const
+	{
+		return std::max(std::sqrt(m11 * m11 + m12 * m12), std::sqrt(m21 * m21 + m22 * m22));
+	}
+
+	path &path::move_to(const point &p)
+	{
+		m_commands.push_back(command::move_to);
+		m_points.push_back(p);
+		return *this;
+	}
+
+	path &path::line_to(const point &p)
+	{
+		m_commands.push_back(command::line_to);
+		m_points.push_back(p);
+		return *this;
+	}
+
+	path &path::quad_to(const point &control, const point &p)
+	{
+		m_commands.push_back(command::quad_to);
+		m_points.push_back(control);
+		m_points.push_back(p);
+		return *this;
+	}
+
+	path &path::cubic_to(const point &control1, const point &control2, const point &p)
+	{
+		m_commands.push_back(command::cubic_to);
+		m_points.push_back(control1);
+		m_points.push_back(control2);
+		m_points.push_back(p);
+		return *this;
+	}
+
+	path &path::close()
+	{
+		m_commands.push_back(command::close);
+		return *this;
+	}
+
+	path &path::add_ellipse(const point &centre, float radius_x, float radius_y, bool reversed)
+	{
+		//Mirroring vertically reverses the winding.
+		float ry = reversed ? -radius_y : radius_y;
+		float kx = radius_x * circle_kappa;
+		float ky = ry * circle_kappa;
+		float cx = centre.x;
+		float cy = centre.y;
+
+		move_to({ cx + radius_x, cy });
+		cubic_to({ cx + radius_x, cy + ky }, { cx + kx, cy + ry }, { cx, cy + ry });
+		cubic_to({ cx - kx, cy + ry }, { cx - radius_x, cy + ky }, { cx - radius_x, cy });
+		cubic_to({ cx - radius_x, cy - ky }, { cx - kx, cy - ry }, { cx, cy - ry });
+		cubic_to({ cx + kx, cy - ry }, { cx + radius_x, cy - ky }, { cx + radius_x, cy });
+		return close();
+	}
+
+	path &path::add_rounded_rect(const bounds &box, float radius)
+	{
+		float r = std::clamp(radius, 0.f, std::min(box.right - box.left, box.bottom - box.top) * 0.5f);
+		float k = r * (1.f - circle_kappa);
+
+		move_to({ box.left + r, box.top });
+		line_to({ box.right - r, box.top });
+		cubic_to({ box.right - k, box.top }, { box.right, box.top + k }, { box.right, box.top + r });
+		line_to({ box.right, box.bottom - r });
+		cubic_to({ box.right, box.bottom - k }, { box.right - k, box.bottom }, { box.right - r, box.bottom });
+		line_to({ box.left + r, box.bottom });
+		cubic_to({ box.left + k, box.bottom }, { box.left, box.bottom - k }, { box.left, box.bottom - r });
+		line_to({ box.left, box.top + r });
+		cubic_to({ box.left, box.top + k }, { box.left + k, box.top }, { box.left + r, box.top });
+		return close();
+	}
+
+	const std::vector<command> &path::get_commands() const
+	{
+		return m_commands;
+	}
+
+	const std::vector<point> &path::get_points() const
+	{
+		return m_points;
+	}
+
+	bool path::empty() const
+	{
+		return m_commands.empty();
+	}
+
+	std::vector<polyline> flatten(const path &source, float scale, float tolerance)
+	{
+		assert(tolerance > 0.f);
+
+		std::vector<polyline> lines;
+		polyline current;
+		point start{};
+		point pen{};
+		auto &points = source.get_points();
+		size_t next = 0;
+
+		auto finish = [&lines, &current](bool closed)
+			{
+				if (current.points.size() > 1)
+				{
+					current.closed = closed;
+					lines.push_back(std::move(current));
+				}
+				current = {};
+			};
+		//Drawing without a move starts from wherever the pen was left.
+		auto begin_segment = [&current, &pen]()
+			{
+				if (current.points.empty())
+				{
+					current.points.push_back(pen);
+				}
+			};
+
+		for (auto cmd : source.get_commands())
+		{
+			switch (cmd)
+			{
+			case command::move_to:
+				finish(false);
+				start = pen = points[next++];
+				current.points.push_back(pen);
+				break;
+			case command::line_to:
+				begin_segment();
+				pen = points[next++];
+				current.points.push_back(pen);
+				break;
+			case command::quad_to:
+			{
+				begin_segment();
+				auto p0 = pen;
+				auto p1 = points[next];
+				auto p2 = points[next + 1];
+				next += 2;
+
+				auto segments = curve_segments(0.25f * length(p0 - p1 * 2.f + p2), scale, tolerance);
+				for (uint32_t i = 1; i <= segments; ++i)
+				{
+					float t = static_cast<float>(i) / static_cast<float>(segments);
+					float u = 1.f - t;
+					current.points.push_back(p0 * (u * u) + p1 * (2.f * u * t) + p2 * (t * t));
+				}
+				pen = p2;
+				break;
+			}
+			case command::cubic_to:
+			{
+				begin_segment();
+				auto p0 = pen;
+				auto p1 = points[next];
+				auto p2 = points[next + 1];
+				auto p3 = points[next + 2];
+				next += 3;
+
+				auto deviation = 0.75f * std::max(length(p0 - p1 * 2.f + p2), length(p1 - p2 * 2.f + p3));
+				auto segments = curve_segments(deviation, scale, tolerance);
+				for (uint32_t i = 1; i <= segments; ++i)
+				{
+					float t = static_cast<float>(i) / static_cast<float>(segments);
+					float u = 1.f - t;
+					current.points.push_back(p0 * (u * u * u) + p1 * (3.f * u * u * t) + p2 * (3.f * u * t * t) + p3 * (t * t * t));
+				}
+				pen = p3;
+				break;
+			}
+			case command::close:
+				finish(true);
+				pen = start;
+				break;
+			}
+		}
+		finish(false);
+
+		return lines;
+	}
+
+	polygon_set fill_outline(const std::vector<polyline> &lines)
+	{
+		polygon_set polygons;
+		polygons.contours.reserve(lines.size());
+		for (auto &line : lines)
+		{
+			polygons.contours.push_back(line.points);
+		}
+		update_bounds(polygons);
+
+		return polygons;
+	}
+
+	polygon_set stroke_outline(const std::vector<polyline> &lines, float width)
+	{
+		constexpr size_t join_sides = 8;
+		float half_width = width * 0.5f;
+
+		polygon_set polygons;
+		for (auto &line : lines)
+		{
+			auto &points = line.points;
+			size_t segment_count = line.closed ? points.size() : points.size() - 1;
+
+			for (size_t i = 0; i < segment_count; ++i)
+			{
+				auto a = points[i];
+				auto b = points[(i + 1) % points.size()];
+				auto direction = b - a;
+				auto segment_length = length(direction);
+				if (segment_length <= 0.f)
+				{
+					continue;
+				}
+
+				point normal{ -direction.y * half_width / segment_length, direction.x * half_width / segment_length };
+				add_oriented(polygons, { a + normal, b + normal, b - normal, a - normal });
+			}
+
+			for (auto &p : points)
+			{
+				contour join;
+				join.reserve(join_sides);
+				for (size_t side = 0; side < join_sides; ++side)
+				{
+					float angle = static_cast<float>(side) * (6.2831853f / static_cast<float>(join_sides));
+					join.push_back({ p.x + std::cos(angle) * half_width, p.y + std::sin(angle) * half_width });
+				}
+				add_oriented(polygons, std::move(join));
+			}
+		}
+		update_bounds(polygons);
+
+		return polygons;
+	}
+
+	geometry::geometry(path &&source, float tolerance) : m_path{ std::move(source) }, m_tolerance{ tolerance }
+	{
+		assert(tolerance > 0.f);
+	}
+
+	const polygon_set &geometry::get_fill(float scale)
+	{
+		auto bucket = scale_bucket(scale);
+		if (m_flattened.contains(bucket))
+		{
+			++m_hits;
+		}
+		else
+		{
+			++m_misses;
+		}
+
+		return get_flattened(bucket).fill;
+	}
+
+	const polygon_set &geometry::get_stroke(float scale, float width)
+	{
+		stroke_key key{ scale_bucket(scale), width };
+		auto it = m_strokes.find(key);
+		if (it != m_strokes.end())
+		{
+			++m_hits;
+			return it->second;
+		}
+
+		++m_misses;
+		return m_strokes.emplace(key, stroke_outline(get_flattened(key.bucket).lines, width)).first->second;
+	}
+
+	const path &geometry::get_path() const
+	{
+		return m_path;
+	}
+
+	uint64_t geometry::hit_count() const
+	{
+		return m_hits;
+	}
+
+	uint64_t geometry::miss_count() const
+	{
+		return m_misses;
+	}
+
+	int32_t geometry::scale_bucket(float scale)
+	{
+		return static_cast<int32_t>(std::lround(std::log2(std::max(scale, 1e-6f)) * 4.f));
+	}
+
+	float geometry::bucket_scale(int32_t bucket)
+	{
+		return std::exp2((static_cast<float>(bucket) + 0.5f) * 0.25f);
+	}
+
+	size_t geometry::stroke_key_hash::operator()(const stroke_key &key) const noexcept
+	{
+		uint64_t bits = (static_cast<uint64_t>(static_cast<uint32_t>(key.bucket)) << 32) | std::bit_cast<uint32_t>(key.width);
+		return std::hash<uint64_t>{}(bits);
+	}
+
+	const geometry::flattened &geometry::get_flattened(int32_t bucket)
+	{
+		auto it = m_flattened.find(bucket);
+		if (it != m_flattened.end())
+		{
+			return it->second;
+		}
+
+		flattened result;
+		result.lines = flatten(m_path, bucket_scale(bucket), m_tolerance);
+		result.fill = fill_outline(result.lines);
+
+		return m_flattened.emplace(bucket, std::move(result)).first->second;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+//Vector paths, flattened into polygons that are cached per scale.
+//This doesn't depend on Windows, so the flattening can be tested anywhere.
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace path_geometry
+{
+	struct point
+	{
+		float x{};
+		float y{};
+	};
+
+	//Maps x, y to x * m11 + y * m21 + dx, x * m12 + y * m22 + dy, the same layout as D2D1_MATRIX_3X2_F.
+	struct transform
+	{
+		float m11 = 1.f;
+		float m12 = 0.f;
+		float m21 = 0.f;
+		float m22 = 1.f;
+		float dx = 0.f;
+		float dy = 0.f;
+
+		point apply(const point &) const;
+		//The largest factor any length can be stretched by, which decides how finely curves are flattened.
+		float get_scale() const;
+
+		bool operator==(const transform &) const = default;
+	};
+
+	struct bounds
+	{
+		float left{};
+		float top{};
+		float right{};
+		float bottom{};
+	};
+
+	struct polyline
+	{
+		std::vector<point> points;
+		bool closed{};
+	};
+
+	//Every contour is closed, the last point joins back to the first.
+	using contour = std::vector<point>;
+
+	struct polygon_set
+	{
+		std::vector<contour> contours;
+		bounds box{};
+	};
+
+	enum class command : uint8_t
+	{
+		move_to,
+		line_to,
+		quad_to,
+		cubic_to,
+		close
+	};
+
+	//Fills use the non zero rule, so holes need the opposite winding to the outline.
+	class path
+	{
+	public:
+		path &move_to(const point &);
+		path &line_to(const point &);
+		path &quad_to(const point &, const point &);
+		path &cubic_to(const point &, const point &, const point &);
+		path &close();
+
+		//Four cubics, each within 0.03% of the radius of a true circle.
+		path &add_ellipse(const point &, float, float, bool = false);
+		path &add_rounded_rect(const bounds &, float);
+
+		const std::vector<command> &get_commands() const;
+		const std::vector<point> &get_points() const;
+		bool empty() const;
+
+	private:
+		std::vector<command> m_commands;
+		std::vector<point> m_points;
+	};
+
+	//Curves are split so the polyline stays within the tolerance of the curve once the scale is applied.
+	std::vector<polyline> flatten(const path &, float, float);
+	//Open polylines are closed when filling.
+	polygon_set fill_outline(const std::vector<polyline> &);
+	//Turns polylines into polygons that all wind the same way, so they add up under the non zero rule.
+	//Each segment becomes a quad and each joint gets an octagon, which is close enough to round joins.
+	polygon_set stroke_outline(const std::vector<polyline> &, float);
+
+	//A path that is only flattened when it is drawn at a new scale.
+	//Scales are grouped in quarter steps of a power of two, and each group is flattened
+	//for the largest scale in it, so zooming smoothly reuses the same polygons.
+	class geometry
+	{
+	public:
+		constexpr static float default_tolerance = 0.2f;
+
+		explicit geometry(path &&, float = default_tolerance);
+
+		const polygon_set &get_fill(float);
+		//The stroke width is in path units, so it scales with the path.
+		const polygon_set &get_stroke(float, float);
+		const path &get_path() const;
+
+		uint64_t hit_count() const;
+		uint64_t miss_count() const;
+
+		static int32_t scale_bucket(float);
+		static float bucket_scale(int32_t);
+
+	private:
+		struct stroke_key
+		{
+			int32_t bucket{};
+			float width{};
+
+			bool operator==(const stroke_key &) const = default;
+		};
+
+		struct stroke_key_hash
+		{
+			size_t operator()(const stroke_key &) const noexcept;
+		};
+
+		struct flattened
+		{
+			std::vector<polyline> lines;
+			polygon_set fill;
+		};
+
+		const flattened &get_flattened(int32_t);
+
+		path m_path;
+		float m_tolerance;
+		//Neither map is bounded, but there are only a few dozen buckets between
+		//the smallest and largest scale anything is drawn at.
+		std::unordered_map<int32_t, flattened> m_flattened;
+		std::unordered_map<stroke_key, polygon_set, stroke_key_hash> m_strokes;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+	};
+}
\ No newline at end of file
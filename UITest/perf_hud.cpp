@@ -0,0 +1,186 @@
+#include "perf_hud.h"
+
+#include <algorithm>
+
+namespace perf_hud
+{
+	namespace
+	{
+		constexpr auto refresh_interval = std::chrono::milliseconds{ 250 };
+		constexpr float frame_budget_ms = 1000.f / 60.f;
+		//Bars are scaled so that twice the frame budget fills the graph.
+		constexpr float graph_scale_ms = frame_budget_ms * 2.f;
+		constexpr float panel_width = 260.f;
+		constexpr float panel_margin = 8.f;
+		constexpr float text_height = 96.f;
+		constexpr float graph_height = 48.f;
+		constexpr float bar_width = (panel_width - panel_margin * 2.f) / static_cast<float>(perf_hud::history_size);
+
+		float to_ms(clock::duration duration)
+		{
+			return std::chrono::duration<float, std::milli>(duration).count();
+		}
+
+		float hit_rate(uint64_t hits, uint64_t misses)
+		{
+			auto total = hits + misses;
+			return total != 0 ? 100.f * static_cast<float>(hits) / static_cast<float>(total) : 0.f;
+		}
+	}
+
+	void perf_hud::init_device_independent_resources(IDWriteFactory7 *factory)
+	{
+		using namespace winrt;
+
+		com_ptr<IDWriteTextFormat> text_format;
+		check_hresult(factory->CreateTextFormat(L"Consolas", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 12.f, L"en-gb", text_format.put()));
+
+		m_dwrite_factory = factory;
+		m_text_format = text_format;
+	}
+
+	void perf_hud::cleanup_device_independent_resources()
+	{
+		m_text_layout = nullptr;
+		m_text_format = nullptr;
+		m_dwrite_factory = nullptr;
+	}
+
+	void perf_hud::init_device_dependent_resources(ID2D1DeviceContext *device_context, const surface_config::surface_config &surface)
+	{
+		using namespace winrt;
+
+		com_ptr<ID2D1SolidColorBrush> background_brush;
+		com_ptr<ID2D1SolidColorBrush> text_brush;
+		com_ptr<ID2D1SolidColorBrush> graph_brush;
+		com_ptr<ID2D1SolidColorBrush> graph_over_brush;
+		check_hresult(device_context->CreateSolidColorBrush(surface.colour(D2D1::ColorF(D2D1::ColorF::Black, 0.7f)), background_brush.put()));
+		check_hresult(device_context->CreateSolidColorBrush(surface.colour(D2D1::ColorF(D2D1::ColorF::White)), text_brush.put()));
+		check_hresult(device_context->CreateSolidColorBrush(surface.colour(D2D1::ColorF(D2D1::ColorF::LimeGreen)), graph_brush.put()));
+		check_hresult(device_context->CreateSolidColorBrush(surface.colour(D2D1::ColorF(D2D1::ColorF::Red)), graph_over_brush.put()));
+
+		m_background_brush = background_brush;
+		m_text_brush = text_brush;
+		m_graph_brush = graph_brush;
+		m_graph_over_brush = graph_over_brush;
+	}
+
+	void perf_hud::cleanup_device_dependent_resources()
+	{
+		m_graph_over_brush = nullptr;
+		m_graph_brush = nullptr;
+		m_text_brush = nullptr;
+		m_background_brush = nullptr;
+	}
+
+	void perf_hud::toggle()
+	{
+		m_enabled = !m_enabled;
+
+		//Frames from before the overlay was hidden would show up as one huge interval.
+		m_history_next = 0;
+		m_history_count = 0;
+		m_last_frame_start = {};
+		m_last_hud_time = {};
+		m_last_refresh = {};
+		m_text_layout = nullptr;
+	}
+
+	bool perf_hud::is_enabled() const
+	{
+		return m_enabled;
+	}
+
+	void perf_hud::add_frame(const frame_timing &timing)
+	{
+		//The previous frame drew the overlay somewhere between the two starts, so its
+		//cost comes off the interval as well, or the frame rate would include the overlay.
+		frame_sample sample{};
+		sample.interval_ms = m_last_frame_start != clock::time_point{} ? to_ms(timing.frame_start - m_last_frame_start - m_last_hud_time) : 0.f;
+		sample.work_ms = to_ms(timing.frame_end - timing.frame_start - timing.hud_time - timing.present_time);
+		sample.present_ms = to_ms(timing.present_time);
+
+		m_history[m_history_next] = sample;
+		m_history_next = (m_history_next + 1) % history_size;
+		m_history_count = std::min(m_history_count + 1, history_size);
+		m_last_frame_start = timing.frame_start;
+		m_last_hud_time = timing.hud_time;
+	}
+
+	bool perf_hud::is_refresh_due(clock::time_point now) const
+	{
+		return now - m_last_refresh >= refresh_interval;
+	}
+
+	void perf_hud::refresh(const hud_counters &counters, clock::time_point now)
+	{
+		using namespace winrt;
+
+		m_last_refresh = now;
+
+		float interval_total = 0.f;
+		float work_total = 0.f;
+		float work_max = 0.f;
+		float present_total = 0.f;
+		size_t interval_count = 0;
+		for (size_t i = 0; i < m_history_count; ++i)
+		{
+			auto &sample = m_history[i];
+			if (sample.interval_ms > 0.f)
+			{
+				interval_total += sample.interval_ms;
+				++interval_count;
+			}
+			work_total += sample.work_ms;
+			work_max = std::max(work_max, sample.work_ms);
+			present_total += sample.present_ms;
+		}
+
+		float count = static_cast<float>(std::max<size_t>(m_history_count, 1));
+		float fps = interval_total > 0.f ? 1000.f * static_cast<float>(interval_count) / interval_total : 0.f;
+
+		auto text = std::format(L"FPS {:.1f}  frame {:.2f}ms (max {:.2f})\npresent {:.2f}ms  resizes {}  minimised {}\nglyph cache {:.1f}%  image cache {:.1f}%\ntile cache {:.1f}%  tiles {}\ntasks queued {}  stolen {}\nhud {:.3f}ms",
+			fps, work_total / count, work_max, present_total / count, counters.resizes, counters.minimises,
+			hit_rate(counters.glyph_hits, counters.glyph_misses), hit_rate(counters.image_hits, counters.image_misses),
+			hit_rate(counters.tile_hits, counters.tile_misses), counters.tiles_resident,
+			counters.tasks_queued, counters.tasks_stolen, to_ms(m_last_hud_time));
+
+		com_ptr<IDWriteTextLayout> text_layout;
+		check_hresult(m_dwrite_factory->CreateTextLayout(text.data(), static_cast<UINT32>(text.size()), m_text_format.get(), panel_width - panel_margin * 2.f, text_height, text_layout.put()));
+		m_text_layout = text_layout;
+	}
+
+	void perf_hud::draw(ID2D1DeviceContext *device_context, const D2D1_POINT_2F &origin) const
+	{
+		float left = origin.x;
+		float top = origin.y;
+		float graph_bottom = top + panel_margin + text_height + graph_height;
+
+		device_context->FillRectangle(D2D1::RectF(left, top, left + panel_width, graph_bottom + panel_margin), m_background_brush.get());
+
+		if (m_text_layout)
+		{
+			device_context->DrawTextLayout(D2D1::Point2F(left + panel_margin, top + panel_margin), m_text_layout.get(), m_text_brush.get());
+		}
+
+		//Oldest sample on the left.
+		size_t first = (m_history_next + history_size - m_history_count) % history_size;
+		for (size_t i = 0; i < m_history_count; ++i)
+		{
+			auto &sample = m_history[(first + i) % history_size];
+			float height = std::min(sample.work_ms / graph_scale_ms, 1.f) * graph_height;
+			float x = left + panel_margin + static_cast<float>(i) * bar_width;
+
+			auto brush = sample.work_ms > frame_budget_ms ? m_graph_over_brush.get() : m_graph_brush.get();
+			device_context->FillRectangle(D2D1::RectF(x, graph_bottom - height, x + bar_width, graph_bottom), brush);
+		}
+
+		float budget_y = graph_bottom - (frame_budget_ms / graph_scale_ms) * graph_height;
+		device_context->DrawLine(D2D1::Point2F(left + panel_margin, budget_y), D2D1::Point2F(left + panel_width - panel_margin, budget_y), m_text_brush.get(), 1.f);
+	}
+
+	D2D1_SIZE_F perf_hud::get_panel_size()
+	{
+		return D2D1::SizeF(panel_width, panel_margin * 2.f + text_height + graph_height);
+	}
+}
\ No newline at end of file
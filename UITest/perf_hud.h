@@ -0,0 +1,88 @@
+#pragma once
+
+#include "framework.h"
+#include "surface_config.h"
+
+#include <array>
+#include <chrono>
+
+namespace perf_hud
+{
+	using clock = std::chrono::steady_clock;
+
+	//A frame as seen by draw_interface::update_frame.
+	//The time spent on the overlay is passed separately so it can be
+	//left out of both the frame time and the frame rate.
+	struct frame_timing
+	{
+		clock::time_point frame_start;
+		clock::time_point frame_end;
+		clock::duration hud_time;
+		clock::duration present_time;
+	};
+
+	struct hud_counters
+	{
+		uint64_t resizes{};
+		uint64_t minimises{};
+		uint64_t glyph_hits{};
+		uint64_t glyph_misses{};
+		uint64_t image_hits{};
+		uint64_t image_misses{};
+		uint64_t tile_hits{};
+		uint64_t tile_misses{};
+		size_t tiles_resident{};
+		size_t tasks_queued{};
+		uint64_t tasks_stolen{};
+	};
+
+	//A small overlay with the frame rate, a frame time graph, present time,
+	//resize counts and cache hit rates.
+	//The text is only laid out a few times a second and the graph is a
+	//single pass of rectangles, so drawing it stays well under 0.1ms.
+	class perf_hud
+	{
+	public:
+		constexpr static size_t history_size = 120;
+
+		void init_device_independent_resources(IDWriteFactory7 *);
+		void cleanup_device_independent_resources();
+		void init_device_dependent_resources(ID2D1DeviceContext *, const surface_config::surface_config &);
+		void cleanup_device_dependent_resources();
+
+		void toggle();
+		bool is_enabled() const;
+
+		void add_frame(const frame_timing &);
+
+		bool is_refresh_due(clock::time_point) const;
+		void refresh(const hud_counters &, clock::time_point);
+		void draw(ID2D1DeviceContext *, const D2D1_POINT_2F &) const;
+
+		static D2D1_SIZE_F get_panel_size();
+
+	private:
+		struct frame_sample
+		{
+			float interval_ms;
+			float work_ms;
+			float present_ms;
+		};
+
+		std::array<frame_sample, history_size> m_history{};
+		size_t m_history_next = 0;
+		size_t m_history_count = 0;
+		clock::time_point m_last_frame_start{};
+		clock::duration m_last_hud_time{};
+		clock::time_point m_last_refresh{};
+		bool m_enabled = false;
+
+		IDWriteFactory7 *m_dwrite_factory{};
+		winrt::com_ptr<IDWriteTextFormat> m_text_format;
+		winrt::com_ptr<IDWriteTextLayout> m_text_layout;
+		winrt::com_ptr<ID2D1SolidColorBrush> m_background_brush;
+		winrt::com_ptr<ID2D1SolidColorBrush> m_text_brush;
+		winrt::com_ptr<ID2D1SolidColorBrush> m_graph_brush;
+		winrt::com_ptr<ID2D1SolidColorBrush> m_graph_over_brush;
+	};
+}
\ No newline at end of file
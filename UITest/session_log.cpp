@@ -0,0 +1,321 @@
+#include "session_log.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+
+namespace session_log
+{
+	namespace
+	{
+		constexpr uint32_t log_magic = 0x4c535549; //'UISL'
+		constexpr uint32_t log_version = 1;
+		constexpr size_t buffer_flush_size = 64 * 1024;
+		//Larger than any swap chain can be, so anything bigger is a corrupt log.
+		constexpr uint64_t max_log_dimention = 16384;
+
+		class log_reader
+		{
+		public:
+			explicit log_reader(std::vector<uint8_t> &&data) : m_data{ std::move(data) }
+			{
+			}
+
+			bool at_end() const
+			{
+				return m_offset == m_data.size();
+			}
+
+			uint8_t read_byte()
+			{
+				if (at_end())
+				{
+					throw std::runtime_error("Truncated session log.");
+				}
+				return m_data[m_offset++];
+			}
+
+			uint32_t read_u32()
+			{
+				uint32_t value = 0;
+				for (int i = 0; i < 4; ++i)
+				{
+					value |= static_cast<uint32_t>(read_byte()) << (i * 8);
+				}
+				return value;
+			}
+
+			uint64_t read_value()
+			{
+				uint64_t value = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					uint8_t byte = read_byte();
+					value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+					if ((byte & 0x80) == 0)
+					{
+						return value;
+					}
+				}
+				throw std::runtime_error("Session log value too long.");
+			}
+
+		private:
+			std::vector<uint8_t> m_data;
+			size_t m_offset = 0;
+		};
+
+		double percentile(const std::vector<double> &sorted, double fraction)
+		{
+			auto index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+			return sorted[index];
+		}
+	}
+
+	recorder::recorder(const std::filesystem::path &path) : m_file{ path, std::ios::binary | std::ios::trunc }, m_start{ std::chrono::steady_clock::now() }
+	{
+		if (!m_file)
+		{
+			throw std::runtime_error("Unable to create session log.");
+		}
+
+		for (auto value : { log_magic, log_version })
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				m_buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+			}
+		}
+	}
+
+	recorder::~recorder()
+	{
+		try
+		{
+			flush();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void recorder::record_resize(const client_size &dimentions)
+	{
+		write_event(event_type::resize);
+		write_value(static_cast<uint32_t>(std::max(dimentions.width, 0)));
+		write_value(static_cast<uint32_t>(std::max(dimentions.height, 0)));
+	}
+
+	void recorder::record_minimize()
+	{
+		write_event(event_type::minimize);
+	}
+
+	void recorder::record_close()
+	{
+		write_event(event_type::close);
+		flush();
+	}
+
+	void recorder::record_tick()
+	{
+		write_event(event_type::tick);
+	}
+
+	void recorder::flush()
+	{
+		if (m_buffer.empty())
+		{
+			return;
+		}
+
+		m_file.write(reinterpret_cast<const char *>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+		m_file.flush();
+		m_buffer.clear();
+
+		if (!m_file)
+		{
+			throw std::runtime_error("Unable to write session log.");
+		}
+	}
+
+	void recorder::write_event(event_type type)
+	{
+		auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start);
+
+		m_buffer.push_back(static_cast<uint8_t>(type));
+		write_value(static_cast<uint64_t>((now - m_last_time).count()));
+		m_last_time = now;
+
+		if (m_buffer.size() >= buffer_flush_size)
+		{
+			flush();
+		}
+	}
+
+	void recorder::write_value(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			m_buffer.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		m_buffer.push_back(static_cast<uint8_t>(value));
+	}
+
+	std::vector<event> read_log(const std::filesystem::path &path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			throw std::runtime_error("Unable to open session log.");
+		}
+
+		log_reader reader{ { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} } };
+		if (reader.read_u32() != log_magic || reader.read_u32() != log_version)
+		{
+			throw std::runtime_error("Not a session log or an unsupported version.");
+		}
+
+		std::vector<event> events;
+		std::chrono::microseconds time{};
+		while (!reader.at_end())
+		{
+			event e{};
+			e.type = static_cast<event_type>(reader.read_byte());
+			time += std::chrono::microseconds{ static_cast<int64_t>(reader.read_value()) };
+			e.time = time;
+
+			switch (e.type)
+			{
+			case event_type::resize:
+			{
+				uint64_t width = reader.read_value();
+				uint64_t height = reader.read_value();
+				if (width > max_log_dimention || height > max_log_dimention)
+				{
+					throw std::runtime_error("Session log dimentions out of range.");
+				}
+				e.dimentions.width = static_cast<int32_t>(width);
+				e.dimentions.height = static_cast<int32_t>(height);
+				break;
+			}
+			case event_type::minimize:
+			case event_type::close:
+			case event_type::tick:
+			{
+				break;
+			}
+			default:
+			{
+				throw std::runtime_error("Unknown session log event.");
+			}
+			}
+
+			events.push_back(e);
+		}
+
+		return events;
+	}
+
+	void summarise_frame_times(std::vector<double> &frame_times, replay_stats &stats)
+	{
+		stats.frame_count = frame_times.size();
+		if (frame_times.empty())
+		{
+			return;
+		}
+
+		std::sort(frame_times.begin(), frame_times.end());
+		stats.frame_min = frame_times.front();
+		stats.frame_max = frame_times.back();
+		stats.frame_mean = std::accumulate(frame_times.begin(), frame_times.end(), 0.0) / static_cast<double>(frame_times.size());
+		stats.frame_p50 = percentile(frame_times, 0.50);
+		stats.frame_p95 = percentile(frame_times, 0.95);
+		stats.frame_p99 = percentile(frame_times, 0.99);
+	}
+
+	player::player(std::vector<event> &&events, replay_target &target, replay_timing timing) : m_events{ std::move(events) }, m_target{ target }, m_timing{ timing }, m_start{ std::chrono::steady_clock::now() }
+	{
+		m_frame_times.reserve(m_events.size());
+		m_target.set_present_interval(m_timing == replay_timing::fast ? 0 : 1);
+	}
+
+	bool player::step()
+	{
+		using clock = std::chrono::steady_clock;
+
+		if (m_finished)
+		{
+			return false;
+		}
+		if (m_next == m_events.size() || m_events[m_next].type == event_type::close)
+		{
+			finish();
+			return false;
+		}
+
+		auto &e = m_events[m_next++];
+		switch (e.type)
+		{
+		case event_type::resize:
+		{
+			m_target.resize(e.dimentions);
+			++m_stats.resize_count;
+			break;
+		}
+		case event_type::minimize:
+		{
+			m_target.minimize();
+			++m_stats.minimize_count;
+			break;
+		}
+		case event_type::tick:
+		{
+			//A tick while minimised draws nothing, so it isn't a frame.
+			auto frame_start = clock::now();
+			if (m_target.update_frame())
+			{
+				m_frame_times.push_back(std::chrono::duration<double, std::milli>(clock::now() - frame_start).count());
+			}
+			else
+			{
+				++m_stats.skipped_count;
+			}
+			break;
+		}
+		case event_type::close:
+		{
+			break;
+		}
+		}
+
+		return true;
+	}
+
+	std::chrono::microseconds player::next_delay() const
+	{
+		if (m_timing == replay_timing::fast || m_next == m_events.size())
+		{
+			return {};
+		}
+
+		auto delay = std::chrono::duration_cast<std::chrono::microseconds>(m_start + m_events[m_next].time - std::chrono::steady_clock::now());
+		return std::max(delay, std::chrono::microseconds{});
+	}
+
+	replay_stats player::get_stats() const
+	{
+		return m_stats;
+	}
+
+	void player::finish()
+	{
+		m_finished = true;
+		m_stats.total_time = std::chrono::steady_clock::now() - m_start;
+		m_target.set_present_interval(1);
+
+		summarise_frame_times(m_frame_times, m_stats);
+	}
+}
\ No newline at end of file
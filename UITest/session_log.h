@@ -0,0 +1,145 @@
+#pragma once
+
+//Recording and replaying the window events that drive the drawing interface.
+//This doesn't depend on Windows, the window connects the player to draw_interface.
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace session_log
+{
+	//Window and timing events that drive the drawing interface.
+	//A log replays against a replay_target exactly as the window drove it.
+	enum class event_type : uint8_t
+	{
+		resize = 1,
+		minimize,
+		close,
+		tick
+	};
+
+	struct client_size
+	{
+		int32_t width{};
+		int32_t height{};
+	};
+
+	struct event
+	{
+		event_type type{};
+		//Time since recording started.
+		std::chrono::microseconds time{};
+		client_size dimentions{};
+	};
+
+	//Events are written as a type byte, the time since the previous event
+	//and, for resizes, the new client size. All of the numbers are LEB128.
+	class recorder
+	{
+	public:
+		explicit recorder(const std::filesystem::path &);
+		~recorder();
+
+		void record_resize(const client_size &);
+		void record_minimize();
+		void record_close();
+		void record_tick();
+
+		void flush();
+
+	private:
+		recorder(const recorder &) = delete;
+		recorder(recorder &&) = delete;
+		recorder &operator=(const recorder &) = delete;
+		recorder &operator=(recorder &&) = delete;
+
+		void write_event(event_type);
+		void write_value(uint64_t);
+
+		std::ofstream m_file;
+		std::vector<uint8_t> m_buffer;
+		std::chrono::steady_clock::time_point m_start;
+		std::chrono::microseconds m_last_time{};
+	};
+
+	//Throws std::runtime_error for a log that is truncated or corrupt.
+	std::vector<event> read_log(const std::filesystem::path &);
+
+	enum class replay_timing
+	{
+		//Events are sent back to back and frames are presented without waiting for vsync.
+		fast,
+		//Events are sent at the times they were recorded.
+		original
+	};
+
+	struct replay_stats
+	{
+		uint64_t frame_count{};
+		//Ticks that didn't draw because the window was minimised.
+		uint64_t skipped_count{};
+		uint64_t resize_count{};
+		uint64_t minimize_count{};
+		std::chrono::duration<double> total_time{};
+		//Frame times in milliseconds.
+		double frame_min{};
+		double frame_mean{};
+		double frame_p50{};
+		double frame_p95{};
+		double frame_p99{};
+		double frame_max{};
+	};
+
+	//Sorts the frame times and fills in the frame statistics.
+	//The percentiles are the nearest sample to the fraction of the way through the sorted times.
+	void summarise_frame_times(std::vector<double> &, replay_stats &);
+
+	//What a log is replayed against, the drawing interface in the application.
+	class replay_target
+	{
+	public:
+		virtual ~replay_target() = default;
+
+		virtual void resize(const client_size &) = 0;
+		virtual void minimize() = 0;
+		//Returns false if nothing was drawn.
+		virtual bool update_frame() = 0;
+		virtual void set_present_interval(uint32_t) = 0;
+	};
+
+	//Sends the events of a log to a replay_target one at a time, so the
+	//window can run each step from its message loop.
+	//Stops at the end of the log or at a recorded close.
+	class player
+	{
+	public:
+		player(std::vector<event> &&, replay_target &, replay_timing);
+
+		//Sends the next event, returns false once the replay has finished.
+		bool step();
+		//How long to wait before the next step, always zero for fast replays.
+		std::chrono::microseconds next_delay() const;
+		//Complete once step has returned false.
+		replay_stats get_stats() const;
+
+	private:
+		player(const player &) = delete;
+		player(player &&) = delete;
+		player &operator=(const player &) = delete;
+		player &operator=(player &&) = delete;
+
+		void finish();
+
+		std::vector<event> m_events;
+		size_t m_next = 0;
+		replay_target &m_target;
+		replay_timing m_timing;
+		std::chrono::steady_clock::time_point m_start;
+		std::vector<double> m_frame_times;
+		replay_stats m_stats{};
+		bool m_finished = false;
+	};
+}
\ No newline at end of file
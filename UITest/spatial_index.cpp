@@ -0,0 +1,527 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <iterator>
+
+namespace spatial_index
+{
+	namespace
+	{
+		bounds unite(const bounds &a, const bounds &b)
+		{
+			return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+		}
+
+		float area(const bounds &b)
+		{
+			return (b.right - b.left) * (b.bottom - b.top);
+		}
+
+		bool covers(const bounds &outer, const bounds &inner)
+		{
+			return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right && outer.bottom >= inner.bottom;
+		}
+
+		float centre_x(const bounds &b)
+		{
+			return b.left + b.right;
+		}
+
+		float centre_y(const bounds &b)
+		{
+			return b.top + b.bottom;
+		}
+
+		bool is_above(const entry &a, const entry &b)
+		{
+			return a.z > b.z || (a.z == b.z && a.id > b.id);
+		}
+
+		//Sorts along the axis the centres are most spread out on, then moves the upper half to the output.
+		template <typename T, typename BoxOf>
+		void split_half(std::vector<T> &items, std::vector<T> &upper, BoxOf box_of)
+		{
+			float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX;
+			for (auto &item : items)
+			{
+				auto &box = box_of(item);
+				min_x = std::min(min_x, centre_x(box));
+				max_x = std::max(max_x, centre_x(box));
+				min_y = std::min(min_y, centre_y(box));
+				max_y = std::max(max_y, centre_y(box));
+			}
+
+			if (max_x - min_x >= max_y - min_y)
+			{
+				std::sort(items.begin(), items.end(), [&](const T &a, const T &b) { return centre_x(box_of(a)) < centre_x(box_of(b)); });
+			}
+			else
+			{
+				std::sort(items.begin(), items.end(), [&](const T &a, const T &b) { return centre_y(box_of(a)) < centre_y(box_of(b)); });
+			}
+
+			auto middle = items.begin() + static_cast<std::ptrdiff_t>(items.size() / 2);
+			upper.assign(std::make_move_iterator(middle), std::make_move_iterator(items.end()));
+			items.erase(middle, items.end());
+		}
+
+		//Groups items into runs of at most max_children for sort tile recursive packing.
+		//The items are sorted into vertical slices, then each slice is sorted top to bottom.
+		template <typename T, typename BoxOf, typename Emit>
+		void pack_level(std::vector<T> &items, BoxOf box_of, Emit emit)
+		{
+			auto group_count = (items.size() + rtree::max_children - 1) / rtree::max_children;
+			auto slice_count = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(group_count))));
+			auto slice_size = slice_count * rtree::max_children;
+
+			std::sort(items.begin(), items.end(), [&](const T &a, const T &b) { return centre_x(box_of(a)) < centre_x(box_of(b)); });
+
+			for (size_t slice_start = 0; slice_start < items.size(); slice_start += slice_size)
+			{
+				auto slice_end = std::min(slice_start + slice_size, items.size());
+				std::sort(items.begin() + slice_start, items.begin() + slice_end, [&](const T &a, const T &b) { return centre_y(box_of(a)) < centre_y(box_of(b)); });
+
+				for (size_t group_start = slice_start; group_start < slice_end; group_start += rtree::max_children)
+				{
+					emit(items.begin() + group_start, items.begin() + std::min(group_start + rtree::max_children, slice_end));
+				}
+			}
+		}
+	}
+
+	bool bounds::intersects(const bounds &other) const
+	{
+		return left < other.right && other.left < right && top < other.bottom && other.top < bottom;
+	}
+
+	bool bounds::contains(float x, float y) const
+	{
+		return x >= left && x < right && y >= top && y < bottom;
+	}
+
+	void rtree::bulk_load(std::vector<entry> &&entries)
+	{
+		clear();
+		if (entries.empty())
+		{
+			return;
+		}
+
+		m_size = entries.size();
+
+		std::vector<uint32_t> level;
+		pack_level(entries, [](const entry &e) -> const bounds & { return e.box; }, [&](auto first, auto last)
+			{
+				auto index = allocate_node(true);
+				m_nodes[index].entries.assign(first, last);
+				refresh_node(index);
+				level.push_back(index);
+			});
+
+		while (level.size() > 1)
+		{
+			std::vector<uint32_t> parents;
+			pack_level(level, [this](uint32_t index) -> const bounds & { return m_nodes[index].box; }, [&](auto first, auto last)
+				{
+					auto index = allocate_node(false);
+					m_nodes[index].children.assign(first, last);
+					refresh_node(index);
+					parents.push_back(index);
+				});
+			level = std::move(parents);
+		}
+
+		m_root = level.front();
+	}
+
+	void rtree::insert(const entry &e)
+	{
+		if (m_root == no_node)
+		{
+			m_root = allocate_node(true);
+		}
+
+		auto sibling = insert_into(m_root, e);
+		if (sibling != no_node)
+		{
+			auto root = allocate_node(false);
+			m_nodes[root].children = { m_root, sibling };
+			refresh_node(root);
+			m_root = root;
+		}
+
+		++m_size;
+	}
+
+	bool rtree::remove(element_id id, const bounds &box)
+	{
+		if (m_root == no_node)
+		{
+			return false;
+		}
+
+		//Nodes left with too few children are dissolved and their entries inserted again.
+		std::vector<entry> orphans;
+		if (!remove_from(m_root, id, box, orphans))
+		{
+			return false;
+		}
+		m_size -= 1 + orphans.size();
+
+		while (!m_nodes[m_root].leaf && m_nodes[m_root].children.size() == 1)
+		{
+			auto child = m_nodes[m_root].children.front();
+			m_nodes[m_root].children.clear();
+			free_subtree(m_root);
+			m_root = child;
+		}
+		if (child_count(m_root) == 0)
+		{
+			free_subtree(m_root);
+			m_root = no_node;
+		}
+
+		for (auto &orphan : orphans)
+		{
+			insert(orphan);
+		}
+
+		return true;
+	}
+
+	bool rtree::update(element_id id, const bounds &old_box, const entry &e)
+	{
+		if (!remove(id, old_box))
+		{
+			return false;
+		}
+
+		insert(e);
+		return true;
+	}
+
+	void rtree::clear()
+	{
+		m_nodes.clear();
+		m_free_nodes.clear();
+		m_root = no_node;
+		m_size = 0;
+	}
+
+	void rtree::query_rect(const bounds &box, std::vector<entry> &results) const
+	{
+		if (m_root == no_node)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> stack{ m_root };
+		while (!stack.empty())
+		{
+			auto &n = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!n.box.intersects(box))
+			{
+				continue;
+			}
+
+			if (n.leaf)
+			{
+				for (auto &e : n.entries)
+				{
+					if (e.box.intersects(box))
+					{
+						results.push_back(e);
+					}
+				}
+			}
+			else
+			{
+				stack.insert(stack.end(), n.children.begin(), n.children.end());
+			}
+		}
+	}
+
+	void rtree::query_point(float x, float y, std::vector<entry> &results) const
+	{
+		if (m_root == no_node)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> stack{ m_root };
+		while (!stack.empty())
+		{
+			auto &n = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!n.box.contains(x, y))
+			{
+				continue;
+			}
+
+			if (n.leaf)
+			{
+				for (auto &e : n.entries)
+				{
+					if (e.box.contains(x, y))
+					{
+						results.push_back(e);
+					}
+				}
+			}
+			else
+			{
+				stack.insert(stack.end(), n.children.begin(), n.children.end());
+			}
+		}
+	}
+
+	std::optional<entry> rtree::hit_test(float x, float y, const hit_filter &filter) const
+	{
+		std::optional<entry> best;
+		if (m_root != no_node)
+		{
+			hit_test_node(m_root, x, y, filter, best);
+		}
+
+		return best;
+	}
+
+	size_t rtree::size() const
+	{
+		return m_size;
+	}
+
+	uint32_t rtree::allocate_node(bool leaf)
+	{
+		uint32_t index;
+		if (!m_free_nodes.empty())
+		{
+			index = m_free_nodes.back();
+			m_free_nodes.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.emplace_back();
+		}
+
+		auto &n = m_nodes[index];
+		n.box = {};
+		n.max_z = INT32_MIN;
+		n.leaf = leaf;
+		return index;
+	}
+
+	void rtree::free_subtree(uint32_t index)
+	{
+		for (auto child : m_nodes[index].children)
+		{
+			free_subtree(child);
+		}
+
+		m_nodes[index].entries.clear();
+		m_nodes[index].children.clear();
+		m_free_nodes.push_back(index);
+	}
+
+	void rtree::refresh_node(uint32_t index)
+	{
+		auto &n = m_nodes[index];
+		bool first = true;
+		n.max_z = INT32_MIN;
+
+		auto add = [&](const bounds &box, int32_t z)
+			{
+				n.box = first ? box : unite(n.box, box);
+				n.max_z = std::max(n.max_z, z);
+				first = false;
+			};
+
+		if (n.leaf)
+		{
+			for (auto &e : n.entries)
+			{
+				add(e.box, e.z);
+			}
+		}
+		else
+		{
+			for (auto child : n.children)
+			{
+				add(m_nodes[child].box, m_nodes[child].max_z);
+			}
+		}
+
+		if (first)
+		{
+			n.box = {};
+		}
+	}
+
+	size_t rtree::child_count(uint32_t index) const
+	{
+		auto &n = m_nodes[index];
+		return n.leaf ? n.entries.size() : n.children.size();
+	}
+
+	uint32_t rtree::insert_into(uint32_t index, const entry &e)
+	{
+		//Returns the new sibling if the node had to be split.
+		if (m_nodes[index].leaf)
+		{
+			m_nodes[index].entries.push_back(e);
+		}
+		else
+		{
+			auto sibling = insert_into(choose_child(index, e.box), e);
+			if (sibling != no_node)
+			{
+				m_nodes[index].children.push_back(sibling);
+			}
+		}
+
+		if (child_count(index) > max_children)
+		{
+			return split_node(index);
+		}
+
+		refresh_node(index);
+		return no_node;
+	}
+
+	uint32_t rtree::choose_child(uint32_t index, const bounds &box) const
+	{
+		//The child that grows the least, then the smallest child.
+		uint32_t best = no_node;
+		float best_growth = FLT_MAX;
+		float best_area = FLT_MAX;
+
+		for (auto child : m_nodes[index].children)
+		{
+			auto &child_box = m_nodes[child].box;
+			auto child_area = area(child_box);
+			auto growth = area(unite(child_box, box)) - child_area;
+
+			if (growth < best_growth || (growth == best_growth && child_area < best_area))
+			{
+				best = child;
+				best_growth = growth;
+				best_area = child_area;
+			}
+		}
+
+		return best;
+	}
+
+	uint32_t rtree::split_node(uint32_t index)
+	{
+		auto sibling = allocate_node(m_nodes[index].leaf);
+		auto &n = m_nodes[index];
+		auto &s = m_nodes[sibling];
+
+		if (n.leaf)
+		{
+			split_half(n.entries, s.entries, [](const entry &e) -> const bounds & { return e.box; });
+		}
+		else
+		{
+			split_half(n.children, s.children, [this](uint32_t child) -> const bounds & { return m_nodes[child].box; });
+		}
+
+		refresh_node(index);
+		refresh_node(sibling);
+		return sibling;
+	}
+
+	bool rtree::remove_from(uint32_t index, element_id id, const bounds &box, std::vector<entry> &orphans)
+	{
+		if (!covers(m_nodes[index].box, box))
+		{
+			return false;
+		}
+
+		if (m_nodes[index].leaf)
+		{
+			auto &entries = m_nodes[index].entries;
+			auto it = std::find_if(entries.begin(), entries.end(), [id](const entry &e) { return e.id == id; });
+			if (it == entries.end())
+			{
+				return false;
+			}
+
+			*it = entries.back();
+			entries.pop_back();
+			refresh_node(index);
+			return true;
+		}
+
+		auto &children = m_nodes[index].children;
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			auto child = children[i];
+			if (remove_from(child, id, box, orphans))
+			{
+				if (child_count(child) < min_children)
+				{
+					collect_entries(child, orphans);
+					free_subtree(child);
+					children.erase(children.begin() + static_cast<std::ptrdiff_t>(i));
+				}
+
+				refresh_node(index);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void rtree::collect_entries(uint32_t index, std::vector<entry> &results) const
+	{
+		auto &n = m_nodes[index];
+		results.insert(results.end(), n.entries.begin(), n.entries.end());
+		for (auto child : n.children)
+		{
+			collect_entries(child, results);
+		}
+	}
+
+	void rtree::hit_test_node(uint32_t index, float x, float y, const hit_filter &filter, std::optional<entry> &best) const
+	{
+		auto &n = m_nodes[index];
+		if (!n.box.contains(x, y) || (best && n.max_z < best->z))
+		{
+			return;
+		}
+
+		if (n.leaf)
+		{
+			for (auto &e : n.entries)
+			{
+				if (e.box.contains(x, y) && (!best || is_above(e, *best)) && (!filter || filter(e)))
+				{
+					best = e;
+				}
+			}
+			return;
+		}
+
+		//Children with the highest z go first, so the rest can usually be skipped.
+		std::array<uint32_t, max_children + 1> order{};
+		std::copy(n.children.begin(), n.children.end(), order.begin());
+		auto order_end = order.begin() + static_cast<std::ptrdiff_t>(n.children.size());
+		std::sort(order.begin(), order_end, [this](uint32_t a, uint32_t b) { return m_nodes[a].max_z > m_nodes[b].max_z; });
+
+		for (auto it = order.begin(); it != order_end; ++it)
+		{
+			hit_test_node(*it, x, y, filter, best);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+//An R-tree over element bounds for hit testing and visibility queries.
+//This doesn't depend on Windows, bounds are plain floats.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace spatial_index
+{
+	//Left and top are inclusive, right and bottom are exclusive.
+	struct bounds
+	{
+		float left{};
+		float top{};
+		float right{};
+		float bottom{};
+
+		bool intersects(const bounds &) const;
+		bool contains(float, float) const;
+	};
+
+	using element_id = uint32_t;
+
+	//Elements with a higher z are on top, and for equal z the higher id is on top.
+	struct entry
+	{
+		bounds box;
+		element_id id{};
+		int32_t z{};
+	};
+
+	//Refines a bounding box hit, for elements that don't fill their bounds.
+	using hit_filter = std::function<bool(const entry &)>;
+
+	class rtree
+	{
+	public:
+		constexpr static size_t max_children = 16;
+		constexpr static size_t min_children = 6;
+
+		rtree() = default;
+
+		//Replaces the contents with a tree packed using sort tile recursive loading.
+		//This is much faster than inserting one at a time and gives tighter nodes.
+		void bulk_load(std::vector<entry> &&);
+		void insert(const entry &);
+		//The bounds have to be the ones the element was inserted with.
+		bool remove(element_id, const bounds &);
+		bool update(element_id, const bounds &, const entry &);
+		void clear();
+
+		//Results are appended in no particular order.
+		void query_rect(const bounds &, std::vector<entry> &) const;
+		void query_point(float, float, std::vector<entry> &) const;
+		//Returns the topmost element under the point that passes the filter.
+		std::optional<entry> hit_test(float, float, const hit_filter & = {}) const;
+
+		size_t size() const;
+
+	private:
+		rtree(const rtree &) = delete;
+		rtree(rtree &&) = delete;
+		rtree &operator=(const rtree &) = delete;
+		rtree &operator=(rtree &&) = delete;
+
+		constexpr static uint32_t no_node = UINT32_MAX;
+
+		//Leaves hold entries, other nodes hold child node indices.
+		//The highest z in the subtree lets hit testing skip subtrees that can't be on top.
+		struct node
+		{
+			bounds box;
+			int32_t max_z{};
+			bool leaf{};
+			std::vector<entry> entries;
+			std::vector<uint32_t> children;
+		};
+
+		uint32_t allocate_node(bool);
+		void free_subtree(uint32_t);
+		void refresh_node(uint32_t);
+		size_t child_count(uint32_t) const;
+
+		uint32_t insert_into(uint32_t, const entry &);
+		uint32_t choose_child(uint32_t, const bounds &) const;
+		uint32_t split_node(uint32_t);
+		bool remove_from(uint32_t, element_id, const bounds &, std::vector<entry> &);
+		void collect_entries(uint32_t, std::vector<entry> &) const;
+
+		void hit_test_node(uint32_t, float, float, const hit_filter &, std::optional<entry> &) const;
+
+		std::vector<node> m_nodes;
+		std::vector<uint32_t> m_free_nodes;
+		uint32_t m_root = no_node;
+		size_t m_size = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "surface_config.h"
+
+#include "color_convert.h"
+
+namespace surface_config
+{
+	DXGI_FORMAT surface_config::get_dxgi_format() const
+	{
+		return is_linear() ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_B8G8R8A8_UNORM;
+	}
+
+	DXGI_COLOR_SPACE_TYPE surface_config::get_colour_space() const
+	{
+		return is_linear() ? DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709 : DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709;
+	}
+
+	uint32_t surface_config::get_bytes_per_pixel() const
+	{
+		return is_linear() ? 8 : 4;
+	}
+
+	bool surface_config::is_linear() const
+	{
+		return format == surface_format::rgba16f_scrgb;
+	}
+
+	D2D1_COLOR_F surface_config::colour(const D2D1_COLOR_F &srgb) const
+	{
+		//Direct2D takes colours as they are, in the space of the target.
+		if (!is_linear())
+		{
+			return srgb;
+		}
+
+		return D2D1::ColorF(color_convert::srgb_to_linear(srgb.r), color_convert::srgb_to_linear(srgb.g), color_convert::srgb_to_linear(srgb.b), srgb.a);
+	}
+}
\ No newline at end of file
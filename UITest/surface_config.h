@@ -0,0 +1,29 @@
+#pragma once
+
+#include "framework.h"
+
+namespace surface_config
+{
+	enum class surface_format
+	{
+		//8 bit sRGB, the default.
+		bgra8_srgb,
+		//Half float linear scRGB, for HDR and wide gamut displays.
+		rgba16f_scrgb
+	};
+
+	//How the swap chains and the bitmaps drawn into them are set up.
+	//Colours in the code are written as sRGB, and are converted with colour
+	//when the surface is linear.
+	struct surface_config
+	{
+		surface_format format = surface_format::bgra8_srgb;
+
+		DXGI_FORMAT get_dxgi_format() const;
+		DXGI_COLOR_SPACE_TYPE get_colour_space() const;
+		uint32_t get_bytes_per_pixel() const;
+		bool is_linear() const;
+
+		D2D1_COLOR_F colour(const D2D1_COLOR_F &) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "task_executor.h"
+
+#include <algorithm>
+
+namespace task_executor
+{
+	namespace
+	{
+		//Lets submit tell whether it is being called from one of the workers.
+		struct worker_context
+		{
+			const task_executor *owner = nullptr;
+			size_t index = 0;
+		};
+
+		thread_local worker_context s_worker_context;
+	}
+
+	schedule_awaiter::schedule_awaiter(task_executor &executor, task_priority priority) : m_executor{ executor }, m_priority{ priority }
+	{
+	}
+
+	bool schedule_awaiter::await_ready() const noexcept
+	{
+		return false;
+	}
+
+	void schedule_awaiter::await_suspend(std::coroutine_handle<> handle)
+	{
+		m_executor.submit([handle]()
+			{
+				handle.resume();
+			}, m_priority);
+	}
+
+	void schedule_awaiter::await_resume() const noexcept
+	{
+	}
+
+	task_executor::task_executor(unsigned thread_count)
+	{
+		if (thread_count == 0)
+		{
+			thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		//The queues have to exist before any worker starts stealing from them.
+		m_queues.reserve(thread_count + 1);
+		for (unsigned i = 0; i < thread_count + 1; ++i)
+		{
+			m_queues.push_back(std::make_unique<task_queue>());
+		}
+
+		m_threads.reserve(thread_count);
+		for (unsigned i = 0; i < thread_count; ++i)
+		{
+			m_threads.emplace_back([this, i]()
+				{
+					worker(i);
+				});
+		}
+	}
+
+	task_executor::~task_executor()
+	{
+		{
+			std::lock_guard lock(m_sleep_lock);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+
+		for (auto &thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void task_executor::submit(task function, task_priority priority)
+	{
+		auto level = static_cast<size_t>(priority);
+		auto &queue = s_worker_context.owner == this ? *m_queues[s_worker_context.index] : *m_queues.back();
+		{
+			//The counts change with the queue's lock held, so they never go below zero.
+			std::lock_guard lock(queue.lock);
+			queue.tasks[level].push_back(std::move(function));
+			queue.sizes[level].store(queue.tasks[level].size(), std::memory_order_relaxed);
+			m_queued[level].fetch_add(1, std::memory_order_relaxed);
+			m_queued_total.fetch_add(1);
+		}
+		m_submitted.fetch_add(1, std::memory_order_relaxed);
+
+		//A worker increments the sleeping count before checking the queued count,
+		//and this checks them the other way round, so one of the two sees the other.
+		if (m_sleeping.load() != 0)
+		{
+			{
+				std::lock_guard lock(m_sleep_lock);
+			}
+			m_wake.notify_one();
+		}
+	}
+
+	schedule_awaiter task_executor::schedule(task_priority priority)
+	{
+		return { *this, priority };
+	}
+
+	executor_stats task_executor::get_stats() const
+	{
+		executor_stats stats{};
+		stats.submitted = m_submitted.load(std::memory_order_relaxed);
+		stats.executed = m_executed.load(std::memory_order_relaxed);
+		stats.stolen = m_stolen.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < priority_count; ++i)
+		{
+			stats.queued[i] = m_queued[i].load(std::memory_order_relaxed);
+		}
+		stats.worker_count = get_worker_count();
+
+		return stats;
+	}
+
+	unsigned task_executor::get_worker_count() const
+	{
+		return static_cast<unsigned>(m_queues.size() - 1);
+	}
+
+	task_executor &task_executor::get_shared()
+	{
+		static task_executor executor;
+		return executor;
+	}
+
+	bool task_executor::try_take(size_t index, task &function)
+	{
+		auto worker_count = m_queues.size() - 1;
+
+		for (size_t level = 0; level < priority_count; ++level)
+		{
+			if (m_queued[level].load(std::memory_order_relaxed) == 0)
+			{
+				continue;
+			}
+
+			//Our own newest task is the one most likely to still be in the cache.
+			if (try_take_from(*m_queues[index], level, true, function) || try_take_from(*m_queues.back(), level, false, function))
+			{
+				return true;
+			}
+
+			for (size_t i = 1; i < worker_count; ++i)
+			{
+				if (try_take_from(*m_queues[(index + i) % worker_count], level, false, function))
+				{
+					m_stolen.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	bool task_executor::try_take_from(task_queue &queue, size_t level, bool newest, task &function)
+	{
+		if (queue.sizes[level].load(std::memory_order_relaxed) == 0)
+		{
+			return false;
+		}
+
+		std::lock_guard lock(queue.lock);
+		auto &tasks = queue.tasks[level];
+		if (tasks.empty())
+		{
+			return false;
+		}
+
+		if (newest)
+		{
+			function = std::move(tasks.back());
+			tasks.pop_back();
+		}
+		else
+		{
+			function = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		queue.sizes[level].store(tasks.size(), std::memory_order_relaxed);
+		m_queued[level].fetch_sub(1, std::memory_order_relaxed);
+		m_queued_total.fetch_sub(1);
+
+		return true;
+	}
+
+	void task_executor::worker(size_t index)
+	{
+		s_worker_context = { this, index };
+
+		task function;
+		for (;;)
+		{
+			if (try_take(index, function))
+			{
+				function();
+				function = nullptr;
+				m_executed.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			std::unique_lock lock(m_sleep_lock);
+			m_sleeping.fetch_add(1);
+			m_wake.wait(lock, [this]()
+				{
+					return m_stopping || m_queued_total.load() != 0;
+				});
+			m_sleeping.fetch_sub(1);
+
+			//Anything queued before stopping, or by the last tasks, still runs.
+			if (m_stopping && m_queued_total.load() == 0)
+			{
+				return;
+			}
+		}
+	}
+}
\ No newline at end of file
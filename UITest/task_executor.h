@@ -0,0 +1,117 @@
+#pragma once
+
+//A process wide pool for background work such as image decoding, text layout
+//and rasterisation, so those share the cores instead of each owning threads.
+//It doesn't depend on any Windows headers.
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace task_executor
+{
+	//Higher priorities always run first, there is no ageing.
+	enum class task_priority : uint8_t
+	{
+		high,
+		normal,
+		low
+	};
+
+	constexpr size_t priority_count = 3;
+
+	//Tasks must not throw.
+	using task = std::function<void()>;
+
+	struct executor_stats
+	{
+		uint64_t submitted{};
+		uint64_t executed{};
+		//Tasks a worker took from another worker's queue.
+		uint64_t stolen{};
+		//Tasks waiting to run, by priority.
+		std::array<size_t, priority_count> queued{};
+		unsigned worker_count{};
+	};
+
+	class task_executor;
+
+	//co_await resumes the coroutine on one of the executor's threads.
+	class schedule_awaiter
+	{
+	public:
+		schedule_awaiter(task_executor &, task_priority);
+
+		bool await_ready() const noexcept;
+		void await_suspend(std::coroutine_handle<>);
+		void await_resume() const noexcept;
+
+	private:
+		task_executor &m_executor;
+		task_priority m_priority;
+	};
+
+	//Each worker has its own queues. Work submitted from a worker goes to its own
+	//queue and is taken newest first, work submitted from any other thread goes
+	//to a shared queue and is taken oldest first.
+	//A worker with nothing to do steals the oldest task from another worker.
+	class task_executor
+	{
+	public:
+		//A thread count of zero uses one thread per core, less one for the UI.
+		explicit task_executor(unsigned = 0);
+		//Tasks that are already queued still run.
+		~task_executor();
+
+		void submit(task, task_priority = task_priority::normal);
+		schedule_awaiter schedule(task_priority = task_priority::normal);
+
+		executor_stats get_stats() const;
+		unsigned get_worker_count() const;
+
+		//Shared by everything in the process.
+		static task_executor &get_shared();
+
+	private:
+		task_executor(const task_executor &) = delete;
+		task_executor(task_executor &&) = delete;
+		task_executor &operator=(const task_executor &) = delete;
+		task_executor &operator=(task_executor &&) = delete;
+
+		struct task_queue
+		{
+			std::mutex lock;
+			std::array<std::deque<task>, priority_count> tasks;
+			//Lets an empty queue be skipped without taking its lock.
+			std::array<std::atomic<size_t>, priority_count> sizes{};
+		};
+
+		bool try_take(size_t, task &);
+		bool try_take_from(task_queue &, size_t, bool, task &);
+		void worker(size_t);
+
+		//One per worker, then the shared queue last.
+		std::vector<std::unique_ptr<task_queue>> m_queues;
+
+		std::array<std::atomic<size_t>, priority_count> m_queued{};
+		std::atomic<size_t> m_queued_total{};
+		std::atomic<uint64_t> m_submitted{};
+		std::atomic<uint64_t> m_executed{};
+		std::atomic<uint64_t> m_stolen{};
+
+		std::mutex m_sleep_lock;
+		std::condition_variable m_wake;
+		std::atomic<unsigned> m_sleeping{};
+		bool m_stopping = false;
+
+		std::vector<std::thread> m_threads;
+	};
+}
\ No newline at end of file
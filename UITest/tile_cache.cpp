@@ -0,0 +1,74 @@
+#include "tile_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tiled_canvas
+{
+	size_t tile_key_hash::operator()(const tile_key &key) const noexcept
+	{
+		uint64_t hash = static_cast<uint32_t>(key.x);
+		hash = hash * 0x9e3779b97f4a7c15ull ^ static_cast<uint32_t>(key.y);
+		hash = hash * 0x9e3779b97f4a7c15ull ^ static_cast<uint32_t>(key.level);
+		return static_cast<size_t>(hash ^ (hash >> 32));
+	}
+
+	tile_plan plan_tiles(const view_rect &view, int32_t level, int32_t tile_size, int32_t column_count, int32_t row_count, double motion_x, double motion_y, int32_t prefetch_depth)
+	{
+		tile_plan plan;
+
+		auto first_column = std::max(static_cast<int32_t>(std::floor(view.left / tile_size)), 0);
+		auto first_row = std::max(static_cast<int32_t>(std::floor(view.top / tile_size)), 0);
+		auto last_column = std::min(static_cast<int32_t>(std::ceil(view.right / tile_size)), column_count) - 1;
+		auto last_row = std::min(static_cast<int32_t>(std::ceil(view.bottom / tile_size)), row_count) - 1;
+
+		if (first_column > last_column || first_row > last_row)
+		{
+			return plan;
+		}
+
+		for (int32_t y = first_row; y <= last_row; ++y)
+		{
+			for (int32_t x = first_column; x <= last_column; ++x)
+			{
+				plan.visible.push_back({ level, x, y });
+			}
+		}
+
+		//Columns and rows just outside the viewport, in the direction things are moving.
+		//When moving diagonally the corner tiles are included with the columns.
+		int32_t step_x = motion_x > 0 ? 1 : motion_x < 0 ? -1 : 0;
+		int32_t step_y = motion_y > 0 ? 1 : motion_y < 0 ? -1 : 0;
+		int32_t extra_first_row = step_y < 0 ? first_row - prefetch_depth : first_row;
+		int32_t extra_last_row = step_y > 0 ? last_row + prefetch_depth : last_row;
+
+		for (int32_t depth = 1; depth <= prefetch_depth; ++depth)
+		{
+			if (step_x != 0)
+			{
+				int32_t x = step_x > 0 ? last_column + depth : first_column - depth;
+				if (x >= 0 && x < column_count)
+				{
+					for (int32_t y = std::max(extra_first_row, 0); y <= std::min(extra_last_row, row_count - 1); ++y)
+					{
+						plan.prefetch.push_back({ level, x, y });
+					}
+				}
+			}
+
+			if (step_y != 0)
+			{
+				int32_t y = step_y > 0 ? last_row + depth : first_row - depth;
+				if (y >= 0 && y < row_count)
+				{
+					for (int32_t x = first_column; x <= last_column; ++x)
+					{
+						plan.prefetch.push_back({ level, x, y });
+					}
+				}
+			}
+		}
+
+		return plan;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+//Tile bookkeeping for the virtual canvas.
+//None of this depends on Windows, the tiles themselves are whatever the pool is given.
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tiled_canvas
+{
+	struct tile_key
+	{
+		int32_t level{};
+		int32_t x{};
+		int32_t y{};
+
+		bool operator==(const tile_key &) const = default;
+	};
+
+	struct tile_key_hash
+	{
+		size_t operator()(const tile_key &) const noexcept;
+	};
+
+	//A viewport in the pixel space of one zoom level.
+	struct view_rect
+	{
+		double left{};
+		double top{};
+		double right{};
+		double bottom{};
+	};
+
+	struct tile_plan
+	{
+		std::vector<tile_key> visible;
+		//Tiles just past the viewport in the direction of motion, nearest first.
+		std::vector<tile_key> prefetch;
+	};
+
+	//Works out which tiles cover the viewport and which are worth rasterising ahead of time.
+	//Tiles outside of [0, column_count) x [0, row_count) don't exist.
+	tile_plan plan_tiles(const view_rect &, int32_t level, int32_t tile_size, int32_t column_count, int32_t row_count, double motion_x, double motion_y, int32_t prefetch_depth);
+
+	//A least recently used pool of tiles bounded by memory use.
+	//Tiles used since the last begin_frame are never evicted, so the visible
+	//set can go over the cap rather than flicker.
+	template <typename T>
+	class tile_pool
+	{
+	public:
+		explicit tile_pool(size_t capacity_bytes) : m_capacity_bytes{ capacity_bytes }
+		{
+		}
+
+		void begin_frame()
+		{
+			++m_frame;
+		}
+
+		T *find(const tile_key &key)
+		{
+			auto it = m_index.find(key);
+			if (it == m_index.end())
+			{
+				++m_misses;
+				return nullptr;
+			}
+
+			++m_hits;
+			it->second->last_frame = m_frame;
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			return &it->second->tile;
+		}
+
+		bool contains(const tile_key &key) const
+		{
+			return m_index.find(key) != m_index.end();
+		}
+
+		//Used to check whether a new tile would go over the cap.
+		bool has_room(size_t size_bytes) const
+		{
+			return m_size_bytes + size_bytes <= m_capacity_bytes;
+		}
+
+		//Removes the least recently used tile if it wasn't used this frame,
+		//so its storage can be used for a new tile.
+		bool evict_one(T &tile)
+		{
+			if (m_entries.empty() || m_entries.back().last_frame == m_frame)
+			{
+				return false;
+			}
+
+			auto &last = m_entries.back();
+			tile = std::move(last.tile);
+			m_size_bytes -= last.size_bytes;
+			m_index.erase(last.key);
+			m_entries.pop_back();
+			++m_evictions;
+			return true;
+		}
+
+		T &insert(const tile_key &key, T &&tile, size_t size_bytes)
+		{
+			auto it = m_index.find(key);
+			if (it != m_index.end())
+			{
+				m_size_bytes -= it->second->size_bytes;
+				m_entries.erase(it->second);
+				m_index.erase(it);
+			}
+
+			m_entries.push_front({ key, std::move(tile), size_bytes, m_frame });
+			m_index.emplace(key, m_entries.begin());
+			m_size_bytes += size_bytes;
+
+			T discarded{};
+			while (m_size_bytes > m_capacity_bytes && evict_one(discarded))
+			{
+			}
+
+			return m_entries.front().tile;
+		}
+
+		void clear()
+		{
+			m_index.clear();
+			m_entries.clear();
+			m_size_bytes = 0;
+		}
+
+		size_t size_bytes() const
+		{
+			return m_size_bytes;
+		}
+
+		size_t tile_count() const
+		{
+			return m_entries.size();
+		}
+
+		uint64_t hit_count() const
+		{
+			return m_hits;
+		}
+
+		uint64_t miss_count() const
+		{
+			return m_misses;
+		}
+
+		uint64_t eviction_count() const
+		{
+			return m_evictions;
+		}
+
+	private:
+		struct entry
+		{
+			tile_key key;
+			T tile;
+			size_t size_bytes;
+			uint64_t last_frame;
+		};
+
+		std::list<entry> m_entries;
+		std::unordered_map<tile_key, typename std::list<entry>::iterator, tile_key_hash> m_index;
+		size_t m_capacity_bytes;
+		size_t m_size_bytes = 0;
+		uint64_t m_frame = 0;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		uint64_t m_evictions = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "tiled_canvas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace tiled_canvas
+{
+	namespace
+	{
+		//How far ahead of the viewport to go, and how many of those tiles to rasterise per frame.
+		constexpr int32_t prefetch_depth = 1;
+		constexpr size_t prefetch_per_frame = 2;
+	}
+
+	tiled_canvas::tiled_canvas(const D2D1_SIZE_F &canvas_size, content_function content, size_t capacity_bytes) : m_canvas_size{ canvas_size }, m_content{ std::move(content) }, m_pool{ capacity_bytes }
+	{
+		_ASSERTE(m_content);
+		if (!m_content)
+		{
+			__fastfail(FAST_FAIL_INVALID_ARG);
+		}
+	}
+
+	void tiled_canvas::init_device_dependent_resources(ID2D1DeviceContext *device_context, const surface_config::surface_config &surface)
+	{
+		using namespace winrt;
+
+		com_ptr<ID2D1SolidColorBrush> content_brush;
+		check_hresult(device_context->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), content_brush.put()));
+
+		m_device_context.copy_from(device_context);
+		m_content_brush = content_brush;
+		m_tile_format = surface.get_dxgi_format();
+		m_tile_bytes = static_cast<size_t>(tile_size) * tile_size * surface.get_bytes_per_pixel();
+		m_changed = true;
+	}
+
+	void tiled_canvas::cleanup_device_dependent_resources()
+	{
+		m_visible.clear();
+		m_pool.clear();
+		m_content_brush = nullptr;
+		m_device_context = nullptr;
+	}
+
+	void tiled_canvas::set_viewport_size(const D2D1_SIZE_F &size)
+	{
+		if (size.width == m_viewport_size.width && size.height == m_viewport_size.height)
+		{
+			return;
+		}
+
+		m_viewport_size = size;
+		clamp_scroll();
+		m_changed = true;
+	}
+
+	void tiled_canvas::scroll(float x, float y)
+	{
+		auto previous = m_scroll;
+		m_scroll.x += x;
+		m_scroll.y += y;
+		clamp_scroll();
+
+		if (m_scroll.x != previous.x || m_scroll.y != previous.y)
+		{
+			m_motion = D2D1::Point2F(m_scroll.x - previous.x, m_scroll.y - previous.y);
+			m_changed = true;
+		}
+	}
+
+	void tiled_canvas::zoom(int32_t steps, const D2D1_POINT_2F &anchor)
+	{
+		auto level = std::clamp(m_level + steps, min_level, max_level);
+		if (level == m_level)
+		{
+			return;
+		}
+
+		auto ratio = level_scale(level) / level_scale(m_level);
+		m_scroll.x = (m_scroll.x + anchor.x) * ratio - anchor.x;
+		m_scroll.y = (m_scroll.y + anchor.y) * ratio - anchor.y;
+		m_level = level;
+		clamp_scroll();
+
+		//Tiles from the old level are left to age out of the pool.
+		m_motion = {};
+		m_changed = true;
+	}
+
+	void tiled_canvas::update()
+	{
+		using namespace winrt;
+
+		if (!m_device_context)
+		{
+			return;
+		}
+
+		m_pool.begin_frame();
+
+		auto extent = level_extent(m_level);
+		auto column_count = static_cast<int32_t>(std::ceil(extent.width / tile_size));
+		auto row_count = static_cast<int32_t>(std::ceil(extent.height / tile_size));
+		view_rect view{ std::floor(m_scroll.x), std::floor(m_scroll.y), std::floor(m_scroll.x) + m_viewport_size.width, std::floor(m_scroll.y) + m_viewport_size.height };
+		auto plan = plan_tiles(view, m_level, tile_size, column_count, row_count, m_motion.x, m_motion.y, prefetch_depth);
+
+		com_ptr<ID2D1Image> previous_target;
+		m_device_context->GetTarget(previous_target.put());
+
+		//Every visible tile is drawn this frame, even if that takes the pool over its cap.
+		m_visible.clear();
+		for (auto &key : plan.visible)
+		{
+			com_ptr<ID2D1Bitmap1> bitmap;
+			if (auto tile = m_pool.find(key))
+			{
+				bitmap = *tile;
+			}
+			else
+			{
+				bitmap = rasterize_tile(key, acquire_bitmap(true));
+				m_changed = true;
+			}
+
+			m_visible.push_back({ key, std::move(bitmap) });
+		}
+
+		size_t prefetch_budget = prefetch_per_frame;
+		for (auto &key : plan.prefetch)
+		{
+			if (prefetch_budget == 0)
+			{
+				break;
+			}
+			if (m_pool.contains(key))
+			{
+				continue;
+			}
+
+			auto bitmap = acquire_bitmap(false);
+			if (!bitmap)
+			{
+				break;
+			}
+			rasterize_tile(key, std::move(bitmap));
+			--prefetch_budget;
+		}
+
+		m_device_context->SetTarget(previous_target.get());
+	}
+
+	void tiled_canvas::draw(ID2D1DeviceContext *device_context) const
+	{
+		//Edge tiles are cropped to the canvas, so nothing past the edge is drawn.
+		auto extent = level_extent(m_level);
+		float scroll_x = std::floor(m_scroll.x);
+		float scroll_y = std::floor(m_scroll.y);
+
+		for (auto &tile : m_visible)
+		{
+			float tile_left = static_cast<float>(tile.key.x * tile_size);
+			float tile_top = static_cast<float>(tile.key.y * tile_size);
+			float width = std::min(static_cast<float>(tile_size), extent.width - tile_left);
+			float height = std::min(static_cast<float>(tile_size), extent.height - tile_top);
+
+			auto destination = D2D1::RectF(tile_left - scroll_x, tile_top - scroll_y, tile_left - scroll_x + width, tile_top - scroll_y + height);
+			auto source = D2D1::RectF(0.f, 0.f, width, height);
+			device_context->DrawBitmap(tile.bitmap.get(), &destination, 1.f, D2D1_INTERPOLATION_MODE_NEAREST_NEIGHBOR, &source);
+		}
+	}
+
+	D2D1_MATRIX_3X2_F tiled_canvas::get_transform() const
+	{
+		auto scale = level_scale(m_level);
+		return D2D1::Matrix3x2F::Scale(scale, scale) * D2D1::Matrix3x2F::Translation(-std::floor(m_scroll.x), -std::floor(m_scroll.y));
+	}
+
+	D2D1_POINT_2F tiled_canvas::window_to_canvas(const D2D1_POINT_2F &point) const
+	{
+		auto scale = level_scale(m_level);
+		return D2D1::Point2F((point.x + std::floor(m_scroll.x)) / scale, (point.y + std::floor(m_scroll.y)) / scale);
+	}
+
+	bool tiled_canvas::take_changed()
+	{
+		return std::exchange(m_changed, false);
+	}
+
+	canvas_stats tiled_canvas::get_stats() const
+	{
+		return { m_pool.hit_count(), m_pool.miss_count(), m_pool.eviction_count(), m_pool.tile_count(), m_pool.size_bytes() };
+	}
+
+	float tiled_canvas::level_scale(int32_t level)
+	{
+		return std::exp2(static_cast<float>(level) * 0.5f);
+	}
+
+	D2D1_SIZE_F tiled_canvas::level_extent(int32_t level) const
+	{
+		auto scale = level_scale(level);
+		return D2D1::SizeF(std::ceil(m_canvas_size.width * scale), std::ceil(m_canvas_size.height * scale));
+	}
+
+	void tiled_canvas::clamp_scroll()
+	{
+		auto extent = level_extent(m_level);
+		m_scroll.x = std::clamp(m_scroll.x, 0.f, std::max(extent.width - m_viewport_size.width, 0.f));
+		m_scroll.y = std::clamp(m_scroll.y, 0.f, std::max(extent.height - m_viewport_size.height, 0.f));
+	}
+
+	winrt::com_ptr<ID2D1Bitmap1> tiled_canvas::acquire_bitmap(bool required)
+	{
+		using namespace winrt;
+
+		//Evicted tiles are reused rather than creating a new bitmap each time.
+		com_ptr<ID2D1Bitmap1> bitmap;
+		if (!m_pool.has_room(m_tile_bytes))
+		{
+			if (m_pool.evict_one(bitmap))
+			{
+				return bitmap;
+			}
+			if (!required)
+			{
+				return nullptr;
+			}
+		}
+
+		auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_TARGET, D2D1::PixelFormat(m_tile_format, D2D1_ALPHA_MODE_PREMULTIPLIED));
+		check_hresult(m_device_context->CreateBitmap(D2D1::SizeU(tile_size, tile_size), nullptr, 0, bps, bitmap.put()));
+
+		return bitmap;
+	}
+
+	winrt::com_ptr<ID2D1Bitmap1> tiled_canvas::rasterize_tile(const tile_key &key, winrt::com_ptr<ID2D1Bitmap1> &&bitmap)
+	{
+		using namespace winrt;
+
+		auto scale = level_scale(key.level);
+		float tile_left = static_cast<float>(key.x * tile_size);
+		float tile_top = static_cast<float>(key.y * tile_size);
+		auto bounds = D2D1::RectF(tile_left / scale, tile_top / scale, std::min((tile_left + tile_size) / scale, m_canvas_size.width), std::min((tile_top + tile_size) / scale, m_canvas_size.height));
+
+		m_device_context->SetTarget(bitmap.get());
+		m_device_context->BeginDraw();
+		m_device_context->Clear(D2D1::ColorF(D2D1::ColorF::White));
+		m_device_context->SetTransform(D2D1::Matrix3x2F::Scale(scale, scale) * D2D1::Matrix3x2F::Translation(-tile_left, -tile_top));
+		m_content(m_device_context.get(), m_content_brush.get(), bounds);
+		m_device_context->SetTransform(D2D1::Matrix3x2F::Identity());
+		check_hresult(m_device_context->EndDraw());
+
+		return m_pool.insert(key, std::move(bitmap), m_tile_bytes);
+	}
+}
\ No newline at end of file
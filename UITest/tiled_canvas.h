@@ -0,0 +1,100 @@
+#pragma once
+
+#include "framework.h"
+#include "surface_config.h"
+#include "tile_cache.h"
+
+#include <functional>
+#include <vector>
+
+namespace tiled_canvas
+{
+	//Draws the part of the canvas inside the rectangle, in canvas coordinates.
+	//The transform for the tile is already set, and the brush can be recoloured freely.
+	using content_function = std::function<void(ID2D1DeviceContext *, ID2D1SolidColorBrush *, const D2D1_RECT_F &)>;
+
+	struct canvas_stats
+	{
+		uint64_t hits{};
+		uint64_t misses{};
+		uint64_t evictions{};
+		size_t tiles_resident{};
+		size_t size_bytes{};
+	};
+
+	//A canvas much larger than the window, drawn from tiles that are rasterised on demand.
+	//Tiles are kept in a pool bounded by memory, and the tiles just past the edge of
+	//the window in the direction of scrolling are rasterised a few at a time ahead of
+	//being needed.
+	//Zoom levels are discrete, so tiles are always drawn at one pixel per pixel.
+	class tiled_canvas
+	{
+	public:
+		constexpr static int32_t tile_size = 256;
+		constexpr static int32_t min_level = -4;
+		constexpr static int32_t max_level = 4;
+		constexpr static size_t default_capacity_bytes = 96 * 1024 * 1024;
+
+		tiled_canvas(const D2D1_SIZE_F &, content_function, size_t = default_capacity_bytes);
+
+		//Tiles use the same pixel format as the surface they are drawn into.
+		void init_device_dependent_resources(ID2D1DeviceContext *, const surface_config::surface_config &);
+		void cleanup_device_dependent_resources();
+
+		void set_viewport_size(const D2D1_SIZE_F &);
+		//The distances are in window pixels.
+		void scroll(float, float);
+		//Two steps double the scale, the canvas point under the anchor stays where it is.
+		void zoom(int32_t, const D2D1_POINT_2F &);
+
+		//Rasterises the tiles that the next draw needs.
+		//This must be called outside of BeginDraw and EndDraw,
+		//the target of the device context is restored afterwards.
+		void update();
+		void draw(ID2D1DeviceContext *) const;
+
+		//Maps canvas coordinates to window pixels as of the last update.
+		D2D1_MATRIX_3X2_F get_transform() const;
+		D2D1_POINT_2F window_to_canvas(const D2D1_POINT_2F &) const;
+
+		//Returns true once after anything that changes what draw produces.
+		bool take_changed();
+
+		canvas_stats get_stats() const;
+
+	private:
+		tiled_canvas(const tiled_canvas &) = delete;
+		tiled_canvas(tiled_canvas &&) = delete;
+		tiled_canvas &operator=(const tiled_canvas &) = delete;
+		tiled_canvas &operator=(tiled_canvas &&) = delete;
+
+		struct visible_tile
+		{
+			tile_key key;
+			winrt::com_ptr<ID2D1Bitmap1> bitmap;
+		};
+
+		static float level_scale(int32_t);
+		D2D1_SIZE_F level_extent(int32_t) const;
+		void clamp_scroll();
+		//When the tile isn't needed for this frame, this only succeeds if the pool has room.
+		winrt::com_ptr<ID2D1Bitmap1> acquire_bitmap(bool);
+		winrt::com_ptr<ID2D1Bitmap1> rasterize_tile(const tile_key &, winrt::com_ptr<ID2D1Bitmap1> &&);
+
+		D2D1_SIZE_F m_canvas_size;
+		content_function m_content;
+		tile_pool<winrt::com_ptr<ID2D1Bitmap1>> m_pool;
+
+		winrt::com_ptr<ID2D1DeviceContext> m_device_context;
+		winrt::com_ptr<ID2D1SolidColorBrush> m_content_brush;
+		DXGI_FORMAT m_tile_format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		size_t m_tile_bytes{};
+
+		std::vector<visible_tile> m_visible;
+		D2D1_SIZE_F m_viewport_size{};
+		D2D1_POINT_2F m_scroll{};
+		D2D1_POINT_2F m_motion{};
+		int32_t m_level = 0;
+		bool m_changed = true;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,434 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace timer_wheel
+{
+	namespace
+	{
+		uint64_t coalescing_granularity(uint64_t tolerance)
+		{
+			return tolerance == 0 ? 1 : std::bit_floor(tolerance);
+		}
+
+		uint64_t round_up(uint64_t value, uint64_t granularity)
+		{
+			return (value + granularity - 1) & ~(granularity - 1);
+		}
+	}
+
+	timer_wheel::timer_wheel(uint64_t now) : m_now{ now }
+	{
+		m_heads.fill(no_timer);
+	}
+
+	timer_id timer_wheel::schedule(uint64_t deadline, uint64_t tolerance, uint64_t period, callback function)
+	{
+		auto index = allocate_node();
+		auto &node = m_nodes[index];
+		node.function = std::move(function);
+		node.nominal = deadline;
+		node.period = period;
+		node.granularity = coalescing_granularity(tolerance);
+		node.deadline = std::max(round_up(node.nominal, node.granularity), m_now + 1);
+
+		place(index);
+		++m_size;
+
+		return { index, node.generation };
+	}
+
+	bool timer_wheel::cancel(timer_id id)
+	{
+		if (!is_live(id))
+		{
+			return false;
+		}
+
+		if (!m_nodes[id.index].due)
+		{
+			unlink(id.index);
+		}
+		free_node(id.index);
+		--m_size;
+
+		return true;
+	}
+
+	void timer_wheel::advance(uint64_t target, std::vector<timer_id> &due)
+	{
+		//Jumps from one occupied slot to the next rather than stepping through every tick.
+		for (auto next = next_event(); next && *next <= target; next = next_event())
+		{
+			m_now = *next;
+
+			//Higher levels go first, since their timers can land in the lower level slot
+			//that is being emptied at the same tick.
+			if ((m_now & 0xffffffff) == 0)
+			{
+				relink_list(overflow_list);
+			}
+			for (uint32_t level = level_count - 1; level > 0; --level)
+			{
+				auto shift = level * slot_bits;
+				if ((m_now & ((uint64_t{ 1 } << shift) - 1)) == 0)
+				{
+					relink_list(level * slot_count + static_cast<uint32_t>((m_now >> shift) & (slot_count - 1)));
+				}
+			}
+
+			auto list = static_cast<uint32_t>(m_now & (slot_count - 1));
+			while (m_heads[list] != no_timer)
+			{
+				auto index = m_heads[list];
+				unlink(index);
+				m_nodes[index].due = true;
+				due.push_back({ index, m_nodes[index].generation });
+			}
+		}
+
+		m_now = std::max(m_now, target);
+	}
+
+	callback timer_wheel::take_callback(timer_id id)
+	{
+		if (!is_live(id) || !m_nodes[id.index].due)
+		{
+			return {};
+		}
+
+		auto &node = m_nodes[id.index];
+		node.due = false;
+
+		if (node.period == 0)
+		{
+			auto function = std::move(node.function);
+			free_node(id.index);
+			--m_size;
+			return function;
+		}
+
+		//Periods that were missed entirely are skipped rather than fired late.
+		node.nominal += node.period;
+		if (node.nominal <= m_now)
+		{
+			node.nominal += ((m_now - node.nominal) / node.period + 1) * node.period;
+		}
+		node.deadline = std::max(round_up(node.nominal, node.granularity), m_now + 1);
+		place(id.index);
+
+		return node.function;
+	}
+
+	size_t timer_wheel::run_until(uint64_t target)
+	{
+		std::vector<timer_id> due;
+		advance(target, due);
+
+		size_t count = 0;
+		for (auto id : due)
+		{
+			if (auto function = take_callback(id))
+			{
+				function();
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	std::optional<uint64_t> timer_wheel::next_event() const
+	{
+		//Slots at or before the current position of their level are always empty,
+		//anything due then has already fired or moved down a level.
+		std::optional<uint64_t> next;
+		for (uint32_t level = 0; level < level_count; ++level)
+		{
+			auto shift = level * slot_bits;
+			auto current = static_cast<uint32_t>((m_now >> shift) & (slot_count - 1));
+			if (auto slot = next_occupied_slot(level, current + 1))
+			{
+				auto block = m_now >> (shift + slot_bits) << (shift + slot_bits);
+				auto tick = block | (uint64_t{ *slot } << shift);
+				next = next ? std::min(*next, tick) : tick;
+			}
+		}
+
+		if (m_heads[overflow_list] != no_timer)
+		{
+			auto tick = ((m_now >> 32) + 1) << 32;
+			next = next ? std::min(*next, tick) : tick;
+		}
+
+		return next;
+	}
+
+	uint64_t timer_wheel::now() const
+	{
+		return m_now;
+	}
+
+	size_t timer_wheel::size() const
+	{
+		return m_size;
+	}
+
+	uint32_t timer_wheel::allocate_node()
+	{
+		uint32_t index;
+		if (!m_free_nodes.empty())
+		{
+			index = m_free_nodes.back();
+			m_free_nodes.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.emplace_back();
+		}
+
+		m_nodes[index].in_use = true;
+		return index;
+	}
+
+	void timer_wheel::free_node(uint32_t index)
+	{
+		auto &node = m_nodes[index];
+		node.function = nullptr;
+		node.in_use = false;
+		node.due = false;
+		++node.generation;
+		m_free_nodes.push_back(index);
+	}
+
+	bool timer_wheel::is_live(timer_id id) const
+	{
+		return id.index < m_nodes.size() && m_nodes[id.index].in_use && m_nodes[id.index].generation == id.generation;
+	}
+
+	void timer_wheel::place(uint32_t index)
+	{
+		//The level is the highest group of bits where the deadline and now differ,
+		//so a timer moves down a level each time now reaches the start of its slot.
+		auto deadline = m_nodes[index].deadline;
+		auto difference = deadline ^ m_now;
+		auto level = difference < slot_count ? 0 : static_cast<uint32_t>(std::bit_width(difference) - 1) / slot_bits;
+
+		if (level >= level_count)
+		{
+			link(index, overflow_list);
+			return;
+		}
+
+		auto slot = static_cast<uint32_t>(deadline >> (level * slot_bits)) & (slot_count - 1);
+		link(index, level * slot_count + slot);
+	}
+
+	void timer_wheel::link(uint32_t index, uint32_t list)
+	{
+		auto &node = m_nodes[index];
+		node.list = list;
+		node.previous = no_timer;
+		node.next = m_heads[list];
+		if (node.next != no_timer)
+		{
+			m_nodes[node.next].previous = index;
+		}
+		m_heads[list] = index;
+
+		if (list < overflow_list)
+		{
+			auto slot = list % slot_count;
+			m_occupied[list / slot_count][slot / 64] |= uint64_t{ 1 } << (slot % 64);
+		}
+	}
+
+	void timer_wheel::unlink(uint32_t index)
+	{
+		auto &node = m_nodes[index];
+		auto list = node.list;
+
+		if (node.previous != no_timer)
+		{
+			m_nodes[node.previous].next = node.next;
+		}
+		else
+		{
+			m_heads[list] = node.next;
+		}
+		if (node.next != no_timer)
+		{
+			m_nodes[node.next].previous = node.previous;
+		}
+
+		if (m_heads[list] == no_timer && list < overflow_list)
+		{
+			auto slot = list % slot_count;
+			m_occupied[list / slot_count][slot / 64] &= ~(uint64_t{ 1 } << (slot % 64));
+		}
+
+		node.previous = no_timer;
+		node.next = no_timer;
+		node.list = unlinked;
+	}
+
+	void timer_wheel::relink_list(uint32_t list)
+	{
+		//The list is detached first, overflow timers that are still out of range go back into it.
+		std::vector<uint32_t> indices;
+		for (auto index = m_heads[list]; index != no_timer; index = m_nodes[index].next)
+		{
+			indices.push_back(index);
+		}
+
+		for (auto index : indices)
+		{
+			unlink(index);
+			place(index);
+		}
+	}
+
+	std::optional<uint32_t> timer_wheel::next_occupied_slot(uint32_t level, uint32_t first) const
+	{
+		for (auto word = first / 64; word < bitmap_words; ++word)
+		{
+			auto bits = m_occupied[level][word];
+			if (word == first / 64)
+			{
+				bits &= ~uint64_t{ 0 } << (first % 64);
+			}
+			if (bits != 0)
+			{
+				return word * 64 + static_cast<uint32_t>(std::countr_zero(bits));
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	uint64_t steady_clock::now() const
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	timer_service::timer_service(std::unique_ptr<clock> source) : m_clock{ std::move(source) }, m_wheel{ m_clock->now() }
+	{
+		m_thread = std::thread{ [this] { worker(); } };
+	}
+
+	timer_service::~timer_service()
+	{
+		{
+			std::lock_guard lock(m_lock);
+			m_stopping = true;
+		}
+		m_wake.notify_one();
+
+		m_thread.join();
+	}
+
+	timer_id timer_service::schedule_after(std::chrono::microseconds delay, callback function, std::chrono::microseconds tolerance)
+	{
+		return schedule(m_clock->now() + static_cast<uint64_t>(delay.count()), static_cast<uint64_t>(tolerance.count()), 0, std::move(function));
+	}
+
+	timer_id timer_service::schedule_every(std::chrono::microseconds period, callback function, std::chrono::microseconds tolerance)
+	{
+		return schedule(m_clock->now() + static_cast<uint64_t>(period.count()), static_cast<uint64_t>(tolerance.count()), static_cast<uint64_t>(period.count()), std::move(function));
+	}
+
+	bool timer_service::cancel(timer_id id)
+	{
+		//The default id never names a timer, and it is also what m_running holds
+		//while no callback runs, so waiting on it would never finish.
+		if (id == timer_id{})
+		{
+			return false;
+		}
+
+		std::unique_lock lock(m_lock);
+		bool cancelled = m_wheel.cancel(id);
+
+		//Only a callback that is running right now needs waiting for, a one shot
+		//timer has already left the wheel by then.
+		if (m_running == id && std::this_thread::get_id() != m_thread.get_id())
+		{
+			m_callback_done.wait(lock, [this, id] { return m_running != id; });
+		}
+
+		return cancelled;
+	}
+
+	timer_service &timer_service::get_shared()
+	{
+		static timer_service service;
+		return service;
+	}
+
+	timer_id timer_service::schedule(uint64_t deadline, uint64_t tolerance, uint64_t period, callback function)
+	{
+		timer_id id;
+		bool wake = false;
+		{
+			std::lock_guard lock(m_lock);
+			id = m_wheel.schedule(deadline, tolerance, period, std::move(function));
+
+			//The thread only needs waking if this is now the earliest deadline.
+			auto next = m_wheel.next_event();
+			wake = !m_sleep_until || (next && *next < *m_sleep_until);
+		}
+
+		if (wake)
+		{
+			m_wake.notify_one();
+		}
+
+		return id;
+	}
+
+	void timer_service::worker()
+	{
+		std::unique_lock lock(m_lock);
+		std::vector<timer_id> due;
+
+		while (!m_stopping)
+		{
+			due.clear();
+			m_wheel.advance(m_clock->now(), due);
+
+			//The lock is dropped while a callback runs, so it can schedule and cancel timers.
+			for (auto id : due)
+			{
+				auto function = m_wheel.take_callback(id);
+				if (!function)
+				{
+					continue;
+				}
+
+				m_running = id;
+				lock.unlock();
+				function();
+				lock.lock();
+				m_running = {};
+				m_callback_done.notify_all();
+			}
+
+			if (m_stopping)
+			{
+				break;
+			}
+
+			m_sleep_until = m_wheel.next_event();
+			if (!m_sleep_until)
+			{
+				m_wake.wait(lock);
+			}
+			else if (auto now = m_clock->now(); *m_sleep_until > now)
+			{
+				m_wake.wait_for(lock, std::chrono::microseconds{ *m_sleep_until - now });
+			}
+		}
+	}
+}
\ No newline at end of file
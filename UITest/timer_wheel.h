@@ -0,0 +1,165 @@
+#pragma once
+
+//A hierarchical timer wheel, and a service that runs one on a shared thread.
+//None of this depends on Windows.
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace timer_wheel
+{
+	using callback = std::function<void()>;
+
+	//The generation stops an old id from cancelling a timer that reused its slot.
+	struct timer_id
+	{
+		uint32_t index = UINT32_MAX;
+		uint32_t generation{};
+
+		bool operator==(const timer_id &) const = default;
+	};
+
+	//Four levels of 256 slots cover 2^32 ticks, later deadlines wait in an overflow
+	//list until they come into range.
+	//Scheduling and cancelling are constant time, and advancing only visits occupied
+	//slots, so a long gap between advances costs nothing.
+	//The wheel isn't synchronised and the unit of a tick is up to the caller.
+	class timer_wheel
+	{
+	public:
+		constexpr static uint32_t slot_bits = 8;
+		constexpr static uint32_t slot_count = 1 << slot_bits;
+		constexpr static uint32_t level_count = 4;
+
+		explicit timer_wheel(uint64_t = 0);
+
+		//The timer fires somewhere between the deadline and the deadline plus the tolerance.
+		//Deadlines are rounded up to a power of two no larger than the tolerance, so timers
+		//with nearby deadlines end up in the same slot and fire together.
+		//A period of zero fires once, deadlines that have passed fire on the next advance.
+		timer_id schedule(uint64_t, uint64_t, uint64_t, callback);
+		bool cancel(timer_id);
+
+		//Moves time forward and appends the timers that are now due.
+		//Their callbacks are collected with take_callback, so a callback can cancel
+		//timers that are due in the same batch.
+		void advance(uint64_t, std::vector<timer_id> &);
+		//Returns an empty function for a timer cancelled since it became due.
+		//Periodic timers are scheduled again before this returns.
+		callback take_callback(timer_id);
+		//Advances and runs the due callbacks on this thread, returns how many ran.
+		size_t run_until(uint64_t);
+
+		//The next tick advance has work to do, either firing or moving timers down a level.
+		std::optional<uint64_t> next_event() const;
+		uint64_t now() const;
+		size_t size() const;
+
+	private:
+		timer_wheel(const timer_wheel &) = delete;
+		timer_wheel(timer_wheel &&) = delete;
+		timer_wheel &operator=(const timer_wheel &) = delete;
+		timer_wheel &operator=(timer_wheel &&) = delete;
+
+		constexpr static uint32_t no_timer = UINT32_MAX;
+		constexpr static uint32_t overflow_list = level_count * slot_count;
+		constexpr static uint32_t unlinked = overflow_list + 1;
+		constexpr static uint32_t bitmap_words = slot_count / 64;
+
+		struct timer_node
+		{
+			callback function;
+			uint64_t nominal{};
+			uint64_t deadline{};
+			uint64_t period{};
+			uint64_t granularity{};
+			uint32_t generation{};
+			uint32_t previous = no_timer;
+			uint32_t next = no_timer;
+			uint32_t list = unlinked;
+			bool in_use{};
+			bool due{};
+		};
+
+		uint32_t allocate_node();
+		void free_node(uint32_t);
+		bool is_live(timer_id) const;
+		void place(uint32_t);
+		void link(uint32_t, uint32_t);
+		void unlink(uint32_t);
+		void relink_list(uint32_t);
+		std::optional<uint32_t> next_occupied_slot(uint32_t, uint32_t) const;
+
+		std::vector<timer_node> m_nodes;
+		std::vector<uint32_t> m_free_nodes;
+		std::array<uint32_t, overflow_list + 1> m_heads;
+		std::array<std::array<uint64_t, bitmap_words>, level_count> m_occupied{};
+		uint64_t m_now;
+		size_t m_size = 0;
+	};
+
+	//Lets the service be driven by something other than the steady clock.
+	//Times are in microseconds.
+	class clock
+	{
+	public:
+		virtual ~clock() = default;
+		virtual uint64_t now() const = 0;
+	};
+
+	class steady_clock : public clock
+	{
+	public:
+		uint64_t now() const override;
+	};
+
+	//One thread running a wheel with microsecond ticks.
+	//Callbacks run on that thread and should hand work off rather than do it there.
+	class timer_service
+	{
+	public:
+		constexpr static std::chrono::microseconds default_tolerance{ 1000 };
+
+		explicit timer_service(std::unique_ptr<clock> = std::make_unique<steady_clock>());
+		~timer_service();
+
+		timer_id schedule_after(std::chrono::microseconds, callback, std::chrono::microseconds = default_tolerance);
+		timer_id schedule_every(std::chrono::microseconds, callback, std::chrono::microseconds = default_tolerance);
+		//Once this returns the callback isn't running and won't run again,
+		//unless this is called from the callback itself.
+		//Cancelling a default constructed id does nothing.
+		bool cancel(timer_id);
+
+		//Shared by every window in the process.
+		static timer_service &get_shared();
+
+	private:
+		timer_service(const timer_service &) = delete;
+		timer_service(timer_service &&) = delete;
+		timer_service &operator=(const timer_service &) = delete;
+		timer_service &operator=(timer_service &&) = delete;
+
+		timer_id schedule(uint64_t, uint64_t, uint64_t, callback);
+		void worker();
+
+		std::unique_ptr<clock> m_clock;
+
+		std::mutex m_lock;
+		std::condition_variable m_wake;
+		std::condition_variable m_callback_done;
+		timer_wheel m_wheel;
+		std::optional<uint64_t> m_sleep_until;
+		timer_id m_running{};
+		bool m_stopping = false;
+
+		std::thread m_thread;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "vector_shapes.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace vector_shapes
+{
+	namespace
+	{
+		path_geometry::transform to_transform(const D2D1_MATRIX_3X2_F &matrix)
+		{
+			return { matrix._11, matrix._12, matrix._21, matrix._22, matrix._31, matrix._32 };
+		}
+
+		//Applies the first transform, then the second.
+		path_geometry::transform combine(const path_geometry::transform &first, const path_geometry::transform &second)
+		{
+			return {
+				first.m11 * second.m11 + first.m12 * second.m21,
+				first.m11 * second.m12 + first.m12 * second.m22,
+				first.m21 * second.m11 + first.m22 * second.m21,
+				first.m21 * second.m12 + first.m22 * second.m22,
+				first.dx * second.m11 + first.dy * second.m21 + second.dx,
+				first.dx * second.m12 + first.dy * second.m22 + second.dy
+			};
+		}
+
+		path_geometry::path make_star(const path_geometry::point &centre, float outer, float inner, uint32_t points)
+		{
+			path_geometry::path star;
+			for (uint32_t i = 0; i < points * 2; ++i)
+			{
+				float radius = (i % 2) == 0 ? outer : inner;
+				float angle = static_cast<float>(i) * 3.14159265f / static_cast<float>(points) - 1.57079633f;
+				path_geometry::point p{ centre.x + std::cos(angle) * radius, centre.y + std::sin(angle) * radius };
+				if (i == 0)
+				{
+					star.move_to(p);
+				}
+				else
+				{
+					star.line_to(p);
+				}
+			}
+			star.close();
+
+			return star;
+		}
+	}
+
+	vector_shapes::vector_shapes()
+	{
+		path_geometry::path panel;
+		panel.add_rounded_rect({ 40.f, 140.f, 340.f, 280.f }, 16.f);
+		add_shape(std::move(panel), D2D1::ColorF(D2D1::ColorF::White, 0.5f), 0.f);
+
+		path_geometry::path outline;
+		outline.add_rounded_rect({ 40.f, 140.f, 340.f, 280.f }, 16.f);
+		add_shape(std::move(outline), D2D1::ColorF(D2D1::ColorF::White), 3.f);
+
+		add_shape(make_star({ 0.f, 0.f }, 110.f, 45.f, 5), D2D1::ColorF(D2D1::ColorF::Gold), 0.f, { 1.f, 0.f, 0.f, 1.f, 480.f, 220.f });
+
+		//The inner ellipse winds the other way, so it cuts a hole.
+		path_geometry::path ring;
+		ring.add_ellipse({ 0.f, 0.f }, 90.f, 90.f).add_ellipse({ 0.f, 0.f }, 55.f, 55.f, true);
+		add_shape(std::move(ring), D2D1::ColorF(D2D1::ColorF::Teal), 0.f, { 1.f, 0.f, 0.f, 1.f, 720.f, 220.f });
+
+		path_geometry::path wave;
+		wave.move_to({ 40.f, 420.f });
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			float x = 40.f + static_cast<float>(i) * 200.f;
+			wave.cubic_to({ x + 70.f, 340.f }, { x + 130.f, 500.f }, { x + 200.f, 420.f });
+		}
+		add_shape(std::move(wave), D2D1::ColorF(D2D1::ColorF::Navy), 6.f);
+	}
+
+	void vector_shapes::init_device_dependent_resources(ID2D1DeviceContext *device_context, const surface_config::surface_config &surface)
+	{
+		using namespace winrt;
+
+		std::vector<com_ptr<ID2D1SolidColorBrush>> brushes;
+		brushes.reserve(m_shapes.size());
+		for (auto &s : m_shapes)
+		{
+			com_ptr<ID2D1SolidColorBrush> brush;
+			check_hresult(device_context->CreateSolidColorBrush(surface.colour(s.colour), brush.put()));
+			brushes.push_back(brush);
+		}
+
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			m_shapes[i].brush = brushes[i];
+			m_shapes[i].mask = nullptr;
+			m_shapes[i].mask_valid = false;
+		}
+	}
+
+	void vector_shapes::cleanup_device_dependent_resources()
+	{
+		for (auto &s : m_shapes)
+		{
+			s.mask_valid = false;
+			s.mask = nullptr;
+			s.brush = nullptr;
+		}
+	}
+
+	void vector_shapes::draw(ID2D1DeviceContext *device_context, const D2D1_MATRIX_3X2_F &view)
+	{
+		auto view_transform = to_transform(view);
+
+		D2D1_MATRIX_3X2_F previous_transform{};
+		device_context->GetTransform(&previous_transform);
+		device_context->SetTransform(D2D1::Matrix3x2F::Identity());
+		//FillOpacityMask requires aliased rendering.
+		device_context->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+
+		auto target_size = device_context->GetSize();
+		for (auto &s : m_shapes)
+		{
+			auto transform = combine(s.placement, view_transform);
+			if (!s.mask_valid || s.mask_transform != transform || s.mask_target_size.width != target_size.width || s.mask_target_size.height != target_size.height)
+			{
+				rasterise(device_context, s, transform, target_size);
+			}
+
+			if (s.mask)
+			{
+				device_context->FillOpacityMask(s.mask.get(), s.brush.get(), &s.mask_rect);
+			}
+		}
+
+		device_context->SetAntialiasMode(D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+		device_context->SetTransform(previous_transform);
+	}
+
+	shape_stats vector_shapes::get_stats() const
+	{
+		shape_stats stats{};
+		for (auto &s : m_shapes)
+		{
+			stats.geometry_hits += s.geometry.hit_count();
+			stats.geometry_misses += s.geometry.miss_count();
+		}
+		stats.rasterised = m_rasterised;
+
+		return stats;
+	}
+
+	void vector_shapes::add_shape(path_geometry::path &&source, const D2D1_COLOR_F &colour, float stroke_width, const path_geometry::transform &placement)
+	{
+		m_shapes.push_back({ path_geometry::geometry{ std::move(source) }, colour, stroke_width, placement });
+	}
+
+	void vector_shapes::rasterise(ID2D1DeviceContext *device_context, shape &s, const path_geometry::transform &transform, const D2D1_SIZE_F &target_size)
+	{
+		using namespace winrt;
+
+		s.mask = nullptr;
+		s.mask_transform = transform;
+		s.mask_target_size = target_size;
+		s.mask_valid = true;
+
+		auto scale = transform.get_scale();
+		auto &polygons = s.stroke_width > 0.f ? s.geometry.get_stroke(scale, s.stroke_width) : s.geometry.get_fill(scale);
+		if (polygons.contours.empty())
+		{
+			return;
+		}
+
+		//The mask only covers the part of the transformed bounds that is on the target.
+		auto &box = polygons.box;
+		path_geometry::point corners[]{
+			transform.apply({ box.left, box.top }),
+			transform.apply({ box.right, box.top }),
+			transform.apply({ box.left, box.bottom }),
+			transform.apply({ box.right, box.bottom })
+		};
+		float left = FLT_MAX;
+		float top = FLT_MAX;
+		float right = -FLT_MAX;
+		float bottom = -FLT_MAX;
+		for (auto &corner : corners)
+		{
+			left = std::min(left, corner.x);
+			top = std::min(top, corner.y);
+			right = std::max(right, corner.x);
+			bottom = std::max(bottom, corner.y);
+		}
+
+		left = std::max(std::floor(left), 0.f);
+		top = std::max(std::floor(top), 0.f);
+		right = std::min(std::ceil(right), std::ceil(target_size.width));
+		bottom = std::min(std::ceil(bottom), std::ceil(target_size.height));
+		if (right <= left || bottom <= top)
+		{
+			return;
+		}
+
+		auto width = static_cast<uint32_t>(right - left);
+		auto height = static_cast<uint32_t>(bottom - top);
+		auto local = transform;
+		local.dx -= left;
+		local.dy -= top;
+
+		m_rasterizer.reset(width, height);
+		m_rasterizer.add_polygons(polygons, local);
+		m_coverage.resize(static_cast<size_t>(width) * height);
+		m_rasterizer.resolve(m_coverage.data(), width);
+
+		com_ptr<ID2D1Bitmap1> mask;
+		auto bps = D2D1::BitmapProperties1(D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+		check_hresult(device_context->CreateBitmap(D2D1::SizeU(width, height), m_coverage.data(), width, bps, mask.put()));
+
+		s.mask = mask;
+		s.mask_rect = D2D1::RectF(left, top, right, bottom);
+		++m_rasterised;
+	}
+}
\ No newline at end of file
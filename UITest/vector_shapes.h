@@ -0,0 +1,68 @@
+#pragma once
+
+#include "framework.h"
+#include "coverage_rasterizer.h"
+#include "path_geometry.h"
+#include "surface_config.h"
+
+#include <vector>
+
+namespace vector_shapes
+{
+	struct shape_stats
+	{
+		uint64_t geometry_hits{};
+		uint64_t geometry_misses{};
+		uint64_t rasterised{};
+	};
+
+	//A fixed set of filled and stroked paths drawn with the software rasteriser.
+	//Each shape keeps its coverage as an A8 bitmap and is only rasterised again when
+	//its transform or the target size changes, the polygons come from the geometry's
+	//per scale cache.
+	class vector_shapes
+	{
+	public:
+		vector_shapes();
+
+		void init_device_dependent_resources(ID2D1DeviceContext *, const surface_config::surface_config &);
+		void cleanup_device_dependent_resources();
+
+		//The transform is applied on top of each shape's own placement.
+		void draw(ID2D1DeviceContext *, const D2D1_MATRIX_3X2_F & = D2D1::Matrix3x2F::Identity());
+
+		shape_stats get_stats() const;
+
+	private:
+		vector_shapes(const vector_shapes &) = delete;
+		vector_shapes(vector_shapes &&) = delete;
+		vector_shapes &operator=(const vector_shapes &) = delete;
+		vector_shapes &operator=(vector_shapes &&) = delete;
+
+		struct shape
+		{
+			path_geometry::geometry geometry;
+			D2D1_COLOR_F colour;
+			//Zero fills the path.
+			float stroke_width;
+			path_geometry::transform placement;
+
+			winrt::com_ptr<ID2D1SolidColorBrush> brush;
+			winrt::com_ptr<ID2D1Bitmap1> mask;
+			D2D1_RECT_F mask_rect{};
+			path_geometry::transform mask_transform{};
+			//The mask is clipped to the target, so it is also out of date when the target is resized.
+			D2D1_SIZE_F mask_target_size{};
+			//A shape outside the target has no mask but is still up to date.
+			bool mask_valid = false;
+		};
+
+		void add_shape(path_geometry::path &&, const D2D1_COLOR_F &, float, const path_geometry::transform & = {});
+		void rasterise(ID2D1DeviceContext *, shape &, const path_geometry::transform &, const D2D1_SIZE_F &);
+
+		std::vector<shape> m_shapes;
+		coverage_rasterizer::rasterizer m_rasterizer;
+		std::vector<uint8_t> m_coverage;
+		uint64_t m_rasterised = 0;
+	};
+}
\ No newline at end of file
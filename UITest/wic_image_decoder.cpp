@@ -0,0 +1,95 @@
+#include "wic_image_decoder.h"
+
+namespace image_pipeline
+{
+	namespace
+	{
+		//Decoding happens on the shared executor's threads, so each thread joins the MTA
+		//the first time it decodes and keeps its own imaging factory.
+		class wic_thread_state
+		{
+		public:
+			wic_thread_state()
+			{
+				m_com_initialised = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+			}
+
+			~wic_thread_state()
+			{
+				m_factory = nullptr;
+				if (m_com_initialised)
+				{
+					CoUninitialize();
+				}
+			}
+
+			IWICImagingFactory *get_factory()
+			{
+				if (!m_factory)
+				{
+					winrt::check_hresult(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(m_factory.put())));
+				}
+				return m_factory.get();
+			}
+
+		private:
+			bool m_com_initialised = false;
+			winrt::com_ptr<IWICImagingFactory> m_factory;
+		};
+
+		thread_local wic_thread_state s_wic_thread_state;
+	}
+
+	bool wic_image_decoder::can_decode(std::span<const uint8_t>) const
+	{
+		return true;
+	}
+
+	decoded_image wic_image_decoder::decode(std::span<const uint8_t> data, const image_size &target) const
+	{
+		using namespace winrt;
+
+		auto factory = s_wic_thread_state.get_factory();
+
+		com_ptr<IWICStream> stream;
+		check_hresult(factory->CreateStream(stream.put()));
+		check_hresult(stream->InitializeFromMemory(const_cast<BYTE *>(data.data()), static_cast<DWORD>(data.size())));
+
+		com_ptr<IWICBitmapDecoder> decoder;
+		com_ptr<IWICBitmapFrameDecode> frame;
+		check_hresult(factory->CreateDecoderFromStream(stream.get(), nullptr, WICDecodeMetadataCacheOnDemand, decoder.put()));
+		check_hresult(decoder->GetFrame(0, frame.put()));
+
+		UINT width = 0;
+		UINT height = 0;
+		check_hresult(frame->GetSize(&width, &height));
+		if (width == 0 || height == 0)
+		{
+			throw_hresult(WINCODEC_ERR_BADIMAGE);
+		}
+
+		decoded_image image{};
+		image.size = fit_size({ width, height }, target);
+		image.stride = image.size.width * 4;
+		image.pixels.resize(static_cast<size_t>(image.stride) * image.size.height);
+
+		//Premultiply before scaling, resampling straight alpha lets the colour of
+		//transparent pixels bleed into the edges of translucent ones.
+		com_ptr<IWICFormatConverter> converter;
+		check_hresult(factory->CreateFormatConverter(converter.put()));
+		check_hresult(converter->Initialize(frame.get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeMedianCut));
+
+		com_ptr<IWICBitmapSource> source = converter;
+		if (image.size != image_size{ width, height })
+		{
+			com_ptr<IWICBitmapScaler> scaler;
+			check_hresult(factory->CreateBitmapScaler(scaler.put()));
+			check_hresult(scaler->Initialize(converter.get(), image.size.width, image.size.height, WICBitmapInterpolationModeHighQualityCubic));
+			source = scaler;
+		}
+
+		check_hresult(source->CopyPixels(nullptr, image.stride, static_cast<UINT>(image.pixels.size()), image.pixels.data()));
+
+		return image;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "framework.h"
+#include "image_pipeline.h"
+
+namespace image_pipeline
+{
+	//Decodes anything WIC has a codec for.
+	//The scaler is placed directly on the frame, so codecs that can scale
+	//while decoding (JPEG for example) never produce the full size image.
+	//It accepts every format, so it should be the last decoder in the list.
+	class wic_image_decoder : public image_decoder
+	{
+	public:
+		bool can_decode(std::span<const uint8_t>) const override;
+		decoded_image decode(std::span<const uint8_t>, const image_size &) const override;
+	};
+}
\ No newline at end of file
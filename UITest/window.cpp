@@ -1,19 +1,52 @@
 #include "window.h"
+#include "async_log.h"
 #include <application.hpp>
-#include <application_helper.hpp>
 #include <application_dispatcher_queue.hpp>
 #include <application_dispatcher_queue_projection.hpp>
 
 namespace windowing
 {
+	namespace
+	{
+		std::wstring format_replay_stats(const session_log::replay_stats &stats)
+		{
+			return std::format(L"Replayed {} frames, {} skipped ticks, {} resizes and {} minimises in {:.3f}s. Frame time ms: min {:.3f}, mean {:.3f}, p50 {:.3f}, p95 {:.3f}, p99 {:.3f}, max {:.3f}.",
+				stats.frame_count, stats.skipped_count, stats.resize_count, stats.minimize_count, stats.total_time.count(),
+				stats.frame_min, stats.frame_mean, stats.frame_p50, stats.frame_p95, stats.frame_p99, stats.frame_max);
+		}
+	}
+
+	draw_replay_target::draw_replay_target(draw_interface::draw_interface &target) : m_target{ target }
+	{
+	}
+
+	void draw_replay_target::resize(const session_log::client_size &dimentions)
+	{
+		m_target.resize({ dimentions.width, dimentions.height });
+	}
+
+	void draw_replay_target::minimize()
+	{
+		m_target.resize_hide();
+	}
+
+	bool draw_replay_target::update_frame()
+	{
+		return m_target.update_frame();
+	}
+
+	void draw_replay_target::set_present_interval(uint32_t interval)
+	{
+		m_target.set_present_interval(interval);
+	}
+
 	main_window::main_window(HINSTANCE inst) : my_base(inst)
 	{
 	}
 
-	main_window *main_window::create(HINSTANCE inst)
+	main_window *main_window::create(HINSTANCE inst, const surface_config::surface_config &surface)
 	{
 		using namespace std;
-		using namespace application::helper;
 
 		main_window *ptr = nullptr;
 		try
@@ -22,6 +55,7 @@ namespace windowing
 			//being able to access the default constructor.
 			//The function is exception safe.
 			ptr = new main_window(inst);
+			ptr->m_surface_config = surface;
 
 			auto icon = reinterpret_cast<HICON>(LoadImageW(nullptr, IDI_APPLICATION, IMAGE_ICON, 0, 0, LR_DEFAULTCOLOR | LR_DEFAULTSIZE));
 			//GetSystemMetrics is ok here, since it defaults to our process' default DPI.
@@ -33,7 +67,7 @@ namespace windowing
 				delete ptr;
 				DWORD last_error = GetLastError();
 
-				writeln_debugger(L"Class registration failed. Last error: {}.", last_error);
+				ASYNC_LOG(error, L"Class registration failed. Last error: {}.", last_error);
 				return nullptr;
 			}
 
@@ -47,7 +81,7 @@ namespace windowing
 		{
 			delete ptr;
 
-			writeln_debugger(L"Unexpected exception caught.");
+			ASYNC_LOG(error, L"Unexpected exception caught.");
 			throw;
 		}
 
@@ -61,31 +95,118 @@ namespace windowing
 		return m_draw_interface.get();
 	}
 
-	bool main_window::on_create(const CREATESTRUCTW &)
+	void main_window::start_recording(const std::filesystem::path &path)
 	{
-		bool succeeded = true;
-		application::application_system_dispatcher_queue queue_control;
-		auto queue_id = queue_control.create_background_dispatcher_queue();
-		m_my_queue = application::projection::application_system_dispatcher_queue_access::get_thread_dispatcher_queue();
+		m_recorder = std::make_unique<session_log::recorder>(path);
+
+		//WM_SIZE has already been sent by the time the window is created,
+		//so the log starts with the current state.
+		if (IsIconic(get_handle()))
+		{
+			m_recorder->record_minimize();
+		}
+		else
+		{
+			RECT client_rect{};
+			GetClientRect(get_handle(), &client_rect);
+			m_recorder->record_resize({ static_cast<int32_t>(client_rect.right - client_rect.left), static_cast<int32_t>(client_rect.bottom - client_rect.top) });
+		}
+	}
 
-		m_timer_queue = application::projection::application_system_dispatcher_queue_access::get_background_dispatcher_queue(queue_id);
+	void main_window::replay(std::vector<session_log::event> &&events, session_log::replay_timing timing)
+	{
+		stop_frame_timer();
+		m_replaying = true;
+		m_replay_target = std::make_unique<draw_replay_target>(*m_draw_interface);
+		m_player = std::make_unique<session_log::player>(std::move(events), *m_replay_target, timing);
+
+		schedule_replay_step();
+	}
 
-		m_timer = m_timer_queue.CreateTimer();
+	void main_window::schedule_replay_step()
+	{
+		using namespace winrt::Windows::System;
 
-		winrt::Windows::Foundation::TimeSpan ts = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>{1. / 60});
-		m_timer.Interval(ts);
+		//Low priority lets input and paint messages through between events.
+		auto delay = m_player->next_delay();
+		if (delay.count() == 0)
+		{
+			m_my_queue.TryEnqueue(DispatcherQueuePriority::Low, [this]()
+				{
+					run_replay_step();
+				});
+			return;
+		}
 
-		m_timer_tick_revoker = m_timer.Tick(winrt::auto_revoke, [this](auto &&, auto &&)
+		m_replay_timer = timer_wheel::timer_service::get_shared().schedule_after(delay, [this]()
 			{
 				m_my_queue.TryEnqueue([this]()
 					{
-						m_draw_interface->update_frame();
+						run_replay_step();
 					});
 			});
+	}
+
+	void main_window::run_replay_step()
+	{
+		//The window was closed while this was queued.
+		if (!m_player)
+		{
+			return;
+		}
+
+		m_replay_timer = {};
+		try
+		{
+			if (m_player->step())
+			{
+				schedule_replay_step();
+				return;
+			}
+
+			ASYNC_LOG(info, L"{}", format_replay_stats(m_player->get_stats()));
+		}
+		catch (...)
+		{
+			ASYNC_LOG(error, L"Replay failed.");
+		}
+
+		stop_replay();
+		PostMessageW(get_handle(), WM_CLOSE, 0, 0);
+	}
+
+	void main_window::stop_replay()
+	{
+		if (m_replay_timer != timer_wheel::timer_id{})
+		{
+			timer_wheel::timer_service::get_shared().cancel(m_replay_timer);
+			m_replay_timer = {};
+		}
+		m_player.reset();
+		m_replay_target.reset();
+		m_replaying = false;
+	}
+
+	bool main_window::on_create(const CREATESTRUCTW &)
+	{
+		bool succeeded = true;
+		m_my_queue = application::projection::application_system_dispatcher_queue_access::get_thread_dispatcher_queue();
 
-		m_timer.Start();
+		auto interval = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>{ 1. / 60 });
+		m_frame_timer = timer_wheel::timer_service::get_shared().schedule_every(interval, [this]()
+			{
+				m_my_queue.TryEnqueue([this]()
+					{
+						if (m_recorder)
+						{
+							m_recorder->record_tick();
+						}
+						m_draw_interface->update_frame();
+					});
+			});
 
 		m_draw_interface = std::make_unique<draw_interface::draw_interface>(get_handle());
+		m_draw_interface->set_surface_config(m_surface_config);
 		m_draw_interface->init_device_independent_resources();
 		m_draw_interface->init_device_dependent_resources();
 
@@ -97,10 +218,29 @@ namespace windowing
 
 	void main_window::on_close()
 	{
-		m_timer.Stop();
+		stop_frame_timer();
+		stop_replay();
+		if (m_recorder)
+		{
+			m_recorder->record_close();
+			m_recorder.reset();
+		}
 		PostMessageW(get_handle(), WM_USER + 10, 0, 0);
 	}
 
+	void main_window::stop_frame_timer()
+	{
+		//A replay has already stopped it.
+		if (m_frame_timer == timer_wheel::timer_id{})
+		{
+			return;
+		}
+
+		//Once this returns the tick can't enqueue any more frames.
+		timer_wheel::timer_service::get_shared().cancel(m_frame_timer);
+		m_frame_timer = {};
+	}
+
 	void main_window::on_destroy()
 	{
 		m_draw_interface->cleanup_sized_resources();
@@ -110,13 +250,18 @@ namespace windowing
 
 	void main_window::on_size(resize_type type, int32_t, int32_t)
 	{
-		if (m_draw_interface == nullptr)
+		//While replaying, only the log changes the size of the drawing interface.
+		if (m_draw_interface == nullptr || m_replaying)
 		{
 			return;
 		}
 
 		if (type == resize_type::minimized)
 		{
+			if (m_recorder)
+			{
+				m_recorder->record_minimize();
+			}
 			m_draw_interface->resize_hide();
 		}
 		else
@@ -127,6 +272,10 @@ namespace windowing
 			
 			SIZEL dimentions{client_rect.right - client_rect.left, client_rect.bottom - client_rect.top};
 
+			if (m_recorder)
+			{
+				m_recorder->record_resize({ static_cast<int32_t>(dimentions.cx), static_cast<int32_t>(dimentions.cy) });
+			}
 			m_draw_interface->resize(dimentions);
 		}
 	}
@@ -140,6 +289,30 @@ namespace windowing
 		return true;
 	}
 
+	void main_window::on_mouse_wheel(int16_t delta, uint16_t keys, POINT screen_point)
+	{
+		//Control zooms around the cursor and shift scrolls sideways.
+		//One notch scrolls by WHEEL_DELTA pixels.
+		if (m_draw_interface == nullptr)
+		{
+			return;
+		}
+
+		if (keys & MK_CONTROL)
+		{
+			ScreenToClient(get_handle(), &screen_point);
+			m_draw_interface->zoom_canvas(delta > 0 ? 1 : -1, D2D1::Point2F(static_cast<float>(screen_point.x), static_cast<float>(screen_point.y)));
+		}
+		else if (keys & MK_SHIFT)
+		{
+			m_draw_interface->scroll_canvas(static_cast<float>(-delta), 0.f);
+		}
+		else
+		{
+			m_draw_interface->scroll_canvas(0.f, static_cast<float>(-delta));
+		}
+	}
+
 	void main_window::on_deferquit()
 	{
 		DestroyWindow(get_handle());
@@ -158,6 +331,49 @@ namespace windowing
 			handled = true;
 			break;
 		}
+		case WM_KEYDOWN:
+		{
+			//F3 toggles the performance overlay.
+			if (wparam == VK_F3 && m_draw_interface)
+			{
+				m_draw_interface->toggle_hud();
+				handled = true;
+			}
+			break;
+		}
+		case WM_MOUSEMOVE:
+		{
+			//Left for the default handler as well, which tracks the mouse leaving.
+			if (m_draw_interface)
+			{
+				m_draw_interface->set_pointer(D2D1::Point2F(static_cast<float>(static_cast<short>(LOWORD(lparam))), static_cast<float>(static_cast<short>(HIWORD(lparam)))));
+			}
+			break;
+		}
+		case WM_MOUSELEAVE:
+		{
+			if (m_draw_interface)
+			{
+				m_draw_interface->clear_pointer();
+			}
+			break;
+		}
+		case WM_MOUSEWHEEL:
+		{
+			on_mouse_wheel(GET_WHEEL_DELTA_WPARAM(wparam), GET_KEYSTATE_WPARAM(wparam), { static_cast<short>(LOWORD(lparam)), static_cast<short>(HIWORD(lparam)) });
+			handled = true;
+			break;
+		}
+		case WM_MOUSEHWHEEL:
+		{
+			//Tilting right scrolls right, unlike the vertical wheel.
+			if (m_draw_interface)
+			{
+				m_draw_interface->scroll_canvas(static_cast<float>(GET_WHEEL_DELTA_WPARAM(wparam)), 0.f);
+			}
+			handled = true;
+			break;
+		}
 		}
 
 		return { result, handled };
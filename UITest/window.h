@@ -2,11 +2,38 @@
 #include "window.hpp"
 #include "framework.h"
 #include "draw_interface.h"
+#include "session_log.h"
+#include "surface_config.h"
+#include "timer_wheel.h"
+
+#include <filesystem>
+#include <memory>
+#include <vector>
 
 namespace windowing
 {
 	struct meh {};
 
+	//Replays a session log against the drawing interface.
+	class draw_replay_target : public session_log::replay_target
+	{
+	public:
+		explicit draw_replay_target(draw_interface::draw_interface &);
+
+		void resize(const session_log::client_size &) override;
+		void minimize() override;
+		bool update_frame() override;
+		void set_present_interval(uint32_t) override;
+
+	private:
+		draw_replay_target(const draw_replay_target &) = delete;
+		draw_replay_target(draw_replay_target &&) = delete;
+		draw_replay_target &operator=(const draw_replay_target &) = delete;
+		draw_replay_target &operator=(draw_replay_target &&) = delete;
+
+		draw_interface::draw_interface &m_target;
+	};
+
 	class main_window : public window_t<main_window>
 	{
 	public:
@@ -16,15 +43,24 @@ namespace windowing
 		using ncmouse_track_policy = window_ncmouse_track_t;
 
 		using my_base = window_t<main_window>;
-		static main_window *create(HINSTANCE);
+		static main_window *create(HINSTANCE, const surface_config::surface_config & = {});
 
 		draw_interface::draw_interface *get_draw_interface() const;
+
+		//Records resizes, minimises, closes and timer ticks until the window closes.
+		void start_recording(const std::filesystem::path &);
+		//Drives the drawing interface from the log instead of the timer and WM_SIZE,
+		//then logs the statistics and closes the window.
+		//The events are sent from the message loop, one per dispatcher queue item.
+		void replay(std::vector<session_log::event> &&, session_log::replay_timing);
 	protected:
 		bool on_create(const CREATESTRUCTW &);
 		void on_close();
 		void on_destroy();
 		void on_size(resize_type, int32_t, int32_t);
 
+		void on_mouse_wheel(int16_t, uint16_t, POINT);
+
 		void on_paint(const PAINTSTRUCT &);
 		bool on_erasebkgnd(HDC);
 
@@ -42,6 +78,11 @@ namespace windowing
 
 		explicit main_window(HINSTANCE);
 
+		void stop_frame_timer();
+		void schedule_replay_step();
+		void run_replay_step();
+		void stop_replay();
+
 		main_window() = delete;
 		main_window(const main_window &) = delete;
 		main_window(main_window &&) = delete;
@@ -50,8 +91,15 @@ namespace windowing
 
 		std::unique_ptr<draw_interface::draw_interface> m_draw_interface;
 		winrt::Windows::System::DispatcherQueue m_my_queue{ nullptr };
-		winrt::Windows::System::DispatcherQueue m_timer_queue{ nullptr };
-		winrt::Windows::System::DispatcherQueueTimer m_timer{ nullptr };
-		winrt::Windows::System::DispatcherQueueTimer::Tick_revoker m_timer_tick_revoker{};
+		//The frame timer runs on the shared timer thread rather than a queue of its own.
+		timer_wheel::timer_id m_frame_timer{};
+		surface_config::surface_config m_surface_config;
+		std::unique_ptr<session_log::recorder> m_recorder;
+		//Declared before the player, which keeps a reference to it.
+		std::unique_ptr<draw_replay_target> m_replay_target;
+		std::unique_ptr<session_log::player> m_player;
+		//Waits for the next event when replaying at the original speed.
+		timer_wheel::timer_id m_replay_timer{};
+		bool m_replaying = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "test_support.h"
+
+#include "async_log.h"
+
+#include <condition_variable>
+#include <cwchar>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace async_log;
+
+namespace
+{
+	//The sinks can't be removed, so every test shares this one.
+	//It is never destroyed, the logger can still write to it as the process exits.
+	class capture
+	{
+	public:
+		void write(std::wstring_view line)
+		{
+			std::unique_lock lock{ m_lock };
+			m_lines.emplace_back(line);
+			m_changed.notify_all();
+			m_changed.wait(lock, [this]()
+				{
+					return !m_blocked;
+				});
+		}
+
+		std::vector<std::wstring> take()
+		{
+			std::scoped_lock lock{ m_lock };
+			return std::exchange(m_lines, {});
+		}
+
+		//Stops the logging thread in the next write, so nothing more is drained.
+		void block()
+		{
+			std::scoped_lock lock{ m_lock };
+			m_blocked = true;
+		}
+
+		bool wait_for_lines(size_t count)
+		{
+			std::unique_lock lock{ m_lock };
+			return m_changed.wait_for(lock, std::chrono::seconds{ 10 }, [this, count]()
+				{
+					return m_lines.size() >= count;
+				});
+		}
+
+		void unblock()
+		{
+			{
+				std::scoped_lock lock{ m_lock };
+				m_blocked = false;
+			}
+			m_changed.notify_all();
+		}
+
+	private:
+		std::mutex m_lock;
+		std::condition_variable m_changed;
+		std::vector<std::wstring> m_lines;
+		bool m_blocked = false;
+	};
+
+	class capture_sink : public log_sink
+	{
+	public:
+		explicit capture_sink(capture &target) : m_target{ target }
+		{
+		}
+
+		void write(severity, std::wstring_view line) override
+		{
+			m_target.write(line);
+		}
+
+	private:
+		capture &m_target;
+	};
+
+	capture &get_capture()
+	{
+		static auto instance = []()
+			{
+				auto target = new capture;
+				add_sink(std::make_unique<capture_sink>(*target));
+				return target;
+			}();
+		return *instance;
+	}
+
+	//Everything logged so far, without the timestamp and severity.
+	std::vector<std::wstring> flushed_messages()
+	{
+		flush();
+		auto lines = get_capture().take();
+		for (auto &line : lines)
+		{
+			line.erase(0, line.find(L": ") + 2);
+		}
+		return lines;
+	}
+
+	bool contains(const std::vector<std::wstring> &lines, std::wstring_view text)
+	{
+		for (auto &line : lines)
+		{
+			if (line.find(text) != std::wstring::npos)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+TEST_CASE(records_are_formatted_on_the_logging_thread)
+{
+	flushed_messages();
+
+	ASYNC_LOG(info, L"{} and {} make {:.1f}, {}", 1, 2u, 3.0, L"text");
+
+	auto lines = flushed_messages();
+	CHECK(lines.size() == 1);
+	CHECK(lines[0] == L"1 and 2 make 3.0, text");
+}
+
+TEST_CASE(flush_waits_for_pending_records)
+{
+	flushed_messages();
+
+	for (int i = 0; i < 50; ++i)
+	{
+		ASYNC_LOG_LIMIT(info, 1000, L"pending {}", i);
+	}
+	flush();
+
+	//No waiting after the flush, everything has to be there already.
+	auto lines = get_capture().take();
+	CHECK(lines.size() == 50);
+	CHECK(contains(lines, L"pending 49"));
+}
+
+TEST_CASE(an_idle_logger_wakes_for_a_record)
+{
+	flushed_messages();
+	//Long enough for the logging thread to go idle.
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+
+	ASYNC_LOG(info, L"after idle");
+
+	//Nothing flushes, the write alone has to wake the logging thread.
+	CHECK(get_capture().wait_for_lines(1));
+	CHECK(contains(get_capture().take(), L"after idle"));
+}
+
+TEST_CASE(rate_limit_suppresses_and_reports)
+{
+	flushed_messages();
+
+	//Explicit timestamps, all in the first second.
+	static call_site site{ severity::info, L"limited {}", 3 };
+	CHECK(site.admit(1'000'000'000));
+	CHECK(site.admit(1'200'000'000));
+	CHECK(site.admit(1'400'000'000));
+	CHECK(!site.admit(1'600'000'000));
+	CHECK(!site.admit(1'800'000'000));
+
+	//The next record, in a later second, carries the count.
+	write(site, 1);
+	auto lines = flushed_messages();
+	CHECK(lines.size() == 1);
+	CHECK(contains(lines, L"limited 1 (2 similar records suppressed.)"));
+
+	//And the count only goes out once.
+	write(site, 2);
+	lines = flushed_messages();
+	CHECK(lines.size() == 1);
+	CHECK(lines[0] == L"limited 2");
+}
+
+TEST_CASE(full_buffers_drop_records)
+{
+	flushed_messages();
+	auto &target = get_capture();
+	auto before = get_stats();
+
+	//Hold the logging thread inside the sink, so this thread's buffer can only fill.
+	target.block();
+	ASYNC_LOG(info, L"blocking");
+	CHECK(target.wait_for_lines(1));
+
+	//A suppressed count taken by a record that is dropped isn't lost.
+	static call_site site{ severity::info, L"after drop {}", 2 };
+	site.admit(0);
+	site.admit(0);
+	CHECK(!site.admit(0));
+
+	constexpr int record_count = 100;
+	std::wstring large(1000, L'x');
+	for (int i = 0; i < record_count; ++i)
+	{
+		ASYNC_LOG_LIMIT(info, 1000, L"large {} {}", i, large);
+	}
+	//As large as the rest, so it can't fit in what they left.
+	write(site, large);
+
+	auto after_fill = get_stats();
+	auto dropped = after_fill.dropped - before.dropped;
+	CHECK(dropped > 0);
+	CHECK(dropped < record_count + 1);
+
+	target.unblock();
+	flush();
+	auto lines = target.take();
+	size_t large_lines = 0;
+	for (auto &line : lines)
+	{
+		large_lines += line.find(L"large ") != std::wstring::npos ? 1 : 0;
+	}
+	CHECK(large_lines == record_count - (dropped - 1));
+	CHECK(contains(lines, L"log records were dropped because a thread's buffer was full."));
+
+	write(site, L"done");
+	CHECK(contains(flushed_messages(), L"after drop done (1 similar records suppressed.)"));
+}
+
+TEST_CASE(each_thread_keeps_its_order)
+{
+	flushed_messages();
+	auto before = get_stats();
+
+	constexpr int thread_count = 4;
+	constexpr int record_count = 500;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_count; ++t)
+	{
+		threads.emplace_back([t]()
+			{
+				for (int i = 0; i < record_count; ++i)
+				{
+					ASYNC_LOG_LIMIT(info, 1'000'000, L"thread {} record {}", t, i);
+				}
+			});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	auto lines = flushed_messages();
+	CHECK(get_stats().dropped == before.dropped);
+	CHECK(lines.size() == thread_count * record_count);
+
+	std::vector<int> next(thread_count, 0);
+	for (auto &line : lines)
+	{
+		int t = 0;
+		int i = 0;
+		CHECK(std::swscanf(line.c_str(), L"thread %d record %d", &t, &i) == 2);
+		CHECK(t >= 0 && t < thread_count);
+		CHECK(i == next[t]);
+		next[t] = i + 1;
+	}
+}
\ No newline at end of file
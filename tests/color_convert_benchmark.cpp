@@ -0,0 +1,66 @@
+#include "test_support.h"
+
+#include "color_convert.h"
+
+#include <cstdio>
+#include <random>
+
+//Times converting whole 1080p frames in each direction, the way the image
+//upload and the batch readback use them, with each available readback kernel.
+
+using namespace color_convert;
+
+int main()
+{
+	constexpr size_t pixel_count = 1920 * 1080;
+	constexpr int frame_count = 20;
+
+	std::mt19937 random{ 1 };
+	std::uniform_int_distribution<int> byte{ 0, 255 };
+	std::vector<uint8_t> bgra(pixel_count * 4);
+	for (auto &value : bgra)
+	{
+		value = static_cast<uint8_t>(byte(random));
+	}
+	std::vector<uint16_t> rgba(pixel_count * 4);
+	std::vector<uint8_t> readback(pixel_count * 4);
+
+	//The upload is the same table lookup on every processor.
+	double upload_ms = test_support::time_ms([&]()
+		{
+			for (int i = 0; i < frame_count; ++i)
+			{
+				bgra8_to_rgba16f(bgra.data(), rgba.data(), pixel_count);
+			}
+		});
+	std::printf("1080p bgra8 to rgba16f %6.2f ms\n", upload_ms / frame_count);
+
+	std::vector<std::pair<const char *, instruction_set>> sets{ { "scalar", instruction_set::scalar } };
+	if (detect_instruction_set() == instruction_set::f16c)
+	{
+		sets.push_back({ "f16c", instruction_set::f16c });
+	}
+
+	for (auto [name, set] : sets)
+	{
+		auto &kernels = get_kernels(set);
+		double clip_ms = test_support::time_ms([&]()
+			{
+				for (int i = 0; i < frame_count; ++i)
+				{
+					kernels.rgba16f_to_bgra8(rgba.data(), readback.data(), pixel_count, 1.f);
+				}
+			});
+		double tone_map_ms = test_support::time_ms([&]()
+			{
+				for (int i = 0; i < frame_count; ++i)
+				{
+					kernels.rgba16f_to_bgra8(rgba.data(), readback.data(), pixel_count, 4.f);
+				}
+			});
+
+		std::printf("%-6s 1080p rgba16f to bgra8 clipped %6.2f ms, tone mapped %6.2f ms\n", name, clip_ms / frame_count, tone_map_ms / frame_count);
+	}
+
+	return 0;
+}
\ No newline at end of file
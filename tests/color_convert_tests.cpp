@@ -0,0 +1,292 @@
+#include "test_support.h"
+
+#include "color_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace color_convert;
+
+namespace
+{
+	std::vector<instruction_set> available_sets()
+	{
+		std::vector<instruction_set> sets{ instruction_set::scalar };
+		if (detect_instruction_set() == instruction_set::f16c)
+		{
+			sets.push_back(instruction_set::f16c);
+		}
+		return sets;
+	}
+
+	//One channel of a grey pixel through the readback kernel.
+	uint8_t read_back(instruction_set set, float value, float white_point)
+	{
+		uint16_t source[4]{ float_to_half(value), float_to_half(value), float_to_half(value), float_to_half(1.f) };
+		uint8_t destination[4]{};
+		get_kernels(set).rgba16f_to_bgra8(source, destination, 1, white_point);
+		return destination[0];
+	}
+
+	uint8_t expected_srgb(float linear)
+	{
+		return static_cast<uint8_t>(std::lround(linear_to_srgb(std::clamp(linear, 0.f, 1.f)) * 255.f));
+	}
+}
+
+TEST_CASE(srgb_transfer_round_trips)
+{
+	for (int i = 0; i < 256; ++i)
+	{
+		float value = static_cast<float>(i) / 255.f;
+		CHECK(std::fabs(linear_to_srgb(srgb_to_linear(value)) - value) < 1e-5f);
+	}
+	CHECK(srgb_to_linear(0.f) == 0.f);
+	CHECK(std::fabs(srgb_to_linear(1.f) - 1.f) < 1e-6f);
+}
+
+TEST_CASE(every_half_round_trips_through_float)
+{
+	for (uint32_t bits = 0; bits < 0x10000; ++bits)
+	{
+		auto half = static_cast<uint16_t>(bits);
+		float value = half_to_float(half);
+		if (std::isnan(value))
+		{
+			CHECK((float_to_half(value) & 0x7c00) == 0x7c00);
+			CHECK((float_to_half(value) & 0x03ff) != 0);
+		}
+		else
+		{
+			CHECK(float_to_half(value) == half);
+		}
+	}
+}
+
+TEST_CASE(float_to_half_rounds_to_nearest_even)
+{
+	//One and the next half up differ by 2^-10.
+	CHECK(float_to_half(1.f) == 0x3c00);
+	CHECK(float_to_half(1.f + 0x1p-11f) == 0x3c00);
+	CHECK(float_to_half(1.f + 0x1p-10f + 0x1p-11f) == 0x3c02);
+	CHECK(float_to_half(1.f + 0x1p-11f + 0x1p-20f) == 0x3c01);
+	//Overflow, underflow to the subnormals and the sign.
+	CHECK(float_to_half(65520.f) == 0x7c00);
+	CHECK(float_to_half(65504.f) == 0x7bff);
+	CHECK(float_to_half(0x1p-24f) == 0x0001);
+	CHECK(float_to_half(0x1p-26f) == 0x0000);
+	CHECK(float_to_half(-2.f) == 0xc000);
+}
+
+TEST_CASE(float_to_half_matches_the_nearest_half)
+{
+	//Checked against the distance to each neighbouring half rather than another implementation.
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> exponent{ -26.f, 16.f };
+	for (int i = 0; i < 100000; ++i)
+	{
+		float value = std::exp2(exponent(random));
+		auto half = float_to_half(value);
+		if (half >= 0x7bff)
+		{
+			continue;
+		}
+		double error = std::fabs(static_cast<double>(half_to_float(half)) - value);
+		double below = half > 0 ? std::fabs(static_cast<double>(half_to_float(static_cast<uint16_t>(half - 1))) - value) : error;
+		double above = std::fabs(static_cast<double>(half_to_float(static_cast<uint16_t>(half + 1))) - value);
+		CHECK(error <= below);
+		CHECK(error <= above);
+	}
+}
+
+TEST_CASE(bgra8_to_rgba16f_is_accurate)
+{
+	std::vector<uint8_t> source(256 * 4);
+	for (int i = 0; i < 256; ++i)
+	{
+		source[i * 4 + 0] = static_cast<uint8_t>(i);
+		source[i * 4 + 1] = static_cast<uint8_t>(255 - i);
+		source[i * 4 + 2] = static_cast<uint8_t>(i / 2);
+		source[i * 4 + 3] = static_cast<uint8_t>(i);
+	}
+
+	std::vector<uint16_t> destination(256 * 4);
+	bgra8_to_rgba16f(source.data(), destination.data(), 256);
+	for (int i = 0; i < 256; ++i)
+	{
+		//Swapped to RGBA, converted as straight colour, clamped where the colour
+		//is above the alpha, and well within one half float step.
+		float alpha = static_cast<float>(i) / 255.f;
+		auto premultiplied = [&](int value)
+		{
+			return i > 0 ? srgb_to_linear(std::min(static_cast<float>(value) / static_cast<float>(i), 1.f)) * alpha : 0.f;
+		};
+		float expected[4]{ premultiplied(i / 2), premultiplied(255 - i), premultiplied(i), alpha };
+		for (int c = 0; c < 4; ++c)
+		{
+			float actual = half_to_float(destination[i * 4 + c]);
+			CHECK(std::fabs(actual - expected[c]) <= std::max(expected[c] * 0x1p-10f, 0x1p-24f));
+		}
+	}
+}
+
+TEST_CASE(translucent_pixels_are_converted_as_straight_colour)
+{
+	//Half transparent white is 128 in every channel, which is white once unpremultiplied,
+	//so it is half of linear white rather than the linear value of 128.
+	uint8_t white[4]{ 128, 128, 128, 128 };
+	uint16_t linear[4]{};
+	bgra8_to_rgba16f(white, linear, 1);
+	for (auto value : linear)
+	{
+		CHECK(std::fabs(half_to_float(value) - 128.f / 255.f) < 1e-3f);
+	}
+
+	//Linear grey at a quarter, half transparent, is straight linear one half.
+	uint16_t grey[4]{ float_to_half(0.25f), float_to_half(0.25f), float_to_half(0.25f), float_to_half(0.5f) };
+	for (auto set : available_sets())
+	{
+		uint8_t destination[4]{};
+		get_kernels(set).rgba16f_to_bgra8(grey, destination, 1, 1.f);
+		CHECK(destination[3] == 128);
+		CHECK(destination[0] == static_cast<uint8_t>(std::lround(linear_to_srgb(0.5f) * 128.f)));
+		CHECK(destination[0] == destination[1] && destination[1] == destination[2]);
+	}
+}
+
+TEST_CASE(translucent_pixels_round_trip)
+{
+	//Every valid premultiplied colour at every alpha.
+	std::vector<uint8_t> source;
+	for (int alpha = 0; alpha < 256; ++alpha)
+	{
+		for (int colour = 0; colour <= alpha; ++colour)
+		{
+			source.insert(source.end(), { static_cast<uint8_t>(colour), static_cast<uint8_t>(alpha - colour), static_cast<uint8_t>(colour / 2), static_cast<uint8_t>(alpha) });
+		}
+	}
+	size_t pixel_count = source.size() / 4;
+
+	std::vector<uint16_t> linear(source.size());
+	bgra8_to_rgba16f(source.data(), linear.data(), pixel_count);
+
+	for (auto set : available_sets())
+	{
+		std::vector<uint8_t> destination(source.size());
+		get_kernels(set).rgba16f_to_bgra8(linear.data(), destination.data(), pixel_count, 1.f);
+		for (size_t i = 0; i < pixel_count * 4; i += 4)
+		{
+			//Fully transparent pixels lose their colour.
+			if (source[i + 3] == 0)
+			{
+				CHECK(destination[i] == 0 && destination[i + 1] == 0 && destination[i + 2] == 0 && destination[i + 3] == 0);
+				continue;
+			}
+			for (size_t c = 0; c < 4; ++c)
+			{
+				CHECK(destination[i + c] == source[i + c]);
+			}
+		}
+	}
+}
+
+TEST_CASE(rgba16f_to_bgra8_round_trips_8_bit_values)
+{
+	std::vector<uint8_t> source(256 * 4);
+	for (int i = 0; i < 256; ++i)
+	{
+		source[i * 4 + 0] = static_cast<uint8_t>(i);
+		source[i * 4 + 1] = static_cast<uint8_t>(255 - i);
+		source[i * 4 + 2] = static_cast<uint8_t>(i * 7);
+		source[i * 4 + 3] = 255;
+	}
+
+	std::vector<uint16_t> linear(256 * 4);
+	bgra8_to_rgba16f(source.data(), linear.data(), 256);
+
+	for (auto set : available_sets())
+	{
+		std::vector<uint8_t> destination(256 * 4);
+		get_kernels(set).rgba16f_to_bgra8(linear.data(), destination.data(), 256, 1.f);
+		CHECK(destination == source);
+	}
+}
+
+TEST_CASE(tone_mapping_compresses_the_whole_range)
+{
+	for (auto set : available_sets())
+	{
+		//Without tone mapping values clip at one.
+		CHECK(read_back(set, 0.5f, 1.f) == expected_srgb(0.5f));
+		CHECK(read_back(set, 3.f, 1.f) == 255);
+
+		//With a white point of four, the white point maps to one and
+		//everything below it is compressed, including values under one.
+		constexpr float white_point = 4.f;
+		auto reinhard = [](float x)
+		{
+			return x * (1.f + x / (white_point * white_point)) / (1.f + x);
+		};
+		CHECK(read_back(set, white_point, white_point) == 255);
+		CHECK(read_back(set, 10.f, white_point) == 255);
+		CHECK(read_back(set, 1.f, white_point) == expected_srgb(reinhard(1.f)));
+		CHECK(read_back(set, 1.f, white_point) < 255);
+		CHECK(read_back(set, 0.25f, white_point) == expected_srgb(reinhard(0.25f)));
+		CHECK(read_back(set, 0.25f, white_point) < read_back(set, 0.25f, 1.f));
+
+		uint8_t previous = 0;
+		for (float value = 0.f; value <= white_point; value += 1.f / 64)
+		{
+			auto mapped = read_back(set, value, white_point);
+			CHECK(mapped >= previous);
+			previous = mapped;
+		}
+	}
+}
+
+TEST_CASE(rgba16f_to_bgra8_handles_special_values)
+{
+	//Negative, NaN and infinite channels, alpha is never tone mapped.
+	//The first pixel is half transparent, so its infinite channel becomes half of white.
+	uint16_t source[8]{ float_to_half(-1.f), 0x7e00, 0x7c00, float_to_half(0.5f), 0xfc00, float_to_half(0.f), float_to_half(2.f), float_to_half(2.f) };
+	for (auto set : available_sets())
+	{
+		uint8_t destination[8]{};
+		get_kernels(set).rgba16f_to_bgra8(source, destination, 2, 4.f);
+		CHECK(destination[0] == 128);
+		CHECK(destination[1] == 0);
+		CHECK(destination[2] == 0);
+		CHECK(destination[3] == 128);
+		CHECK(destination[4] == expected_srgb(2.f * (1.f + 2.f / 16.f) / 3.f));
+		CHECK(destination[5] == 0);
+		CHECK(destination[6] == 0);
+		CHECK(destination[7] == 255);
+	}
+}
+
+TEST_CASE(f16c_matches_scalar_for_every_half)
+{
+	if (detect_instruction_set() != instruction_set::f16c)
+	{
+		std::printf("  F16C isn't available, skipped.\n");
+		return;
+	}
+
+	//Every half in every channel, with an odd count so the scalar tail runs as well.
+	std::vector<uint16_t> source(0x10000 * 4 + 4);
+	for (uint32_t i = 0; i < source.size(); ++i)
+	{
+		source[i] = static_cast<uint16_t>((i / 4) + (i % 4) * 0x4000);
+	}
+	size_t pixel_count = source.size() / 4;
+
+	for (float white_point : { 1.f, 2.5f, 100.f })
+	{
+		std::vector<uint8_t> scalar(source.size());
+		std::vector<uint8_t> f16c(source.size());
+		get_kernels(instruction_set::scalar).rgba16f_to_bgra8(source.data(), scalar.data(), pixel_count, white_point);
+		get_kernels(instruction_set::f16c).rgba16f_to_bgra8(source.data(), f16c.data(), pixel_count, white_point);
+		CHECK(scalar == f16c);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "test_support.h"
+
+#include "coverage_rasterizer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+//Rasterises a 1920x1080 frame of a thousand mixed fills and strokes, the way
+//vector_shapes does, with each accumulate function. The resolve pass and the
+//geometry cache are also timed on their own.
+
+using namespace path_geometry;
+
+int main()
+{
+	constexpr uint32_t width = 1920;
+	constexpr uint32_t height = 1080;
+	constexpr int shape_count = 1000;
+	constexpr int frame_count = 10;
+
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> x{ 0.f, static_cast<float>(width) };
+	std::uniform_real_distribution<float> y{ 0.f, static_cast<float>(height) };
+	std::uniform_real_distribution<float> size{ 10.f, 120.f };
+
+	std::vector<polygon_set> shapes;
+	for (int i = 0; i < shape_count; ++i)
+	{
+		path p;
+		point centre{ x(random), y(random) };
+		float radius = size(random);
+		switch (i % 3)
+		{
+		case 0:
+			p.add_ellipse(centre, radius, radius * 0.6f);
+			shapes.push_back(fill_outline(flatten(p, 1.f, geometry::default_tolerance)));
+			break;
+		case 1:
+			p.add_rounded_rect({ centre.x - radius, centre.y - radius / 2.f, centre.x + radius, centre.y + radius / 2.f }, radius / 5.f);
+			shapes.push_back(fill_outline(flatten(p, 1.f, geometry::default_tolerance)));
+			break;
+		default:
+			p.move_to(centre).cubic_to({ centre.x + radius, centre.y - radius }, { centre.x + radius, centre.y + radius }, { centre.x + 2.f * radius, centre.y });
+			shapes.push_back(stroke_outline(flatten(p, 1.f, geometry::default_tolerance), 3.f));
+			break;
+		}
+	}
+
+	std::vector<uint8_t> coverage(static_cast<size_t>(width) * height);
+	std::vector<std::pair<const char *, coverage_rasterizer::accumulate_function>> functions{ { "scalar", coverage_rasterizer::accumulate_scalar } };
+	if (auto sse2 = coverage_rasterizer::get_accumulate_sse2())
+	{
+		functions.push_back({ "sse2", sse2 });
+	}
+
+	for (auto [name, function] : functions)
+	{
+		coverage_rasterizer::rasterizer rasterizer{ function };
+		double frame_ms = test_support::time_ms([&]()
+			{
+				for (int frame = 0; frame < frame_count; ++frame)
+				{
+					rasterizer.reset(width, height);
+					for (auto &shape : shapes)
+					{
+						rasterizer.add_polygons(shape, {});
+					}
+					rasterizer.resolve(coverage.data(), width);
+				}
+			});
+
+		rasterizer.reset(width, height);
+		double resolve_ms = test_support::time_ms([&]()
+			{
+				for (int frame = 0; frame < frame_count; ++frame)
+				{
+					rasterizer.resolve(coverage.data(), width);
+				}
+			});
+
+		std::printf("%-6s %u shapes at %ux%u: %.2f ms per frame, resolve alone %.2f ms\n", name, shape_count, width, height, frame_ms / frame_count, resolve_ms / frame_count);
+	}
+
+	//Cached lookups against flattening again, at one scale.
+	constexpr int lookup_count = 100000;
+	path circle;
+	circle.add_ellipse({ 0.f, 0.f }, 50.f, 50.f);
+	geometry cached{ path{ circle } };
+	size_t contours = 0;
+	double cached_ms = test_support::time_ms([&]()
+		{
+			for (int i = 0; i < lookup_count; ++i)
+			{
+				contours += cached.get_fill(1.5f).contours.size();
+			}
+		});
+	double flatten_ms = test_support::time_ms([&]()
+		{
+			for (int i = 0; i < lookup_count / 10; ++i)
+			{
+				contours += fill_outline(flatten(circle, 1.5f, geometry::default_tolerance)).contours.size();
+			}
+		});
+	std::printf("fill lookup %.1f ns cached, %.1f ns flattened\n", cached_ms * 1e6 / lookup_count, flatten_ms * 1e6 / (lookup_count / 10));
+
+	return contours != 0 ? 0 : 1;
+}
\ No newline at end of file
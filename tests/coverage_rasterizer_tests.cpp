@@ -0,0 +1,247 @@
+#include "test_support.h"
+
+#include "coverage_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+using namespace path_geometry;
+
+namespace
+{
+	constexpr float pi = 3.14159265f;
+
+	//Total coverage in pixels.
+	double coverage_area(const std::vector<uint8_t> &coverage)
+	{
+		return std::accumulate(coverage.begin(), coverage.end(), 0.0) / 255.0;
+	}
+
+	std::vector<uint8_t> rasterise(const polygon_set &polygons, uint32_t width, uint32_t height, const transform &t = {}, coverage_rasterizer::accumulate_function accumulate = coverage_rasterizer::get_accumulate())
+	{
+		coverage_rasterizer::rasterizer rasterizer{ accumulate };
+		rasterizer.reset(width, height);
+		rasterizer.add_polygons(polygons, t);
+		std::vector<uint8_t> coverage(static_cast<size_t>(width) * height);
+		rasterizer.resolve(coverage.data(), width);
+		return coverage;
+	}
+
+	polygon_set fill(const path &p)
+	{
+		return fill_outline(flatten(p, 1.f, geometry::default_tolerance));
+	}
+
+	//The signed area of the polygons, positive for clockwise contours in y down coordinates.
+	double polygon_area(const polygon_set &polygons)
+	{
+		double area = 0.0;
+		for (auto &c : polygons.contours)
+		{
+			for (size_t i = 0; i < c.size(); ++i)
+			{
+				auto &a = c[i];
+				auto &b = c[(i + 1) % c.size()];
+				area += (static_cast<double>(a.x) * b.y - static_cast<double>(b.x) * a.y) / 2.0;
+			}
+		}
+		return area;
+	}
+
+	path rect(float left, float top, float right, float bottom)
+	{
+		path p;
+		p.move_to({ left, top }).line_to({ right, top }).line_to({ right, bottom }).line_to({ left, bottom }).close();
+		return p;
+	}
+
+	//The exact overlap of a rectangle with one pixel.
+	double pixel_overlap(float left, float top, float right, float bottom, uint32_t x, uint32_t y)
+	{
+		double width = std::max(0.0, std::min<double>(right, x + 1.0) - std::max<double>(left, x));
+		double height = std::max(0.0, std::min<double>(bottom, y + 1.0) - std::max<double>(top, y));
+		return width * height;
+	}
+}
+
+TEST_CASE(transform_applies_and_scales)
+{
+	transform t{ 2.f, 0.f, 0.f, 3.f, 10.f, 20.f };
+	auto p = t.apply({ 1.f, 1.f });
+	CHECK(p.x == 12.f && p.y == 23.f);
+	CHECK(std::fabs(t.get_scale() - 3.f) < 1e-5f);
+
+	transform rotation{ 0.f, 1.f, -1.f, 0.f, 0.f, 0.f };
+	CHECK(std::fabs(rotation.get_scale() - 1.f) < 1e-5f);
+}
+
+TEST_CASE(flattened_circles_stay_within_tolerance)
+{
+	for (float scale : { 0.25f, 1.f, 8.f })
+	{
+		path circle;
+		circle.add_ellipse({ 0.f, 0.f }, 100.f, 100.f);
+		auto lines = flatten(circle, scale, geometry::default_tolerance);
+		CHECK(lines.size() == 1);
+		CHECK(lines[0].closed);
+
+		auto &points = lines[0].points;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			//Vertices are on the curve, and the middle of each chord is within the tolerance of it.
+			auto &a = points[i];
+			auto &b = points[(i + 1) % points.size()];
+			float radius = std::hypot(a.x, a.y);
+			float middle = std::hypot((a.x + b.x) / 2.f, (a.y + b.y) / 2.f);
+			CHECK(std::fabs(radius - 100.f) <= 100.f * 0.0003f);
+			CHECK((100.f - middle) * scale <= geometry::default_tolerance + 100.f * 0.0003f * scale);
+		}
+	}
+}
+
+TEST_CASE(geometry_caches_by_scale_bucket)
+{
+	path circle;
+	circle.add_ellipse({ 0.f, 0.f }, 10.f, 10.f);
+	geometry shape{ std::move(circle) };
+
+	auto &first = shape.get_fill(1.f);
+	auto &again = shape.get_fill(1.f);
+	CHECK(&first == &again);
+	CHECK(shape.miss_count() == 1);
+	CHECK(shape.hit_count() == 1);
+
+	//Each bucket is flattened for the largest scale in it.
+	for (float scale : { 0.1f, 0.9f, 1.f, 1.1f, 3.7f, 100.f })
+	{
+		CHECK(geometry::bucket_scale(geometry::scale_bucket(scale)) >= scale * 0.9999f);
+		CHECK(geometry::bucket_scale(geometry::scale_bucket(scale)) < scale * 1.19f);
+	}
+
+	shape.get_stroke(1.f, 2.f);
+	shape.get_stroke(1.f, 2.f);
+	shape.get_stroke(1.f, 3.f);
+	CHECK(shape.miss_count() == 3);
+	CHECK(shape.hit_count() == 2);
+}
+
+TEST_CASE(rectangles_match_the_exact_pixel_overlap)
+{
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> position{ -8.f, 40.f };
+	for (int i = 0; i < 200; ++i)
+	{
+		float x0 = position(random);
+		float x1 = position(random);
+		float y0 = position(random);
+		float y1 = position(random);
+		float left = std::min(x0, x1);
+		float right = std::max(x0, x1);
+		float top = std::min(y0, y1);
+		float bottom = std::max(y0, y1);
+
+		//The output is smaller than the range, so some rectangles are clipped at every edge.
+		auto coverage = rasterise(fill(rect(left, top, right, bottom)), 32, 32);
+		for (uint32_t y = 0; y < 32; ++y)
+		{
+			for (uint32_t x = 0; x < 32; ++x)
+			{
+				double expected = pixel_overlap(left, top, right, bottom, x, y) * 255.0;
+				CHECK(std::fabs(coverage[y * 32 + x] - expected) <= 1.0);
+			}
+		}
+	}
+}
+
+TEST_CASE(circle_and_ring_areas_are_accurate)
+{
+	//The coverage matches the flattened polygons to within rounding to 8 bits,
+	//and those are within the flattening tolerance of the true circle.
+	path circle;
+	circle.add_ellipse({ 100.f, 100.f }, 80.f, 80.f);
+	auto circle_polygons = fill(circle);
+	double circle_area = coverage_area(rasterise(circle_polygons, 200, 200));
+	CHECK(std::fabs(circle_area - std::fabs(polygon_area(circle_polygons))) < 1.0);
+	CHECK(std::fabs(circle_area - pi * 80.0 * 80.0) < 2.0 * pi * 80.0 * geometry::default_tolerance);
+
+	//The inner ellipse winds the other way, so it cuts a hole.
+	path ring;
+	ring.add_ellipse({ 100.f, 100.f }, 80.f, 80.f).add_ellipse({ 100.f, 100.f }, 40.f, 40.f, true);
+	auto ring_polygons = fill(ring);
+	auto ring_coverage = rasterise(ring_polygons, 200, 200);
+	double ring_area = coverage_area(ring_coverage);
+	CHECK(std::fabs(ring_area - std::fabs(polygon_area(ring_polygons))) < 1.5);
+	CHECK(std::fabs(ring_area - pi * (80.0 * 80.0 - 40.0 * 40.0)) < 2.0 * pi * 120.0 * geometry::default_tolerance);
+	CHECK(ring_coverage[100 * 200 + 100] == 0);
+	CHECK(ring_coverage[100 * 200 + 40] == 255);
+}
+
+TEST_CASE(same_winding_overlaps_merge)
+{
+	auto polygons = fill(rect(2.f, 2.f, 12.f, 12.f));
+	auto twice = polygons;
+	twice.contours.insert(twice.contours.end(), polygons.contours.begin(), polygons.contours.end());
+
+	auto coverage = rasterise(twice, 16, 16);
+	CHECK(coverage[5 * 16 + 5] == 255);
+	CHECK(std::fabs(coverage_area(coverage) - 100.0) < 0.5);
+}
+
+TEST_CASE(transforms_scale_the_area)
+{
+	//A unit square scaled by 20 and 10 and rotated a quarter turn.
+	transform t{ 0.f, 10.f, -20.f, 0.f, 30.f, 5.f };
+	auto coverage = rasterise(fill(rect(0.f, 0.f, 1.f, 1.f)), 40, 40, t);
+	CHECK(std::fabs(coverage_area(coverage) - 200.0) < 0.5);
+	CHECK(coverage[10 * 40 + 20] == 255);
+}
+
+TEST_CASE(strokes_cover_length_times_width)
+{
+	path line;
+	line.move_to({ 10.f, 20.5f }).line_to({ 90.f, 20.5f });
+	auto stroke = stroke_outline(flatten(line, 1.f, geometry::default_tolerance), 4.f);
+	double area = coverage_area(rasterise(stroke, 100, 40));
+
+	//The ends get half an octagon each, between a square cap and a round one.
+	double body = 80.0 * 4.0;
+	CHECK(area > body + pi * 2.0 * 2.0 * 0.9);
+	CHECK(area < body + 4.0 * 4.0 * 1.01);
+}
+
+TEST_CASE(sse2_matches_scalar)
+{
+	auto sse2 = coverage_rasterizer::get_accumulate_sse2();
+	if (!sse2)
+	{
+		std::printf("  SSE2 isn't available, skipped.\n");
+		return;
+	}
+
+	path shapes;
+	shapes.add_ellipse({ 61.3f, 47.9f }, 50.2f, 33.1f).add_rounded_rect({ 5.5f, 60.25f, 113.f, 97.7f }, 9.f);
+	auto polygons = fill(shapes);
+	//Odd widths leave a tail after the last group of four.
+	for (uint32_t width : { 117u, 120u, 123u })
+	{
+		auto scalar = rasterise(polygons, width, 100, {}, coverage_rasterizer::accumulate_scalar);
+		auto vector = rasterise(polygons, width, 100, {}, sse2);
+		for (size_t i = 0; i < scalar.size(); ++i)
+		{
+			CHECK(std::abs(scalar[i] - vector[i]) <= 1);
+		}
+	}
+}
+
+TEST_CASE(resolve_leaves_the_rasterizer_cleared)
+{
+	coverage_rasterizer::rasterizer rasterizer;
+	rasterizer.reset(16, 16);
+	rasterizer.add_polygons(fill(rect(1.f, 1.f, 9.f, 9.f)), {});
+	std::vector<uint8_t> coverage(16 * 16);
+	rasterizer.resolve(coverage.data(), 16);
+	rasterizer.resolve(coverage.data(), 16);
+	CHECK(coverage_area(coverage) == 0.0);
+}
\ No newline at end of file
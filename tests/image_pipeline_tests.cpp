@@ -0,0 +1,321 @@
+#include "test_support.h"
+
+#include "image_pipeline.h"
+
+#include <atomic>
+#include <fstream>
+#include <string_view>
+
+using namespace image_pipeline;
+
+namespace
+{
+	std::vector<uint8_t> bytes(std::string_view text)
+	{
+		return { text.begin(), text.end() };
+	}
+
+	void append(std::vector<uint8_t> &data, std::initializer_list<int> values)
+	{
+		for (auto value : values)
+		{
+			data.push_back(static_cast<uint8_t>(value));
+		}
+	}
+
+	std::vector<uint8_t> qoi_header(uint32_t width, uint32_t height)
+	{
+		auto data = bytes("qoif");
+		append(data, { int(width >> 24), int(width >> 16 & 0xff), int(width >> 8 & 0xff), int(width & 0xff) });
+		append(data, { int(height >> 24), int(height >> 16 & 0xff), int(height >> 8 & 0xff), int(height & 0xff) });
+		append(data, { 4, 0 });
+		return data;
+	}
+
+	void qoi_end(std::vector<uint8_t> &data)
+	{
+		append(data, { 0, 0, 0, 0, 0, 0, 0, 1 });
+	}
+
+	//Checks a premultiplied BGRA pixel.
+	bool pixel_is(const decoded_image &image, uint32_t x, uint32_t y, uint8_t b, uint8_t g, uint8_t r, uint8_t a)
+	{
+		const uint8_t *pixel = image.pixels.data() + static_cast<size_t>(y) * image.stride + static_cast<size_t>(x) * 4;
+		return pixel[0] == b && pixel[1] == g && pixel[2] == r && pixel[3] == a;
+	}
+
+	std::filesystem::path write_temp_file(const std::string &name, const std::vector<uint8_t> &data)
+	{
+		auto path = std::filesystem::temp_directory_path() / name;
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+		return path;
+	}
+
+	image_ptr make_image(uint32_t width, uint32_t height)
+	{
+		auto image = std::make_shared<decoded_image>();
+		image->size = { width, height };
+		image->stride = width * 4;
+		image->pixels.resize(static_cast<size_t>(image->stride) * height);
+		return image;
+	}
+
+	//Counts decodes and can hold them until released, so requests can overlap.
+	class counting_decoder : public image_decoder
+	{
+	public:
+		bool can_decode(std::span<const uint8_t> data) const override
+		{
+			return !data.empty() && data[0] == 'C';
+		}
+
+		decoded_image decode(std::span<const uint8_t>, const image_size &target) const override
+		{
+			while (!released.load())
+			{
+				std::this_thread::yield();
+			}
+			++decodes;
+			return *make_image(target.width, target.height);
+		}
+
+		mutable std::atomic<int> decodes{};
+		std::atomic<bool> released{};
+	};
+}
+
+TEST_CASE(fit_size_keeps_aspect_ratio)
+{
+	CHECK((fit_size({ 400, 200 }, { 100, 100 }) == image_size{ 100, 50 }));
+	CHECK((fit_size({ 200, 400 }, { 100, 0 }) == image_size{ 100, 200 }));
+	CHECK((fit_size({ 200, 400 }, { 0, 0 }) == image_size{ 200, 400 }));
+	//Never scaled up, and never down to nothing.
+	CHECK((fit_size({ 50, 50 }, { 100, 100 }) == image_size{ 50, 50 }));
+	CHECK((fit_size({ 1000, 1 }, { 10, 10 }) == image_size{ 10, 1 }));
+}
+
+TEST_CASE(ppm_decodes_8_bit_with_comments)
+{
+	auto data = bytes("P6\n# a comment\n2 1 # another\n255\n");
+	append(data, { 255, 0, 0, 10, 20, 30 });
+
+	ppm_decoder decoder;
+	CHECK(decoder.can_decode(data));
+	auto image = decoder.decode(data, {});
+
+	CHECK((image.size == image_size{ 2, 1 }));
+	CHECK(image.stride == 8);
+	CHECK(pixel_is(image, 0, 0, 0, 0, 255, 255));
+	CHECK(pixel_is(image, 1, 0, 30, 20, 10, 255));
+}
+
+TEST_CASE(ppm_decodes_16_bit)
+{
+	auto data = bytes("P6 1 1 65535\n");
+	append(data, { 0xff, 0xff, 0x80, 0x00, 0x00, 0x00 });
+
+	auto image = ppm_decoder{}.decode(data, {});
+	CHECK(pixel_is(image, 0, 0, 0, 128, 255, 255));
+}
+
+TEST_CASE(ppm_scales_small_maximum_values)
+{
+	auto data = bytes("P6 1 1 15\n");
+	append(data, { 15, 0, 7 });
+
+	auto image = ppm_decoder{}.decode(data, {});
+	CHECK(pixel_is(image, 0, 0, 119, 0, 255, 255));
+}
+
+TEST_CASE(ppm_rejects_malformed_data)
+{
+	ppm_decoder decoder;
+
+	auto truncated = bytes("P6 2 2 255\n");
+	append(truncated, { 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+	CHECK_THROWS(decoder.decode(truncated, {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 2"), {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 x 1 255\n"), {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 1 1 0\n\0\0\0"), {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 0 1 255\n"), {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 40000 1 255\n"), {}));
+	CHECK_THROWS(decoder.decode(bytes("P6 99999999999 1 255\n"), {}));
+	CHECK(!decoder.can_decode(bytes("P3 1 1 255\n")));
+}
+
+TEST_CASE(ppm_downsamples_by_averaging)
+{
+	//A 4x2 image down to 2x1, each output pixel averages a 2x2 block.
+	auto data = bytes("P6 4 2 255\n");
+	append(data, { 0, 0, 0, 100, 100, 100, 255, 0, 0, 255, 0, 0 });
+	append(data, { 100, 100, 100, 0, 0, 0, 0, 0, 255, 0, 0, 255 });
+
+	auto image = ppm_decoder{}.decode(data, { 2, 1 });
+	CHECK((image.size == image_size{ 2, 1 }));
+	CHECK(pixel_is(image, 0, 0, 50, 50, 50, 255));
+	CHECK(pixel_is(image, 1, 0, 128, 0, 128, 255));
+}
+
+TEST_CASE(qoi_decodes_every_op)
+{
+	auto data = qoi_header(6, 1);
+	//RGBA, then a diff of (+1, -1, 0).
+	append(data, { 0xff, 10, 20, 30, 255 });
+	append(data, { 0x76 });
+	//Luma with a green delta of 5, red 6 and blue 3.
+	append(data, { 0xa5, 0x96 });
+	//Index of the first pixel, which hashes to 9.
+	append(data, { 0x09 });
+	//RGB, then a run of one more.
+	append(data, { 0xfe, 1, 2, 3 });
+	append(data, { 0xc0 });
+	qoi_end(data);
+
+	qoi_decoder decoder;
+	CHECK(decoder.can_decode(data));
+	auto image = decoder.decode(data, {});
+
+	CHECK((image.size == image_size{ 6, 1 }));
+	CHECK(pixel_is(image, 0, 0, 30, 20, 10, 255));
+	CHECK(pixel_is(image, 1, 0, 30, 19, 11, 255));
+	CHECK(pixel_is(image, 2, 0, 33, 24, 17, 255));
+	CHECK(pixel_is(image, 3, 0, 30, 20, 10, 255));
+	CHECK(pixel_is(image, 4, 0, 3, 2, 1, 255));
+	CHECK(pixel_is(image, 5, 0, 3, 2, 1, 255));
+}
+
+TEST_CASE(qoi_premultiplies_alpha)
+{
+	auto data = qoi_header(2, 1);
+	append(data, { 0xff, 200, 100, 50, 128 });
+	append(data, { 0xff, 255, 255, 255, 0 });
+	qoi_end(data);
+
+	auto image = qoi_decoder{}.decode(data, {});
+	CHECK(pixel_is(image, 0, 0, 25, 50, 100, 128));
+	CHECK(pixel_is(image, 1, 0, 0, 0, 0, 0));
+}
+
+TEST_CASE(qoi_rejects_truncated_data)
+{
+	qoi_decoder decoder;
+
+	auto missing_pixels = qoi_header(4, 1);
+	append(missing_pixels, { 0xfe, 1, 2, 3 });
+	qoi_end(missing_pixels);
+	CHECK_THROWS(decoder.decode(missing_pixels, {}));
+
+	auto short_op = qoi_header(1, 1);
+	append(short_op, { 0xff, 1, 2 });
+	qoi_end(short_op);
+	CHECK_THROWS(decoder.decode(short_op, {}));
+
+	CHECK_THROWS(decoder.decode(bytes("qoif"), {}));
+	CHECK(!decoder.can_decode(bytes("qoi")));
+}
+
+TEST_CASE(bitmap_cache_evicts_least_recently_used)
+{
+	//Each 16x16 image is 1KB.
+	bitmap_cache cache{ 3 * 1024 };
+	cache.insert(L"a", make_image(16, 16));
+	cache.insert(L"b", make_image(16, 16));
+	cache.insert(L"c", make_image(16, 16));
+	CHECK(cache.entry_count() == 3);
+	CHECK(cache.size_bytes() == 3 * 1024);
+
+	//Touching a makes b the oldest.
+	CHECK(cache.find(L"a"));
+	cache.insert(L"d", make_image(16, 16));
+
+	CHECK(cache.entry_count() == 3);
+	CHECK(!cache.find(L"b"));
+	CHECK(cache.find(L"a"));
+	CHECK(cache.find(L"c"));
+	CHECK(cache.find(L"d"));
+}
+
+TEST_CASE(bitmap_cache_replaces_existing_keys)
+{
+	bitmap_cache cache{ 1024 * 1024 };
+	cache.insert(L"a", make_image(16, 16));
+	auto replacement = make_image(32, 32);
+	cache.insert(L"a", replacement);
+
+	CHECK(cache.entry_count() == 1);
+	CHECK(cache.size_bytes() == 4096);
+	CHECK(cache.find(L"a") == replacement);
+}
+
+TEST_CASE(bitmap_cache_keeps_newest_oversized_entry)
+{
+	bitmap_cache cache{ 1024 };
+	cache.insert(L"a", make_image(16, 16));
+	cache.insert(L"big", make_image(64, 64));
+
+	CHECK(cache.entry_count() == 1);
+	CHECK(cache.find(L"big"));
+	CHECK(!cache.find(L"a"));
+}
+
+TEST_CASE(pipeline_decodes_caches_and_deduplicates)
+{
+	auto path = write_temp_file("uitest_pipeline_counting.bin", bytes("C"));
+
+	task_executor::task_executor executor{ 1 };
+	std::vector<std::unique_ptr<image_decoder>> decoders;
+	auto counting = std::make_unique<counting_decoder>();
+	auto &decoder = *counting;
+	decoders.push_back(std::move(counting));
+	image_pipeline::image_pipeline pipeline{ std::move(decoders), executor };
+
+	//The decoder is held, so the second request finds the first still in flight.
+	auto first = pipeline.request(path, { 8, 8 });
+	auto second = pipeline.request(path, { 8, 8 });
+	decoder.released = true;
+
+	CHECK(first.get() == second.get());
+	CHECK((first.get()->size == image_size{ 8, 8 }));
+
+	auto third = pipeline.request(path, { 8, 8 });
+	CHECK(third.get() == first.get());
+
+	//A different target size is a different image.
+	auto other = pipeline.request(path, { 4, 4 });
+	CHECK((other.get()->size == image_size{ 4, 4 }));
+
+	auto stats = pipeline.get_cache_stats();
+	CHECK(decoder.decodes == 2);
+	CHECK(stats.misses == 2);
+	CHECK(stats.deduplicated == 1);
+	CHECK(stats.hits == 1);
+	CHECK(stats.entry_count == 2);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE(pipeline_reports_failures_through_the_future)
+{
+	auto ppm = bytes("P6 1 1 255\n");
+	append(ppm, { 1, 2, 3 });
+	auto good = write_temp_file("uitest_pipeline_good.ppm", ppm);
+	auto unknown = write_temp_file("uitest_pipeline_unknown.bin", bytes("XYZ"));
+	auto missing = std::filesystem::temp_directory_path() / "uitest_pipeline_missing.ppm";
+	std::filesystem::remove(missing);
+
+	task_executor::task_executor executor{ 1 };
+	std::vector<std::unique_ptr<image_decoder>> decoders;
+	decoders.push_back(std::make_unique<ppm_decoder>());
+	decoders.push_back(std::make_unique<qoi_decoder>());
+	image_pipeline::image_pipeline pipeline{ std::move(decoders), executor };
+
+	CHECK(pixel_is(*pipeline.request(good, {}).get(), 0, 0, 3, 2, 1, 255));
+	CHECK_THROWS(pipeline.request(unknown, {}).get());
+	CHECK_THROWS(pipeline.request(missing, {}).get());
+	//Failures aren't cached.
+	CHECK(pipeline.get_cache_stats().entry_count == 1);
+
+	std::filesystem::remove(good);
+	std::filesystem::remove(unknown);
+}
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "test_support.h"
+
+#include "session_log.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace session_log;
+
+namespace
+{
+	using std::chrono::microseconds;
+
+	std::filesystem::path temp_path(const std::string &name)
+	{
+		return std::filesystem::temp_directory_path() / name;
+	}
+
+	void write_file(const std::filesystem::path &path, const std::vector<uint8_t> &data)
+	{
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+	}
+
+	//The header followed by the given event bytes.
+	std::vector<uint8_t> make_log(std::initializer_list<uint8_t> events, uint32_t version = 1)
+	{
+		std::vector<uint8_t> data;
+		for (auto value : { uint32_t{ 0x4c535549 }, version })
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+			}
+		}
+		data.insert(data.end(), events);
+		return data;
+	}
+
+	std::vector<event> read_bytes(const std::vector<uint8_t> &data)
+	{
+		auto path = temp_path("uitest_session_bytes.log");
+		write_file(path, data);
+		auto events = read_log(path);
+		std::filesystem::remove(path);
+		return events;
+	}
+
+	bool throws_on_read(const std::vector<uint8_t> &data)
+	{
+		auto path = temp_path("uitest_session_bytes.log");
+		write_file(path, data);
+		bool threw = false;
+		try
+		{
+			read_log(path);
+		}
+		catch (const std::runtime_error &)
+		{
+			threw = true;
+		}
+		std::filesystem::remove(path);
+		return threw;
+	}
+
+	//A resize to 1920 by 1080 at 300us, then a tick 16667us later.
+	//Every number takes more than one LEB128 byte.
+	const std::initializer_list<uint8_t> known_events{
+		1, 0xac, 0x02, 0x80, 0x0f, 0xb8, 0x08,
+		4, 0x9b, 0x82, 0x01
+	};
+	constexpr size_t header_size = 8;
+	constexpr size_t resize_size = 7;
+
+	event make_event(event_type type, int64_t time_ms, client_size dimentions = {})
+	{
+		return { type, std::chrono::milliseconds{ time_ms }, dimentions };
+	}
+
+	//Draws nothing while minimised, like draw_interface.
+	class fake_target : public replay_target
+	{
+	public:
+		void resize(const client_size &dimentions) override
+		{
+			resizes.push_back(dimentions);
+			minimised = false;
+		}
+
+		void minimize() override
+		{
+			++minimise_count;
+			minimised = true;
+		}
+
+		bool update_frame() override
+		{
+			++update_count;
+			return !minimised;
+		}
+
+		void set_present_interval(uint32_t interval) override
+		{
+			present_intervals.push_back(interval);
+		}
+
+		std::vector<client_size> resizes;
+		std::vector<uint32_t> present_intervals;
+		int minimise_count = 0;
+		int update_count = 0;
+		bool minimised = false;
+	};
+}
+
+TEST_CASE(recorded_events_read_back)
+{
+	auto path = temp_path("uitest_session_round_trip.log");
+	{
+		recorder log{ path };
+		log.record_resize({ 640, 480 });
+		log.record_tick();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+		log.record_tick();
+		log.record_minimize();
+		//Negative sizes are recorded as zero.
+		log.record_resize({ -5, 20 });
+		log.record_close();
+	}
+
+	auto events = read_log(path);
+	std::filesystem::remove(path);
+
+	CHECK(events.size() == 6);
+	CHECK(events[0].type == event_type::resize);
+	CHECK(events[0].dimentions.width == 640 && events[0].dimentions.height == 480);
+	CHECK(events[1].type == event_type::tick);
+	CHECK(events[2].type == event_type::tick);
+	CHECK(events[3].type == event_type::minimize);
+	CHECK(events[4].type == event_type::resize);
+	CHECK(events[4].dimentions.width == 0 && events[4].dimentions.height == 20);
+	CHECK(events[5].type == event_type::close);
+
+	CHECK(events[0].time >= microseconds{});
+	for (size_t i = 1; i < events.size(); ++i)
+	{
+		CHECK(events[i].time >= events[i - 1].time);
+	}
+	CHECK(events[2].time - events[1].time >= std::chrono::milliseconds{ 2 });
+}
+
+TEST_CASE(long_recordings_survive_buffer_flushes)
+{
+	//Each tick is at least two bytes, so this goes through the write buffer more than once.
+	constexpr size_t tick_count = 100'000;
+	auto path = temp_path("uitest_session_long.log");
+	{
+		recorder log{ path };
+		log.record_resize({ 100, 100 });
+		for (size_t i = 0; i < tick_count; ++i)
+		{
+			log.record_tick();
+		}
+	}
+
+	auto events = read_log(path);
+	std::filesystem::remove(path);
+
+	CHECK(events.size() == tick_count + 1);
+	CHECK(std::all_of(events.begin() + 1, events.end(), [](const event &e)
+		{
+			return e.type == event_type::tick;
+		}));
+}
+
+TEST_CASE(known_bytes_decode_exactly)
+{
+	auto events = read_bytes(make_log(known_events));
+	CHECK(events.size() == 2);
+	CHECK(events[0].type == event_type::resize);
+	CHECK(events[0].time == microseconds{ 300 });
+	CHECK(events[0].dimentions.width == 1920 && events[0].dimentions.height == 1080);
+	CHECK(events[1].type == event_type::tick);
+	CHECK(events[1].time == microseconds{ 16967 });
+
+	//Just the header is an empty log.
+	CHECK(read_bytes(make_log({})).empty());
+}
+
+TEST_CASE(truncated_logs_are_rejected)
+{
+	auto full = make_log(known_events);
+	for (size_t length = 0; length < full.size(); ++length)
+	{
+		std::vector<uint8_t> truncated{ full.begin(), full.begin() + static_cast<std::ptrdiff_t>(length) };
+		//A log cut off between events is still valid, it just ends early.
+		if (length == header_size)
+		{
+			CHECK(read_bytes(truncated).empty());
+		}
+		else if (length == header_size + resize_size)
+		{
+			CHECK(read_bytes(truncated).size() == 1);
+		}
+		else
+		{
+			CHECK(throws_on_read(truncated));
+		}
+	}
+}
+
+TEST_CASE(corrupt_logs_are_rejected)
+{
+	auto bad_magic = make_log(known_events);
+	bad_magic[0] ^= 0xff;
+	CHECK(throws_on_read(bad_magic));
+	CHECK(throws_on_read(make_log(known_events, 2)));
+
+	//Unknown event types.
+	CHECK(throws_on_read(make_log({ 0, 0 })));
+	CHECK(throws_on_read(make_log({ 5, 0 })));
+
+	//16385 is past the largest swap chain.
+	CHECK(throws_on_read(make_log({ 1, 0, 0x81, 0x80, 0x01, 1 })));
+	CHECK(read_bytes(make_log({ 1, 0, 0x80, 0x80, 0x01, 1 }))[0].dimentions.width == 16384);
+
+	//A value that never ends within 64 bits.
+	CHECK(throws_on_read(make_log({ 4, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 })));
+
+	auto missing = temp_path("uitest_session_missing.log");
+	std::filesystem::remove(missing);
+	CHECK_THROWS(read_log(missing));
+}
+
+TEST_CASE(percentiles_of_a_known_distribution)
+{
+	//0 to 100 in a random order, so each percentile is its own value.
+	std::vector<double> frame_times;
+	for (int i = 0; i <= 100; ++i)
+	{
+		frame_times.push_back(static_cast<double>(i));
+	}
+	std::shuffle(frame_times.begin(), frame_times.end(), std::mt19937{ 42 });
+
+	replay_stats stats{};
+	summarise_frame_times(frame_times, stats);
+	CHECK(std::is_sorted(frame_times.begin(), frame_times.end()));
+	CHECK(stats.frame_count == 101);
+	CHECK(stats.frame_min == 0.);
+	CHECK(stats.frame_max == 100.);
+	CHECK(stats.frame_mean == 50.);
+	CHECK(stats.frame_p50 == 50.);
+	CHECK(stats.frame_p95 == 95.);
+	CHECK(stats.frame_p99 == 99.);
+
+	//1 to 20, where the percentiles fall between samples and go to the nearest one.
+	frame_times.clear();
+	for (int i = 20; i >= 1; --i)
+	{
+		frame_times.push_back(static_cast<double>(i));
+	}
+	stats = {};
+	summarise_frame_times(frame_times, stats);
+	CHECK(stats.frame_mean == 10.5);
+	CHECK(stats.frame_p50 == 11.);
+	CHECK(stats.frame_p95 == 19.);
+	CHECK(stats.frame_p99 == 20.);
+
+	//A single frame is every percentile.
+	frame_times = { 4.25 };
+	stats = {};
+	summarise_frame_times(frame_times, stats);
+	CHECK(stats.frame_min == 4.25 && stats.frame_max == 4.25 && stats.frame_mean == 4.25);
+	CHECK(stats.frame_p50 == 4.25 && stats.frame_p95 == 4.25 && stats.frame_p99 == 4.25);
+
+	frame_times.clear();
+	stats = {};
+	summarise_frame_times(frame_times, stats);
+	CHECK(stats.frame_count == 0);
+	CHECK(stats.frame_max == 0.);
+}
+
+TEST_CASE(player_replays_until_the_close)
+{
+	fake_target target;
+	std::vector<event> events{
+		make_event(event_type::resize, 0, { 800, 600 }),
+		make_event(event_type::tick, 10),
+		make_event(event_type::minimize, 20),
+		make_event(event_type::tick, 30),
+		make_event(event_type::resize, 40, { 400, 300 }),
+		make_event(event_type::tick, 50),
+		make_event(event_type::close, 60),
+		make_event(event_type::tick, 70)
+	};
+
+	player replay{ std::move(events), target, replay_timing::fast };
+	CHECK(target.present_intervals == std::vector<uint32_t>{ 0 });
+
+	int steps = 0;
+	while (replay.step())
+	{
+		CHECK(replay.next_delay() == microseconds{});
+		++steps;
+	}
+	CHECK(steps == 6);
+	CHECK(!replay.step());
+
+	//The tick after the close is never sent.
+	CHECK(target.update_count == 3);
+	CHECK(target.minimise_count == 1);
+	CHECK(target.resizes.size() == 2);
+	CHECK(target.resizes[1].width == 400 && target.resizes[1].height == 300);
+	CHECK((target.present_intervals == std::vector<uint32_t>{ 0, 1 }));
+
+	auto stats = replay.get_stats();
+	CHECK(stats.frame_count == 2);
+	CHECK(stats.skipped_count == 1);
+	CHECK(stats.resize_count == 2);
+	CHECK(stats.minimize_count == 1);
+	CHECK(stats.frame_min <= stats.frame_p50 && stats.frame_p50 <= stats.frame_max);
+}
+
+TEST_CASE(original_timing_waits_for_each_event)
+{
+	fake_target target;
+	std::vector<event> events{
+		make_event(event_type::resize, 0, { 800, 600 }),
+		make_event(event_type::tick, 1000)
+	};
+
+	player replay{ std::move(events), target, replay_timing::original };
+	CHECK(target.present_intervals == std::vector<uint32_t>{ 1 });
+	CHECK(replay.next_delay() == microseconds{});
+
+	CHECK(replay.step());
+	auto delay = replay.next_delay();
+	CHECK(delay > microseconds{});
+	CHECK(delay <= std::chrono::seconds{ 1 });
+
+	CHECK(replay.step());
+	//Nothing left to wait for.
+	CHECK(replay.next_delay() == microseconds{});
+	CHECK(!replay.step());
+	CHECK(replay.get_stats().frame_count == 1);
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "test_support.h"
+
+#include "spatial_index.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//Compares the R-tree against a linear scan for the queries a canvas makes:
+//visibility of a viewport sized rectangle and hit testing the pointer.
+//The element count can be given on the command line, the default is 100000.
+
+using namespace spatial_index;
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	constexpr int query_count = 10000;
+	//Spread the elements over a square with roughly a hundred per viewport.
+	float extent = std::sqrt(static_cast<float>(count)) * 100.f;
+
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> position{ 0.f, extent };
+	std::uniform_real_distribution<float> size{ 10.f, 120.f };
+	std::uniform_int_distribution<int32_t> depth{ 0, 8 };
+
+	std::vector<entry> entries;
+	entries.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float x = position(random);
+		float y = position(random);
+		entries.push_back({ { x, y, x + size(random), y + size(random) }, static_cast<element_id>(i), depth(random) });
+	}
+
+	std::vector<std::pair<float, float>> points(query_count);
+	for (auto &point : points)
+	{
+		point = { position(random), position(random) };
+	}
+
+	rtree loaded;
+	double bulk_ms = test_support::time_ms([&]()
+		{
+			loaded.bulk_load(std::vector<entry>{ entries });
+		});
+
+	rtree inserted;
+	double insert_ms = test_support::time_ms([&]()
+		{
+			for (auto &e : entries)
+			{
+				inserted.insert(e);
+			}
+		});
+
+	std::vector<entry> found;
+	size_t tree_found = 0;
+	double tree_rect_ms = test_support::time_ms([&]()
+		{
+			for (auto [x, y] : points)
+			{
+				found.clear();
+				loaded.query_rect({ x, y, x + 1000.f, y + 1000.f }, found);
+				tree_found += found.size();
+			}
+		});
+
+	size_t scan_found = 0;
+	double scan_rect_ms = test_support::time_ms([&]()
+		{
+			for (auto [x, y] : points)
+			{
+				bounds box{ x, y, x + 1000.f, y + 1000.f };
+				for (auto &e : entries)
+				{
+					scan_found += e.box.intersects(box);
+				}
+			}
+		});
+
+	size_t hits = 0;
+	double tree_hit_ms = test_support::time_ms([&]()
+		{
+			for (auto [x, y] : points)
+			{
+				hits += loaded.hit_test(x, y).has_value();
+			}
+		});
+
+	double update_ms = test_support::time_ms([&]()
+		{
+			for (size_t i = 0; i < static_cast<size_t>(query_count) && i < entries.size(); ++i)
+			{
+				auto moved = entries[i];
+				moved.box.left += 50.f;
+				moved.box.right += 50.f;
+				loaded.update(moved.id, entries[i].box, moved);
+			}
+		});
+
+	std::printf("%zu elements\n", count);
+	std::printf("bulk load            %9.2f ms\n", bulk_ms);
+	std::printf("insert one at a time %9.2f ms\n", insert_ms);
+	std::printf("%d viewport queries: tree %.2f ms, linear scan %.2f ms, %.1fx (%zu and %zu found)\n", query_count, tree_rect_ms, scan_rect_ms, scan_rect_ms / tree_rect_ms, tree_found, scan_found);
+	std::printf("%d hit tests         %9.2f ms (%zu hits)\n", query_count, tree_hit_ms, hits);
+	std::printf("%d updates           %9.2f ms\n", query_count, update_ms);
+
+	return tree_found == scan_found ? 0 : 1;
+}
\ No newline at end of file
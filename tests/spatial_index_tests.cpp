@@ -0,0 +1,195 @@
+#include "test_support.h"
+
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace spatial_index;
+
+namespace
+{
+	std::vector<entry> random_entries(size_t count, uint32_t seed)
+	{
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> position{ 0.f, 1000.f };
+		std::uniform_real_distribution<float> extent{ 1.f, 40.f };
+		std::uniform_int_distribution<int32_t> depth{ 0, 8 };
+
+		std::vector<entry> entries;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float x = position(random);
+			float y = position(random);
+			entries.push_back({ { x, y, x + extent(random), y + extent(random) }, static_cast<element_id>(i), depth(random) });
+		}
+		return entries;
+	}
+
+	std::vector<element_id> sorted_ids(const std::vector<entry> &entries)
+	{
+		std::vector<element_id> ids;
+		for (auto &e : entries)
+		{
+			ids.push_back(e.id);
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	std::vector<element_id> brute_force_rect(const std::vector<entry> &entries, const bounds &box)
+	{
+		std::vector<entry> found;
+		std::copy_if(entries.begin(), entries.end(), std::back_inserter(found), [&box](const entry &e)
+			{
+				return e.box.intersects(box);
+			});
+		return sorted_ids(found);
+	}
+
+	std::optional<entry> brute_force_hit(const std::vector<entry> &entries, float x, float y, const hit_filter &filter)
+	{
+		std::optional<entry> top;
+		for (auto &e : entries)
+		{
+			if (e.box.contains(x, y) && (!filter || filter(e)) && (!top || e.z > top->z || (e.z == top->z && e.id > top->id)))
+			{
+				top = e;
+			}
+		}
+		return top;
+	}
+
+	void check_matches(const rtree &tree, const std::vector<entry> &entries, uint32_t seed)
+	{
+		CHECK(tree.size() == entries.size());
+
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> position{ -50.f, 1050.f };
+		std::uniform_real_distribution<float> extent{ 0.f, 200.f };
+		hit_filter odd_only = [](const entry &e)
+		{
+			return (e.id & 1) != 0;
+		};
+
+		std::vector<entry> found;
+		for (int i = 0; i < 200; ++i)
+		{
+			float x = position(random);
+			float y = position(random);
+			bounds box{ x, y, x + extent(random), y + extent(random) };
+
+			found.clear();
+			tree.query_rect(box, found);
+			CHECK(sorted_ids(found) == brute_force_rect(entries, box));
+
+			found.clear();
+			tree.query_point(x, y, found);
+			CHECK(sorted_ids(found) == brute_force_rect(entries, { x, y, std::nextafter(x, 2000.f), std::nextafter(y, 2000.f) }));
+
+			auto hit = tree.hit_test(x, y);
+			auto expected = brute_force_hit(entries, x, y, {});
+			CHECK(hit.has_value() == expected.has_value());
+			CHECK((!hit || hit->id == expected->id));
+
+			auto filtered = tree.hit_test(x, y, odd_only);
+			auto expected_filtered = brute_force_hit(entries, x, y, odd_only);
+			CHECK(filtered.has_value() == expected_filtered.has_value());
+			CHECK((!filtered || filtered->id == expected_filtered->id));
+		}
+	}
+}
+
+TEST_CASE(bounds_edges_are_half_open)
+{
+	bounds box{ 0.f, 0.f, 10.f, 10.f };
+	CHECK(box.contains(0.f, 0.f));
+	CHECK(!box.contains(10.f, 5.f));
+	CHECK(!box.contains(5.f, 10.f));
+	CHECK(box.intersects({ 9.f, 9.f, 20.f, 20.f }));
+	CHECK(!box.intersects({ 10.f, 0.f, 20.f, 10.f }));
+}
+
+TEST_CASE(empty_tree_finds_nothing)
+{
+	rtree tree;
+	std::vector<entry> found;
+	tree.query_rect({ 0.f, 0.f, 100.f, 100.f }, found);
+	CHECK(found.empty());
+	CHECK(!tree.hit_test(1.f, 1.f));
+	CHECK(!tree.remove(0, { 0.f, 0.f, 1.f, 1.f }));
+	CHECK(tree.size() == 0);
+}
+
+TEST_CASE(bulk_load_matches_brute_force)
+{
+	auto entries = random_entries(5000, 1);
+	rtree tree;
+	tree.bulk_load(std::vector<entry>{ entries });
+	check_matches(tree, entries, 2);
+}
+
+TEST_CASE(insert_matches_brute_force)
+{
+	auto entries = random_entries(5000, 3);
+	rtree tree;
+	for (auto &e : entries)
+	{
+		tree.insert(e);
+	}
+	check_matches(tree, entries, 4);
+}
+
+TEST_CASE(remove_and_update_keep_the_tree_consistent)
+{
+	auto entries = random_entries(3000, 5);
+	rtree tree;
+	tree.bulk_load(std::vector<entry>{ entries });
+
+	//Removing most of the elements forces underfull nodes to be merged back.
+	std::mt19937 random{ 6 };
+	std::shuffle(entries.begin(), entries.end(), random);
+	for (size_t i = 0; i < 2000; ++i)
+	{
+		CHECK(tree.remove(entries.back().id, entries.back().box));
+		entries.pop_back();
+	}
+	check_matches(tree, entries, 7);
+
+	//A remove with the wrong bounds finds nothing.
+	CHECK(!tree.remove(entries.front().id, { -10.f, -10.f, -5.f, -5.f }));
+
+	std::uniform_real_distribution<float> shift{ -100.f, 100.f };
+	for (auto &e : entries)
+	{
+		entry moved = e;
+		float dx = shift(random);
+		float dy = shift(random);
+		moved.box = { e.box.left + dx, e.box.top + dy, e.box.right + dx, e.box.bottom + dy };
+		CHECK(tree.update(e.id, e.box, moved));
+		e = moved;
+	}
+	check_matches(tree, entries, 8);
+
+	tree.clear();
+	CHECK(tree.size() == 0);
+	CHECK(!tree.hit_test(500.f, 500.f));
+}
+
+TEST_CASE(hit_test_prefers_higher_z_then_higher_id)
+{
+	rtree tree;
+	tree.insert({ { 0.f, 0.f, 10.f, 10.f }, 1, 5 });
+	tree.insert({ { 0.f, 0.f, 10.f, 10.f }, 2, 3 });
+	tree.insert({ { 0.f, 0.f, 10.f, 10.f }, 3, 5 });
+
+	CHECK(tree.hit_test(5.f, 5.f)->id == 3);
+	CHECK(tree.hit_test(5.f, 5.f, [](const entry &e)
+		{
+			return e.id != 3;
+		})->id == 1);
+	CHECK(!tree.hit_test(5.f, 5.f, [](const entry &)
+		{
+			return false;
+		}));
+}
\ No newline at end of file
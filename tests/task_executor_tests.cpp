@@ -0,0 +1,284 @@
+#include "test_support.h"
+
+#include "task_executor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace task_executor;
+
+namespace
+{
+	//Waits for a number of things to finish on other threads.
+	class countdown
+	{
+	public:
+		explicit countdown(size_t count) : m_count{ count }
+		{
+		}
+
+		void signal()
+		{
+			std::scoped_lock lock{ m_lock };
+			if (--m_count == 0)
+			{
+				m_done.notify_all();
+			}
+		}
+
+		bool wait()
+		{
+			std::unique_lock lock{ m_lock };
+			return m_done.wait_for(lock, std::chrono::seconds{ 10 }, [this]()
+				{
+					return m_count == 0;
+				});
+		}
+
+	private:
+		std::mutex m_lock;
+		std::condition_variable m_done;
+		size_t m_count;
+	};
+
+	//The smallest coroutine type that can co_await the executor, it starts
+	//straight away and its frame is freed when it finishes.
+	struct detached
+	{
+		struct promise_type
+		{
+			detached get_return_object()
+			{
+				return {};
+			}
+
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void()
+			{
+			}
+
+			void unhandled_exception()
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	detached resume_on_executor(task_executor::task_executor &executor, task_priority priority, std::thread::id &resumed_on, countdown &done)
+	{
+		co_await executor.schedule(priority);
+		resumed_on = std::this_thread::get_id();
+		done.signal();
+	}
+
+	detached hop_twice(task_executor::task_executor &executor, std::thread::id &first, std::thread::id &second, countdown &done)
+	{
+		co_await executor.schedule();
+		first = std::this_thread::get_id();
+		//Now scheduled from one of the workers, so it goes through that worker's own queue.
+		co_await executor.schedule(task_priority::low);
+		second = std::this_thread::get_id();
+		done.signal();
+	}
+}
+
+TEST_CASE(schedule_resumes_on_a_worker)
+{
+	task_executor::task_executor executor{ 2 };
+	countdown done{ 1 };
+	std::thread::id resumed_on;
+
+	resume_on_executor(executor, task_priority::normal, resumed_on, done);
+
+	CHECK(done.wait());
+	CHECK(resumed_on != std::thread::id{});
+	CHECK(resumed_on != std::this_thread::get_id());
+}
+
+TEST_CASE(schedule_from_a_worker)
+{
+	task_executor::task_executor executor{ 2 };
+	countdown done{ 1 };
+	std::thread::id first;
+	std::thread::id second;
+
+	hop_twice(executor, first, second, done);
+
+	CHECK(done.wait());
+	CHECK(first != std::this_thread::get_id());
+	CHECK(second != std::this_thread::get_id());
+}
+
+TEST_CASE(schedule_resumes_every_coroutine)
+{
+	constexpr size_t coroutine_count = 3000;
+	task_executor::task_executor executor{ 4 };
+	countdown done{ coroutine_count };
+	std::vector<std::thread::id> resumed_on(coroutine_count);
+
+	for (size_t i = 0; i < coroutine_count; ++i)
+	{
+		resume_on_executor(executor, static_cast<task_priority>(i % priority_count), resumed_on[i], done);
+	}
+
+	CHECK(done.wait());
+	for (auto &id : resumed_on)
+	{
+		CHECK(id != std::this_thread::get_id());
+	}
+
+	//executed is counted after a task returns, so it can lag the last signal.
+	CHECK(executor.get_stats().submitted == coroutine_count);
+}
+
+TEST_CASE(higher_priorities_run_first)
+{
+	task_executor::task_executor executor{ 1 };
+
+	//Holds the only worker so the rest queue up behind it.
+	std::mutex gate_lock;
+	std::condition_variable gate;
+	bool open = false;
+	countdown started{ 1 };
+	executor.submit([&]()
+		{
+			started.signal();
+			std::unique_lock lock{ gate_lock };
+			gate.wait(lock, [&]()
+				{
+					return open;
+				});
+		});
+	CHECK(started.wait());
+
+	std::mutex order_lock;
+	std::vector<task_priority> order;
+	countdown done{ 3 };
+	for (auto priority : { task_priority::low, task_priority::normal, task_priority::high })
+	{
+		executor.submit([&, priority]()
+			{
+				{
+					std::scoped_lock lock{ order_lock };
+					order.push_back(priority);
+				}
+				done.signal();
+			}, priority);
+	}
+
+	{
+		std::scoped_lock lock{ gate_lock };
+		open = true;
+	}
+	gate.notify_all();
+
+	CHECK(done.wait());
+	CHECK((order == std::vector<task_priority>{ task_priority::high, task_priority::normal, task_priority::low }));
+}
+TEST_CASE(idle_workers_steal_the_oldest_task)
+{
+	task_executor::task_executor executor{ 2 };
+	auto before = executor.get_stats();
+
+	//The first task submits to its own worker's queue and then holds that worker,
+	//so only the other worker can run what it submitted.
+	std::mutex order_lock;
+	std::vector<int> order;
+	std::vector<std::thread::id> ran_on;
+	std::thread::id blocked_worker;
+	countdown done{ 3 };
+	countdown finished{ 1 };
+	executor.submit([&]()
+		{
+			blocked_worker = std::this_thread::get_id();
+			for (int i = 0; i < 3; ++i)
+			{
+				executor.submit([&, i]()
+					{
+						{
+							std::scoped_lock lock{ order_lock };
+							order.push_back(i);
+							ran_on.push_back(std::this_thread::get_id());
+						}
+						done.signal();
+					});
+			}
+			done.wait();
+			finished.signal();
+		});
+
+	CHECK(finished.wait());
+	//The owner would have taken them newest first, a thief takes them oldest first.
+	CHECK((order == std::vector<int>{ 0, 1, 2 }));
+	for (auto &id : ran_on)
+	{
+		CHECK(id != blocked_worker);
+	}
+	CHECK(executor.get_stats().stolen - before.stolen == 3);
+}
+
+TEST_CASE(queued_counts_drain_to_zero)
+{
+	task_executor::task_executor executor{ 1 };
+
+	std::mutex gate_lock;
+	std::condition_variable gate;
+	bool open = false;
+	countdown started{ 1 };
+	executor.submit([&]()
+		{
+			started.signal();
+			std::unique_lock lock{ gate_lock };
+			gate.wait(lock, [&]()
+				{
+					return open;
+				});
+		});
+	CHECK(started.wait());
+
+	//With the only worker held, everything submitted stays queued.
+	constexpr size_t per_priority = 4;
+	countdown done{ per_priority * priority_count };
+	for (size_t i = 0; i < per_priority * priority_count; ++i)
+	{
+		executor.submit([&]()
+			{
+				done.signal();
+			}, static_cast<task_priority>(i % priority_count));
+	}
+
+	auto stats = executor.get_stats();
+	for (auto queued : stats.queued)
+	{
+		CHECK(queued == per_priority);
+	}
+	CHECK(stats.worker_count == 1);
+
+	{
+		std::scoped_lock lock{ gate_lock };
+		open = true;
+	}
+	gate.notify_all();
+
+	//A task is taken off its queue before it runs.
+	CHECK(done.wait());
+	stats = executor.get_stats();
+	for (auto queued : stats.queued)
+	{
+		CHECK(queued == 0);
+	}
+	CHECK(stats.submitted == per_priority * priority_count + 1);
+}
\ No newline at end of file
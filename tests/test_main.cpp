@@ -0,0 +1,48 @@
+#include "test_support.h"
+
+#include <exception>
+
+namespace test_support
+{
+	std::vector<test_case> &get_tests()
+	{
+		static std::vector<test_case> tests;
+		return tests;
+	}
+
+	registration::registration(const char *name, void (*function)())
+	{
+		get_tests().push_back({ name, function });
+	}
+
+	void fail(const char *file, int line, const char *condition)
+	{
+		throw check_failure{ std::string{ file } + ":" + std::to_string(line) + ": " + condition };
+	}
+
+	int run_all()
+	{
+		int failed = 0;
+		for (auto &test : get_tests())
+		{
+			try
+			{
+				test.function();
+				std::printf("[pass] %s\n", test.name);
+			}
+			catch (const std::exception &e)
+			{
+				std::printf("[FAIL] %s\n  %s\n", test.name, e.what());
+				++failed;
+			}
+		}
+
+		std::printf("%zu tests, %d failed\n", get_tests().size(), failed);
+		return failed == 0 ? 0 : 1;
+	}
+}
+
+int main()
+{
+	return test_support::run_all();
+}
\ No newline at end of file
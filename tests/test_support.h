@@ -0,0 +1,79 @@
+#pragma once
+
+//Just enough of a test framework for the portable modules in UITest, so the tests
+//build anywhere without any dependencies.
+//Each test executable links test_main.cpp, which runs every registered case.
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static ::test_support::registration name##_registration{ #name, name }; \
+	static void name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			::test_support::fail(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression) \
+	do \
+	{ \
+		bool test_support_threw = false; \
+		try \
+		{ \
+			expression; \
+		} \
+		catch (...) \
+		{ \
+			test_support_threw = true; \
+		} \
+		if (!test_support_threw) \
+		{ \
+			::test_support::fail(__FILE__, __LINE__, "expected an exception from " #expression); \
+		} \
+	} while (false)
+
+namespace test_support
+{
+	struct test_case
+	{
+		const char *name;
+		void (*function)();
+	};
+
+	std::vector<test_case> &get_tests();
+
+	class registration
+	{
+	public:
+		registration(const char *, void (*)());
+	};
+
+	class check_failure : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	[[noreturn]] void fail(const char *, int, const char *);
+
+	int run_all();
+
+	//For the benchmarks, runs the function and returns the wall time in milliseconds.
+	template <typename F>
+	double time_ms(F &&function)
+	{
+		auto start = std::chrono::steady_clock::now();
+		function();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
\ No newline at end of file
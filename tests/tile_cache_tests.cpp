@@ -0,0 +1,244 @@
+#include "test_support.h"
+
+#include "tile_cache.h"
+
+#include <algorithm>
+
+using namespace tiled_canvas;
+
+namespace
+{
+	//The pool doesn't care what a tile is, an id is enough to tell them apart.
+	struct test_tile
+	{
+		int id{};
+	};
+
+	constexpr int32_t tile_size = 100;
+
+	tile_key key(int32_t x, int32_t y, int32_t level = 0)
+	{
+		return { level, x, y };
+	}
+
+	std::vector<tile_key> column(int32_t x, int32_t first_row, int32_t last_row, int32_t level = 0)
+	{
+		std::vector<tile_key> keys;
+		for (int32_t y = first_row; y <= last_row; ++y)
+		{
+			keys.push_back(key(x, y, level));
+		}
+		return keys;
+	}
+
+	std::vector<tile_key> row(int32_t y, int32_t first_column, int32_t last_column, int32_t level = 0)
+	{
+		std::vector<tile_key> keys;
+		for (int32_t x = first_column; x <= last_column; ++x)
+		{
+			keys.push_back(key(x, y, level));
+		}
+		return keys;
+	}
+
+	std::vector<tile_key> concat(std::initializer_list<std::vector<tile_key>> parts)
+	{
+		std::vector<tile_key> keys;
+		for (auto &part : parts)
+		{
+			keys.insert(keys.end(), part.begin(), part.end());
+		}
+		return keys;
+	}
+
+	//Columns 2 to 4 and rows 2 to 4 of a 10 by 10 grid.
+	constexpr view_rect middle_view{ 250., 250., 450., 450. };
+}
+
+TEST_CASE(pool_evicts_the_least_recently_used_tile)
+{
+	tile_pool<test_tile> pool{ 3 };
+	pool.begin_frame();
+	pool.insert(key(0, 0), { 0 }, 1);
+	pool.insert(key(1, 0), { 1 }, 1);
+	pool.insert(key(2, 0), { 2 }, 1);
+
+	//Using the oldest tile makes the second one the least recently used.
+	pool.begin_frame();
+	CHECK(pool.find(key(0, 0)) != nullptr);
+	pool.insert(key(3, 0), { 3 }, 1);
+
+	CHECK(pool.contains(key(0, 0)));
+	CHECK(!pool.contains(key(1, 0)));
+	CHECK(pool.contains(key(2, 0)));
+	CHECK(pool.contains(key(3, 0)));
+	CHECK(pool.eviction_count() == 1);
+
+	pool.begin_frame();
+	pool.insert(key(4, 0), { 4 }, 1);
+	CHECK(!pool.contains(key(2, 0)));
+	CHECK(pool.find(key(0, 0))->id == 0);
+	CHECK(pool.find(key(4, 0))->id == 4);
+	CHECK(pool.hit_count() == 3);
+	CHECK(pool.find(key(1, 0)) == nullptr);
+	CHECK(pool.miss_count() == 1);
+}
+
+TEST_CASE(pool_stays_under_its_memory_cap)
+{
+	tile_pool<test_tile> pool{ 10 };
+	for (int i = 0; i < 20; ++i)
+	{
+		pool.begin_frame();
+		CHECK(pool.has_room(4) == (pool.size_bytes() + 4 <= 10));
+		pool.insert(key(i, 0), { i }, 4);
+		CHECK(pool.size_bytes() <= 10);
+		CHECK(pool.size_bytes() == pool.tile_count() * 4);
+	}
+	CHECK(pool.tile_count() == 2);
+	CHECK(pool.eviction_count() == 18);
+
+	//Replacing a tile adjusts the size rather than counting it twice.
+	pool.insert(key(19, 0), { 100 }, 2);
+	CHECK(pool.size_bytes() == 6);
+	CHECK(pool.find(key(19, 0))->id == 100);
+
+	//evict_one hands the storage back for reuse.
+	pool.begin_frame();
+	test_tile reused{};
+	CHECK(pool.evict_one(reused));
+	CHECK(reused.id == 18);
+	CHECK(pool.size_bytes() == 2);
+}
+
+TEST_CASE(pool_never_evicts_tiles_used_this_frame)
+{
+	tile_pool<test_tile> pool{ 3 };
+	pool.begin_frame();
+	for (int i = 0; i < 5; ++i)
+	{
+		pool.insert(key(i, 0), { i }, 1);
+	}
+	//All five are visible, so the pool goes over the cap rather than drop one.
+	CHECK(pool.tile_count() == 5);
+	CHECK(pool.size_bytes() == 5);
+	test_tile discarded{};
+	CHECK(!pool.evict_one(discarded));
+
+	//Next frame only two are still in use, the rest go to make room.
+	pool.begin_frame();
+	CHECK(pool.find(key(0, 0)) != nullptr);
+	CHECK(pool.find(key(4, 0)) != nullptr);
+	pool.insert(key(5, 0), { 5 }, 1);
+	CHECK(pool.size_bytes() == 3);
+	CHECK(pool.contains(key(0, 0)));
+	CHECK(pool.contains(key(4, 0)));
+	CHECK(pool.contains(key(5, 0)));
+	CHECK(!pool.evict_one(discarded));
+}
+
+TEST_CASE(plan_covers_the_viewport)
+{
+	auto plan = plan_tiles(middle_view, 0, tile_size, 10, 10, 0., 0., 2);
+	CHECK(plan.visible == concat({ row(2, 2, 4), row(3, 2, 4), row(4, 2, 4) }));
+	//Nothing is moving, so there is nothing to prefetch.
+	CHECK(plan.prefetch.empty());
+
+	//Exactly on tile edges.
+	plan = plan_tiles({ 100., 100., 300., 200. }, 0, tile_size, 10, 10, 0., 0., 2);
+	CHECK(plan.visible == row(1, 1, 2));
+
+	//Entirely outside the canvas.
+	plan = plan_tiles({ 1100., 0., 1300., 200. }, 0, tile_size, 10, 10, 1., 0., 2);
+	CHECK(plan.visible.empty());
+	CHECK(plan.prefetch.empty());
+}
+
+TEST_CASE(prefetch_follows_the_motion)
+{
+	//Nearest column or row first.
+	auto plan = plan_tiles(middle_view, 0, tile_size, 10, 10, 5., 0., 2);
+	CHECK(plan.prefetch == concat({ column(5, 2, 4), column(6, 2, 4) }));
+
+	plan = plan_tiles(middle_view, 0, tile_size, 10, 10, -5., 0., 2);
+	CHECK(plan.prefetch == concat({ column(1, 2, 4), column(0, 2, 4) }));
+
+	plan = plan_tiles(middle_view, 0, tile_size, 10, 10, 0., 5., 1);
+	CHECK(plan.prefetch == row(5, 2, 4));
+
+	plan = plan_tiles(middle_view, 0, tile_size, 10, 10, 0., -5., 2);
+	CHECK(plan.prefetch == concat({ row(1, 2, 4), row(0, 2, 4) }));
+
+	//Diagonally, the columns take the corner tiles and the rows don't repeat them.
+	plan = plan_tiles(middle_view, 0, tile_size, 10, 10, 5., 5., 1);
+	CHECK(plan.prefetch == concat({ column(5, 2, 5), row(5, 2, 4) }));
+
+	plan = plan_tiles(middle_view, 0, tile_size, 10, 10, -5., -5., 1);
+	CHECK(plan.prefetch == concat({ column(1, 1, 4), row(1, 2, 4) }));
+}
+
+TEST_CASE(prefetch_stops_at_the_canvas_edges)
+{
+	//Already showing the last column.
+	auto plan = plan_tiles({ 850., 250., 1050., 450. }, 0, tile_size, 10, 10, 5., 0., 2);
+	CHECK(plan.visible == concat({ row(2, 8, 9), row(3, 8, 9), row(4, 8, 9) }));
+	CHECK(plan.prefetch.empty());
+
+	//One column left, so only one of the two is prefetched.
+	plan = plan_tiles({ 750., 250., 850., 450. }, 0, tile_size, 10, 10, 5., 0., 2);
+	CHECK(plan.prefetch == column(9, 2, 4));
+
+	//Past the top left, the viewport is clamped first.
+	plan = plan_tiles({ -50., -50., 150., 150. }, 0, tile_size, 10, 10, -5., -5., 2);
+	CHECK(plan.visible == concat({ row(0, 0, 1), row(1, 0, 1) }));
+	CHECK(plan.prefetch.empty());
+
+	//In the bottom right corner moving diagonally, the column's corner tiles are clamped as well.
+	plan = plan_tiles({ 750., 750., 850., 850. }, 0, tile_size, 10, 10, 5., 5., 3);
+	CHECK(plan.prefetch == concat({ column(9, 7, 9), row(9, 7, 8) }));
+	for (auto &tile : plan.prefetch)
+	{
+		CHECK(tile.x >= 0 && tile.x < 10 && tile.y >= 0 && tile.y < 10);
+	}
+}
+
+TEST_CASE(zoom_levels_have_their_own_tiles)
+{
+	//The same view at two levels gives the same positions with different keys.
+	auto level_0 = plan_tiles(middle_view, 0, tile_size, 10, 10, 5., 0., 1);
+	auto level_1 = plan_tiles(middle_view, 1, tile_size, 20, 20, 5., 0., 1);
+	CHECK(level_1.visible == concat({ row(2, 2, 4, 1), row(3, 2, 4, 1), row(4, 2, 4, 1) }));
+	CHECK(level_1.prefetch == column(5, 2, 4, 1));
+	CHECK(std::none_of(level_0.visible.begin(), level_0.visible.end(), [](const tile_key &tile)
+		{
+			return tile.level != 0;
+		}));
+
+	tile_key_hash hash;
+	CHECK(!(key(2, 2, 0) == key(2, 2, 1)));
+	CHECK(hash(key(2, 2, 0)) != hash(key(2, 2, 1)));
+
+	//After zooming, the old level's tiles aren't used any more and are the first to go.
+	tile_pool<test_tile> pool{ level_0.visible.size() };
+	pool.begin_frame();
+	for (auto &tile : level_0.visible)
+	{
+		pool.insert(tile, { 0 }, 1);
+	}
+
+	pool.begin_frame();
+	for (auto &tile : level_1.visible)
+	{
+		CHECK(pool.find(tile) == nullptr);
+		pool.insert(tile, { 1 }, 1);
+	}
+	CHECK(pool.tile_count() == level_1.visible.size());
+	for (auto &tile : level_0.visible)
+	{
+		CHECK(!pool.contains(tile));
+	}
+	for (auto &tile : level_1.visible)
+	{
+		CHECK(pool.find(tile)->id == 1);
+	}
+}
\ No newline at end of file
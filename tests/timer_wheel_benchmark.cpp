@@ -0,0 +1,107 @@
+#include "test_support.h"
+
+#include "timer_wheel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+
+//Schedules a million timers over a minute of microsecond ticks, cancels half of
+//them and fires the rest, against a binary heap doing the same work.
+//The timer count can be given on the command line.
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	constexpr uint64_t span = 60 * 1000 * 1000;
+	constexpr uint64_t step = 1000;
+
+	std::mt19937_64 random{ 1 };
+	std::vector<uint64_t> deadlines(count);
+	for (auto &deadline : deadlines)
+	{
+		deadline = 1 + random() % span;
+	}
+
+	size_t wheel_fired = 0;
+	timer_wheel::timer_wheel wheel{ 0 };
+	std::vector<timer_wheel::timer_id> ids(count);
+	double schedule_ms = test_support::time_ms([&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				ids[i] = wheel.schedule(deadlines[i], 0, 0, [&wheel_fired]()
+					{
+						++wheel_fired;
+					});
+			}
+		});
+	double cancel_ms = test_support::time_ms([&]()
+		{
+			for (size_t i = 0; i < count; i += 2)
+			{
+				wheel.cancel(ids[i]);
+			}
+		});
+	double fire_ms = test_support::time_ms([&]()
+		{
+			for (uint64_t time = step; time <= span; time += step)
+			{
+				wheel.run_until(time);
+			}
+		});
+
+	//The heap can't remove from the middle, so cancelled entries are skipped when they surface.
+	size_t heap_fired = 0;
+	struct heap_entry
+	{
+		uint64_t deadline;
+		size_t index;
+		timer_wheel::callback function;
+
+		bool operator>(const heap_entry &other) const
+		{
+			return deadline > other.deadline;
+		}
+	};
+	std::priority_queue<heap_entry, std::vector<heap_entry>, std::greater<>> heap;
+	std::vector<bool> cancelled(count);
+	double heap_schedule_ms = test_support::time_ms([&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				heap.push({ deadlines[i], i, [&heap_fired]()
+					{
+						++heap_fired;
+					} });
+			}
+		});
+	double heap_cancel_ms = test_support::time_ms([&]()
+		{
+			for (size_t i = 0; i < count; i += 2)
+			{
+				cancelled[i] = true;
+			}
+		});
+	double heap_fire_ms = test_support::time_ms([&]()
+		{
+			for (uint64_t time = step; time <= span; time += step)
+			{
+				while (!heap.empty() && heap.top().deadline <= time)
+				{
+					if (!cancelled[heap.top().index])
+					{
+						heap.top().function();
+					}
+					heap.pop();
+				}
+			}
+		});
+
+	std::printf("%zu timers\n", count);
+	std::printf("wheel: schedule %.2f ms, cancel half %.2f ms, fire the rest %.2f ms, total %.2f ms\n", schedule_ms, cancel_ms, fire_ms, schedule_ms + cancel_ms + fire_ms);
+	std::printf("heap:  schedule %.2f ms, cancel half %.2f ms, fire the rest %.2f ms, total %.2f ms\n", heap_schedule_ms, heap_cancel_ms, heap_fire_ms, heap_schedule_ms + heap_cancel_ms + heap_fire_ms);
+
+	return wheel_fired == heap_fired && wheel_fired == count / 2 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "test_support.h"
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+using namespace timer_wheel;
+
+namespace
+{
+	//Time only moves when the test moves it.
+	class fake_clock : public timer_wheel::clock
+	{
+	public:
+		explicit fake_clock(std::atomic<uint64_t> &time) : m_time{ time }
+		{
+		}
+
+		uint64_t now() const override
+		{
+			return m_time.load();
+		}
+
+	private:
+		std::atomic<uint64_t> &m_time;
+	};
+
+	template <typename P>
+	bool wait_for(P &&predicate)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+		while (!predicate())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		return true;
+	}
+}
+
+TEST_CASE(one_shot_fires_at_its_deadline)
+{
+	timer_wheel::timer_wheel wheel{ 100 };
+	int fired = 0;
+	wheel.schedule(150, 0, 0, [&fired]()
+		{
+			++fired;
+		});
+
+	CHECK(wheel.next_event() == std::optional<uint64_t>{ 150 });
+	CHECK(wheel.run_until(149) == 0);
+	CHECK(wheel.run_until(150) == 1);
+	CHECK(wheel.run_until(10000) == 0);
+	CHECK(fired == 1);
+	CHECK(wheel.size() == 0);
+	CHECK(!wheel.next_event());
+}
+
+TEST_CASE(passed_deadlines_fire_on_the_next_advance)
+{
+	timer_wheel::timer_wheel wheel{ 1000 };
+	int fired = 0;
+	wheel.schedule(10, 0, 0, [&fired]()
+		{
+			++fired;
+		});
+
+	CHECK(wheel.run_until(1001) == 1);
+	CHECK(fired == 1);
+}
+
+TEST_CASE(tolerance_coalesces_within_bounds)
+{
+	timer_wheel::timer_wheel wheel{ 0 };
+	uint64_t time = 0;
+	std::vector<uint64_t> fired_at;
+	for (uint64_t deadline = 1001; deadline < 1050; deadline += 7)
+	{
+		wheel.schedule(deadline, 100, 0, [&time, &fired_at]()
+			{
+				fired_at.push_back(time);
+			});
+	}
+
+	//A tolerance of 100 rounds deadlines up to a multiple of 64, so they fire in two groups.
+	for (time = 1; time <= 1200; ++time)
+	{
+		wheel.run_until(time);
+	}
+	CHECK((fired_at == std::vector<uint64_t>{ 1024, 1024, 1024, 1024, 1088, 1088, 1088 }));
+}
+
+TEST_CASE(periodic_timers_keep_their_phase)
+{
+	timer_wheel::timer_wheel wheel{ 0 };
+	uint64_t time = 0;
+	std::vector<uint64_t> fired_at;
+	wheel.schedule(10, 0, 10, [&time, &fired_at]()
+		{
+			fired_at.push_back(time);
+		});
+
+	for (time = 1; time <= 55; ++time)
+	{
+		wheel.run_until(time);
+	}
+	CHECK((fired_at == std::vector<uint64_t>{ 10, 20, 30, 40, 50 }));
+
+	//Missed periods are skipped rather than fired late, and the phase is kept.
+	time = 95;
+	CHECK(wheel.run_until(time) == 1);
+	time = 99;
+	CHECK(wheel.run_until(time) == 0);
+	time = 100;
+	CHECK(wheel.run_until(time) == 1);
+	CHECK(fired_at.size() == 7);
+}
+
+TEST_CASE(cancel_and_stale_ids)
+{
+	timer_wheel::timer_wheel wheel{ 0 };
+	int fired = 0;
+	auto first = wheel.schedule(100, 0, 0, [&fired]()
+		{
+			++fired;
+		});
+
+	CHECK(wheel.cancel(first));
+	CHECK(!wheel.cancel(first));
+	CHECK(!wheel.cancel(timer_id{}));
+
+	//The new timer reuses the slot, the old id mustn't cancel it.
+	auto second = wheel.schedule(100, 0, 0, [&fired]()
+		{
+			++fired;
+		});
+	CHECK(second.index == first.index);
+	CHECK(!wheel.cancel(first));
+	CHECK(wheel.run_until(100) == 1);
+	CHECK(fired == 1);
+}
+
+TEST_CASE(callbacks_can_cancel_timers_in_the_same_batch)
+{
+	timer_wheel::timer_wheel wheel{ 0 };
+	timer_id first{};
+	timer_id second{};
+	int fired = 0;
+
+	//Whichever runs first cancels the other.
+	first = wheel.schedule(50, 0, 0, [&]()
+		{
+			++fired;
+			wheel.cancel(second);
+		});
+	second = wheel.schedule(50, 0, 0, [&]()
+		{
+			++fired;
+			wheel.cancel(first);
+		});
+
+	std::vector<timer_id> due;
+	wheel.advance(50, due);
+	CHECK(due.size() == 2);
+	for (auto id : due)
+	{
+		if (auto function = wheel.take_callback(id))
+		{
+			function();
+		}
+	}
+	CHECK(fired == 1);
+	CHECK(wheel.size() == 0);
+}
+
+TEST_CASE(random_deadlines_fire_in_order_across_levels)
+{
+	//Deadlines from a tick away up to past the overflow list.
+	std::mt19937_64 random{ 1 };
+	timer_wheel::timer_wheel wheel{ 12345 };
+	std::vector<uint64_t> deadlines;
+	std::vector<uint64_t> fired_by(20000);
+	uint64_t time = 12345;
+
+	for (uint32_t i = 0; i < 20000; ++i)
+	{
+		auto magnitude = std::uniform_int_distribution<int>{ 0, 40 }(random);
+		deadlines.push_back(12345 + 1 + (random() & ((uint64_t{ 1 } << magnitude) - 1)));
+		wheel.schedule(deadlines.back(), 0, 0, [&time, &fired_by, i]()
+			{
+				fired_by[i] = time;
+			});
+	}
+
+	//Uneven steps, so some advances cross several slots and levels at once.
+	//Each timer has to fire in the first advance that reaches its deadline.
+	std::vector<uint64_t> steps{ time };
+	while (wheel.size() != 0)
+	{
+		time += std::max<uint64_t>(1, random() % (uint64_t{ 1 } << std::uniform_int_distribution<int>{ 0, 38 }(random)));
+		wheel.run_until(time);
+		steps.push_back(time);
+	}
+
+	for (size_t i = 0; i < deadlines.size(); ++i)
+	{
+		auto step = std::lower_bound(steps.begin(), steps.end(), deadlines[i]);
+		CHECK(step != steps.end());
+		CHECK(fired_by[i] == *step);
+	}
+}
+
+TEST_CASE(service_cancel_of_a_default_id_returns)
+{
+	timer_service service;
+	CHECK(!service.cancel(timer_id{}));
+	CHECK(!service.cancel(timer_id{}));
+}
+
+TEST_CASE(service_fires_on_the_fake_clock)
+{
+	std::atomic<uint64_t> time{ 1000000 };
+	timer_service service{ std::make_unique<fake_clock>(time) };
+
+	std::atomic<int> fired_early{};
+	std::atomic<int> fired_late{};
+	service.schedule_after(std::chrono::milliseconds{ 1 }, [&fired_early]()
+		{
+			++fired_early;
+		}, std::chrono::microseconds{ 0 });
+	service.schedule_after(std::chrono::hours{ 1 }, [&fired_late]()
+		{
+			++fired_late;
+		});
+
+	//The service sleeps for the real time equivalent of the fake wait, so the
+	//first timer fires once the fake clock reaches it.
+	time += 2000;
+	CHECK(wait_for([&fired_early]()
+		{
+			return fired_early == 1;
+		}));
+	CHECK(fired_late == 0);
+}
+
+TEST_CASE(service_cancel_waits_for_a_running_callback)
+{
+	timer_service service;
+	std::atomic<bool> started{};
+	std::atomic<bool> finished{};
+	auto id = service.schedule_after(std::chrono::microseconds{ 0 }, [&]()
+		{
+			started = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+			finished = true;
+		}, std::chrono::microseconds{ 0 });
+
+	CHECK(wait_for([&started]()
+		{
+			return started.load();
+		}));
+	//The one shot has already left the wheel, but cancel still waits for it.
+	CHECK(!service.cancel(id));
+	CHECK(finished);
+}
+
+TEST_CASE(service_periodic_timer_can_cancel_itself)
+{
+	timer_service service;
+	std::atomic<int> count{};
+	timer_id id{};
+	std::atomic<bool> scheduled{};
+	id = service.schedule_every(std::chrono::milliseconds{ 1 }, [&]()
+		{
+			while (!scheduled)
+			{
+			}
+			if (++count == 3)
+			{
+				service.cancel(id);
+			}
+		});
+	scheduled = true;
+
+	CHECK(wait_for([&count]()
+		{
+			return count >= 3;
+		}));
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+	CHECK(count == 3);
+	//Already cancelled, this mustn't wait.
+	CHECK(!service.cancel(id));
+}
\ No newline at end of file